@@ -4,22 +4,143 @@
 #include <stddef.h>
 #include <stdint.h>
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct WfArena WfArena;
+
 typedef struct {
     char *word;
     uint64_t count;
 } WfEntry;
 
+typedef struct {
+    uint64_t inserts;
+    uint64_t hits;
+    uint64_t probes;
+    uint64_t max_probe;
+    size_t resizes;
+    size_t capacity;
+    size_t bytes;
+    uint64_t rank_ns;
+} WfStats;
+
 typedef struct {
     WfEntry *entries;
     size_t unique;
     uint64_t total;
+    WfStats stats;
+    WfArena *arena;
 } WfResult;
 
+typedef enum {
+    WF_SCANNER_SCALAR,
+    WF_SCANNER_SIMD
+} WfScanner;
+
+typedef struct {
+    WfScanner scanner;
+    size_t top;
+    size_t sort_threads;
+} WfOptions;
+
+typedef struct WfCounter WfCounter;
+typedef struct WfApprox WfApprox;
+typedef struct WfWindow WfWindow;
+
+typedef struct {
+    char *word;
+    uint64_t count;
+    uint64_t error;
+} WfApproxEntry;
+
+typedef struct {
+    WfApproxEntry *entries;
+    size_t len;
+    uint64_t total;
+    uint64_t unique;
+    double unique_error;
+    uint64_t max_error;
+    size_t counters;
+    WfArena *arena;
+} WfApproxResult;
+
 int wf_count_bytes(const unsigned char *data,
                    size_t len,
                    size_t max_word,
                    WfResult *result);
+int wf_count_bytes_with(const unsigned char *data,
+                        size_t len,
+                        size_t max_word,
+                        const WfOptions *options,
+                        WfResult *result);
+int wf_count_bytes_parallel(const unsigned char *data,
+                            size_t len,
+                            size_t max_word,
+                            size_t threads,
+                            WfResult *result);
+int wf_count_bytes_parallel_with(const unsigned char *data,
+                                 size_t len,
+                                 size_t max_word,
+                                 size_t threads,
+                                 const WfOptions *options,
+                                 WfResult *result);
 void wf_result_free(WfResult *result);
 void wf_result_sort(WfResult *result);
+void wf_result_select(WfResult *result, size_t top);
+void wf_result_order(WfResult *result, const WfOptions *options);
+int wf_result_encode(const WfResult *result,
+                     unsigned char **data,
+                     size_t *len);
+int wf_result_merge(const unsigned char *const *parts,
+                    const size_t *lens,
+                    size_t count,
+                    WfResult *result);
+int wf_result_merge_with(const unsigned char *const *parts,
+                         const size_t *lens,
+                         size_t count,
+                         const WfOptions *options,
+                         WfResult *result);
+size_t wf_estimate_unique(const unsigned char *data,
+                          size_t len,
+                          size_t max_word);
+int wf_stats_enabled(void);
+
+WfCounter *wf_counter_new(size_t max_word, size_t size_hint);
+int wf_counter_reserve(WfCounter *counter, size_t unique);
+void wf_counter_set_options(WfCounter *counter, const WfOptions *options);
+int wf_counter_feed(WfCounter *counter,
+                    const unsigned char *data,
+                    size_t len);
+int wf_counter_end_word(WfCounter *counter);
+int wf_counter_merge(WfCounter *counter, WfCounter *other);
+int wf_counter_snapshot(const WfCounter *counter, WfResult *result);
+int wf_counter_collect(WfCounter *counter, WfResult *result);
+int wf_counter_finish(WfCounter *counter, WfResult *result);
+int wf_counter_view(WfCounter *counter, WfResult *result);
+int wf_counter_reset(WfCounter *counter);
+void wf_counter_free(WfCounter *counter);
+
+WfApprox *wf_approx_new(size_t max_word, size_t budget);
+int wf_approx_feed(WfApprox *approx, const unsigned char *data, size_t len);
+int wf_approx_end_word(WfApprox *approx);
+int wf_approx_finish(WfApprox *approx, size_t top, WfApproxResult *result);
+void wf_approx_set_scanner(WfApprox *approx, WfScanner scanner);
+void wf_approx_free(WfApprox *approx);
+void wf_approx_result_free(WfApproxResult *result);
+
+WfWindow *wf_window_new(size_t max_word, size_t buckets, size_t top);
+void wf_window_set_scanner(WfWindow *window, WfScanner scanner);
+int wf_window_feed(WfWindow *window, const unsigned char *data, size_t len);
+int wf_window_end_word(WfWindow *window);
+int wf_window_advance(WfWindow *window);
+int wf_window_top(const WfWindow *window, WfResult *result);
+size_t wf_window_unique(const WfWindow *window);
+void wf_window_free(WfWindow *window);
+
+#ifdef __cplusplus
+}
+#endif
 
 #endif
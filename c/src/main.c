@@ -6,31 +6,208 @@
 
 #include <errno.h>
 #include <inttypes.h>
+#include <limits.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <threads.h>
 #include <time.h>
 #if defined(_WIN32)
+#include <fcntl.h>
+#include <io.h>
 #include <windows.h>
+#else
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#if defined(WFC_ZLIB)
+#include <zlib.h>
+#endif
+#if defined(WFC_ZSTD)
+#include <zstd.h>
 #endif
 
 static const uint32_t CHECKSUM_OFFSET = UINT32_C(2166136261);
 static const uint32_t CHECKSUM_PRIME = UINT32_C(16777619);
+static const size_t DEFAULT_CHUNK_SIZE = (size_t)1 << 20;
+static const size_t SOURCE_BUFFER = (size_t)1 << 16;
+static const unsigned char INDEX_MAGIC[4] = { 'W', 'F', 'X', '1' };
+
+typedef enum {
+    INPUT_READ,
+    INPUT_MMAP,
+    INPUT_STREAM
+} InputMode;
+
+typedef enum {
+    FORMAT_TEXT,
+    FORMAT_JSON,
+    FORMAT_NDJSON,
+    FORMAT_TSV
+} Format;
+
+enum {
+    OUTPUT_BUFFER = 64 * 1024
+};
+
+enum {
+    READ_ERROR = -1,
+    OUT_OF_MEMORY = -2
+};
+
+enum {
+    CORRUPT_INPUT = -1,
+    UNSUPPORTED_INPUT = -2
+};
+
+enum {
+    INDEX_HEADER = 4 + 6 * 8,
+    CORRUPT_INDEX = -3
+};
+
+typedef enum {
+    CODEC_RAW,
+    CODEC_GZIP,
+    CODEC_ZSTD
+} Codec;
+
+typedef struct {
+    FILE *file;
+    Codec codec;
+    unsigned char *in;
+    size_t in_len;
+    size_t in_pos;
+    bool drained;
+    bool finished;
+    int error;
+#if defined(WFC_ZLIB)
+    z_stream gzip;
+#endif
+#if defined(WFC_ZSTD)
+    ZSTD_DCtx *zstd;
+#endif
+} Source;
 
 typedef struct {
+    const char **args;
+    size_t arg_count;
     const char *path;
+    const char *dump;
+    const char *index;
     size_t top;
     size_t max_word;
     size_t bench_runs;
     size_t bench_warmups;
-    bool json;
+    size_t chunk_size;
+    size_t threads;
+    size_t approx;
+    size_t window;
+    size_t bucket_lines;
+    InputMode input;
+    Format format;
+    WfScanner scanner;
+    WfOptions counting;
+    bool select;
+    bool merge;
+    bool stats;
+    bool bench_reuse;
 } Options;
 
+typedef struct {
+    size_t len;
+    bool failed;
+    char bytes[OUTPUT_BUFFER];
+} Output;
+
+typedef struct {
+    WfWindow *window;
+    const Options *options;
+    size_t lines;
+    bool pending;
+    bool failed;
+} WindowSink;
+
+typedef struct {
+    unsigned char *data;
+    size_t len;
+    bool mapped;
+} Input;
+
+typedef struct {
+    uint64_t read_ns;
+    uint64_t count_ns;
+    uint64_t output_ns;
+    bool loaded;
+} Phases;
+
+typedef struct {
+    uint64_t device;
+    uint64_t inode;
+    uint64_t mtime;
+    uint64_t size;
+} FileIdentity;
+
+typedef struct {
+    Source *source;
+    unsigned char *buffers[2];
+    size_t lens[2];
+    bool full[2];
+    size_t size;
+    size_t next;
+    bool holding;
+    bool done;
+    bool stop;
+    int error;
+    mtx_t lock;
+    cnd_t changed;
+    thrd_t reader;
+} Readahead;
+
+typedef struct {
+    char **items;
+    size_t len;
+    size_t cap;
+} PathList;
+
+typedef struct {
+    uint64_t size;
+    size_t index;
+} SizedPath;
+
+typedef struct {
+    mtx_t lock;
+    size_t *items;
+    size_t head;
+    size_t tail;
+} FileQueue;
+
+typedef struct {
+    FileQueue *queues;
+    size_t workers;
+    size_t id;
+    const PathList *paths;
+    const Options *options;
+    WfCounter *counter;
+    unsigned char *chunk;
+    const char *failed;
+    int error;
+    int status;
+} FileWorker;
+
 static void usage(const char *program)
 {
     (void)fprintf(stderr,
-                  "usage: %s [--json] [--top N] [--max-word N] <file>\n",
+                  "usage: %s [--json] [--format text|json|ndjson|tsv] "
+                  "[--top N] [--max-word N] "
+                  "[--input read|mmap|stream] [--chunk-size N] "
+                  "[--threads N] [--scan scalar|simd] [--select] "
+                  "[--dump FILE] [--merge] [--index FILE] [--approx BYTES] "
+                  "[--window BUCKETS] [--bucket-lines N] [--stats] "
+                  "<path|@list|->...\n",
                   program);
 }
 
@@ -57,6 +234,70 @@ static int parse_size(const char *text, size_t *out)
     return 0;
 }
 
+static size_t available_cores(void)
+{
+#if defined(_WIN32)
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwNumberOfProcessors > 0 ? (size_t)info.dwNumberOfProcessors
+                                         : 1u;
+#else
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    return cores > 0 ? (size_t)cores : 1u;
+#endif
+}
+
+static int parse_format(const char *text, Format *out)
+{
+    if (strcmp(text, "text") == 0) {
+        *out = FORMAT_TEXT;
+        return 0;
+    }
+    if (strcmp(text, "json") == 0) {
+        *out = FORMAT_JSON;
+        return 0;
+    }
+    if (strcmp(text, "ndjson") == 0) {
+        *out = FORMAT_NDJSON;
+        return 0;
+    }
+    if (strcmp(text, "tsv") == 0) {
+        *out = FORMAT_TSV;
+        return 0;
+    }
+    return -1;
+}
+
+static int parse_input(const char *text, InputMode *out)
+{
+    if (strcmp(text, "read") == 0) {
+        *out = INPUT_READ;
+        return 0;
+    }
+    if (strcmp(text, "mmap") == 0) {
+        *out = INPUT_MMAP;
+        return 0;
+    }
+    if (strcmp(text, "stream") == 0) {
+        *out = INPUT_STREAM;
+        return 0;
+    }
+    return -1;
+}
+
+static int parse_scanner(const char *text, WfScanner *out)
+{
+    if (strcmp(text, "scalar") == 0) {
+        *out = WF_SCANNER_SCALAR;
+        return 0;
+    }
+    if (strcmp(text, "simd") == 0) {
+        *out = WF_SCANNER_SIMD;
+        return 0;
+    }
+    return -1;
+}
+
 static int parse_separate_size(int argc, char **argv, int *index, size_t *out)
 {
     *index += 1;
@@ -80,25 +321,100 @@ static int parse_prefixed_size(const char *arg, size_t *out)
     if (strncmp(arg, "--bench-warmups=", 16u) == 0) {
         return parse_size(arg + 16u, out);
     }
+    if (strncmp(arg, "--chunk-size=", 13u) == 0) {
+        return parse_size(arg + 13u, out);
+    }
+    if (strncmp(arg, "--threads=", 10u) == 0) {
+        return parse_size(arg + 10u, out);
+    }
+    if (strncmp(arg, "--approx=", 9u) == 0) {
+        return parse_size(arg + 9u, out);
+    }
     return 1;
 }
 
 static int parse_options(int argc, char **argv, Options *options)
 {
-    *options = (Options){ .path = NULL,
+    *options = (Options){ .args = calloc((size_t)argc, sizeof(char *)),
+                          .arg_count = 0u,
+                          .path = NULL,
+                          .dump = NULL,
+                          .index = NULL,
                           .top = 10u,
                           .max_word = 1024u,
                           .bench_runs = 0u,
                           .bench_warmups = 0u,
-                          .json = false };
+                          .chunk_size = DEFAULT_CHUNK_SIZE,
+                          .threads = 1u,
+                          .approx = 0u,
+                          .window = 0u,
+                          .bucket_lines = 1000u,
+                          .input = INPUT_READ,
+                          .format = FORMAT_TEXT,
+                          .scanner = WF_SCANNER_SCALAR,
+                          .select = false,
+                          .merge = false,
+                          .stats = false };
 
     for (int i = 1; i < argc; i++) {
         if (strcmp(argv[i], "--json") == 0) {
-            options->json = true;
+            options->format = FORMAT_JSON;
+        } else if (strcmp(argv[i], "--format") == 0) {
+            if (++i >= argc || parse_format(argv[i], &options->format) != 0) {
+                return -1;
+            }
+        } else if (strncmp(argv[i], "--format=", 9u) == 0) {
+            if (parse_format(argv[i] + 9u, &options->format) != 0) {
+                return -1;
+            }
+        } else if (strcmp(argv[i], "--select") == 0) {
+            options->select = true;
+        } else if (strcmp(argv[i], "--merge") == 0) {
+            options->merge = true;
+        } else if (strcmp(argv[i], "--stats") == 0) {
+            options->stats = true;
+        } else if (strcmp(argv[i], "--bench-reuse") == 0) {
+            options->bench_reuse = true;
+        } else if (strcmp(argv[i], "--dump") == 0) {
+            if (++i >= argc) {
+                return -1;
+            }
+            options->dump = argv[i];
+        } else if (strncmp(argv[i], "--dump=", 7u) == 0) {
+            options->dump = argv[i] + 7u;
+        } else if (strcmp(argv[i], "--index") == 0) {
+            if (++i >= argc) {
+                return -1;
+            }
+            options->index = argv[i];
+        } else if (strncmp(argv[i], "--index=", 8u) == 0) {
+            options->index = argv[i] + 8u;
+        } else if (strcmp(argv[i], "--input") == 0) {
+            if (++i >= argc || parse_input(argv[i], &options->input) != 0) {
+                return -1;
+            }
+        } else if (strncmp(argv[i], "--input=", 8u) == 0) {
+            if (parse_input(argv[i] + 8u, &options->input) != 0) {
+                return -1;
+            }
+        } else if (strcmp(argv[i], "--scan") == 0) {
+            if (++i >= argc ||
+                parse_scanner(argv[i], &options->scanner) != 0) {
+                return -1;
+            }
+        } else if (strncmp(argv[i], "--scan=", 7u) == 0) {
+            if (parse_scanner(argv[i] + 7u, &options->scanner) != 0) {
+                return -1;
+            }
         } else if (strcmp(argv[i], "--top") == 0 ||
                    strcmp(argv[i], "--max-word") == 0 ||
                    strcmp(argv[i], "--bench-runs") == 0 ||
-                   strcmp(argv[i], "--bench-warmups") == 0) {
+                   strcmp(argv[i], "--bench-warmups") == 0 ||
+                   strcmp(argv[i], "--chunk-size") == 0 ||
+                   strcmp(argv[i], "--threads") == 0 ||
+                   strcmp(argv[i], "--approx") == 0 ||
+                   strcmp(argv[i], "--window") == 0 ||
+                   strcmp(argv[i], "--bucket-lines") == 0) {
             size_t *target = &options->top;
             if (strcmp(argv[i], "--max-word") == 0) {
                 target = &options->max_word;
@@ -106,6 +422,16 @@ static int parse_options(int argc, char **argv, Options *options)
                 target = &options->bench_runs;
             } else if (strcmp(argv[i], "--bench-warmups") == 0) {
                 target = &options->bench_warmups;
+            } else if (strcmp(argv[i], "--chunk-size") == 0) {
+                target = &options->chunk_size;
+            } else if (strcmp(argv[i], "--threads") == 0) {
+                target = &options->threads;
+            } else if (strcmp(argv[i], "--approx") == 0) {
+                target = &options->approx;
+            } else if (strcmp(argv[i], "--window") == 0) {
+                target = &options->window;
+            } else if (strcmp(argv[i], "--bucket-lines") == 0) {
+                target = &options->bucket_lines;
             }
             if (parse_separate_size(argc, argv, &i, target) != 0) {
                 return -1;
@@ -113,7 +439,12 @@ static int parse_options(int argc, char **argv, Options *options)
         } else if (strncmp(argv[i], "--top=", 6u) == 0 ||
                    strncmp(argv[i], "--max-word=", 11u) == 0 ||
                    strncmp(argv[i], "--bench-runs=", 13u) == 0 ||
-                   strncmp(argv[i], "--bench-warmups=", 16u) == 0) {
+                   strncmp(argv[i], "--bench-warmups=", 16u) == 0 ||
+                   strncmp(argv[i], "--chunk-size=", 13u) == 0 ||
+                   strncmp(argv[i], "--threads=", 10u) == 0 ||
+                   strncmp(argv[i], "--approx=", 9u) == 0 ||
+                   strncmp(argv[i], "--window=", 9u) == 0 ||
+                   strncmp(argv[i], "--bucket-lines=", 15u) == 0) {
             size_t *target = strncmp(argv[i], "--top=", 6u) == 0
                                      ? &options->top
                                      : &options->max_word;
@@ -121,213 +452,2414 @@ static int parse_options(int argc, char **argv, Options *options)
                 target = &options->bench_runs;
             } else if (strncmp(argv[i], "--bench-warmups=", 16u) == 0) {
                 target = &options->bench_warmups;
+            } else if (strncmp(argv[i], "--chunk-size=", 13u) == 0) {
+                target = &options->chunk_size;
+            } else if (strncmp(argv[i], "--threads=", 10u) == 0) {
+                target = &options->threads;
+            } else if (strncmp(argv[i], "--approx=", 9u) == 0) {
+                target = &options->approx;
+            } else if (strncmp(argv[i], "--window=", 9u) == 0) {
+                target = &options->window;
+            } else if (strncmp(argv[i], "--bucket-lines=", 15u) == 0) {
+                target = &options->bucket_lines;
             }
             if (parse_prefixed_size(argv[i], target) != 0) {
                 return -1;
             }
-        } else if (options->path == NULL && argv[i][0] != '-') {
-            options->path = argv[i];
+        } else if (options->args != NULL &&
+                   (argv[i][0] != '-' || strcmp(argv[i], "-") == 0)) {
+            options->args[options->arg_count++] = argv[i];
         } else {
             return -1;
         }
     }
 
-    return options->path == NULL || options->top == 0u ? -1 : 0;
-}
+    if (options->threads == 0u) {
+        options->threads = available_cores();
+    }
 
-static int read_file(const char *path, unsigned char **data, size_t *len)
-{
-    FILE *file = fopen(path, "rb");
-    if (file == NULL) {
+    if (options->approx > 0u && (options->dump != NULL || options->merge ||
+                                 options->bench_runs > 0u)) {
         return -1;
     }
-
-    if (fseek(file, 0, SEEK_END) != 0) {
-        (void)fclose(file);
+    if (options->index != NULL &&
+        (options->approx > 0u || options->merge || options->bench_runs > 0u)) {
         return -1;
     }
-
-    long size = ftell(file);
-    if (size < 0 || fseek(file, 0, SEEK_SET) != 0) {
-        (void)fclose(file);
+    if (options->window > 0u &&
+        (options->dump != NULL || options->index != NULL || options->merge ||
+         options->approx > 0u || options->bench_runs > 0u)) {
         return -1;
     }
-
-    *len = (size_t)size;
-    *data = malloc(*len == 0 ? 1u : *len);
-    if (*data == NULL) {
-        (void)fclose(file);
+    if (options->stats &&
+        (options->index != NULL || options->merge || options->approx > 0u ||
+         options->window > 0u || options->bench_runs > 0u)) {
         return -1;
     }
-
-    if (*len > 0 && fread(*data, 1u, *len, file) != *len) {
-        free(*data);
-        (void)fclose(file);
+    if (options->bench_reuse &&
+        (options->bench_runs == 0u || options->threads != 1u)) {
         return -1;
     }
 
-    (void)fclose(file);
-    return 0;
+    return options->arg_count == 0u || options->top == 0u ||
+                           options->chunk_size == 0u ||
+                           options->bucket_lines == 0u
+                   ? -1
+                   : 0;
 }
 
-static void print_json(const WfResult *result, size_t top)
+static bool is_stdin(const char *path)
 {
-    size_t limit = result->unique < top ? result->unique : top;
-
-    printf("{\"total\":%" PRIu64 ",\"unique\":%zu,\"top\":[",
-           result->total,
-           result->unique);
-    for (size_t i = 0; i < limit; i++) {
-        printf("%s{\"word\":\"%s\",\"count\":%" PRIu64 "}",
-               i == 0 ? "" : ",",
-               result->entries[i].word,
-               result->entries[i].count);
-    }
-    puts("]}");
+    return strcmp(path, "-") == 0;
 }
 
-static void print_table(const WfResult *result, size_t top)
+#if defined(_WIN32)
+static bool is_pipe(const char *path)
 {
-    size_t limit = result->unique < top ? result->unique : top;
-
-    puts("count word");
-    for (size_t i = 0; i < limit; i++) {
-        printf("%" PRIu64 " %s\n",
-               result->entries[i].count,
-               result->entries[i].word);
-    }
-    printf("total %" PRIu64 "\nunique %zu\n", result->total, result->unique);
+    return is_stdin(path);
 }
+#else
+static bool is_pipe(const char *path)
+{
+    struct stat info;
+    return is_stdin(path) ||
+           (stat(path, &info) == 0 && !S_ISREG(info.st_mode) &&
+            !S_ISDIR(info.st_mode));
+}
+#endif
 
-static double now_ms(void)
+static FILE *open_input(const char *path)
 {
+    if (!is_stdin(path)) {
+        return fopen(path, "rb");
+    }
 #if defined(_WIN32)
-    LARGE_INTEGER frequency;
-    LARGE_INTEGER counter;
-    (void)QueryPerformanceFrequency(&frequency);
-    (void)QueryPerformanceCounter(&counter);
-    return (double)counter.QuadPart * 1000.0 / (double)frequency.QuadPart;
-#else
-    struct timespec time;
-    (void)clock_gettime(CLOCK_MONOTONIC, &time);
-    return (double)time.tv_sec * 1000.0 + (double)time.tv_nsec / 1000000.0;
+    (void)_setmode(_fileno(stdin), _O_BINARY);
 #endif
+    return stdin;
 }
 
-static uint32_t mix_byte(uint32_t checksum, unsigned char byte)
+static void close_input(FILE *file)
 {
-    return (checksum ^ (uint32_t)byte) * CHECKSUM_PRIME;
+    if (file != stdin) {
+        (void)fclose(file);
+    }
 }
 
-static uint32_t mix_u32(uint32_t checksum, uint32_t value)
+static Codec detect_codec(const unsigned char *bytes, size_t len)
 {
-    for (size_t i = 0; i < 4u; i++) {
-        checksum = mix_byte(checksum, (unsigned char)(value & UINT32_C(0xff)));
-        value >>= 8u;
+    if (len >= 2u && bytes[0] == 0x1fu && bytes[1] == 0x8bu) {
+        return CODEC_GZIP;
     }
-    return checksum;
+    if (len >= 4u && bytes[0] == 0x28u && bytes[1] == 0xb5u &&
+        bytes[2] == 0x2fu && bytes[3] == 0xfdu) {
+        return CODEC_ZSTD;
+    }
+    return CODEC_RAW;
 }
 
-static uint32_t mix_u64(uint32_t checksum, uint64_t value)
+static bool is_compressed(const char *path)
 {
-    for (size_t i = 0; i < 8u; i++) {
-        checksum = mix_byte(checksum, (unsigned char)(value & UINT64_C(0xff)));
-        value >>= 8u;
+    FILE *file = fopen(path, "rb");
+    if (file == NULL) {
+        return false;
     }
-    return checksum;
+
+    unsigned char magic[4];
+    size_t len = fread(magic, 1u, sizeof(magic), file);
+    (void)fclose(file);
+    return detect_codec(magic, len) != CODEC_RAW;
 }
 
-static uint32_t checksum_result(const WfResult *result, size_t top)
+static bool is_sequential(const char *path)
 {
-    size_t limit = result->unique < top ? result->unique : top;
-    uint32_t checksum = CHECKSUM_OFFSET;
-
-    checksum = mix_u64(checksum, result->total);
-    checksum = mix_u64(checksum, (uint64_t)result->unique);
+    return is_pipe(path) || is_compressed(path);
+}
 
-    for (size_t i = 0; i < limit; i++) {
-        const unsigned char *word =
-                (const unsigned char *)result->entries[i].word;
-        for (size_t index = 0; word[index] != '\0'; index++) {
-            checksum = mix_byte(checksum, word[index]);
-        }
-        checksum = mix_u64(checksum, result->entries[i].count);
+static void source_close(Source *source)
+{
+#if defined(WFC_ZLIB)
+    if (source->codec == CODEC_GZIP) {
+        (void)inflateEnd(&source->gzip);
     }
-
-    return checksum;
+#endif
+#if defined(WFC_ZSTD)
+    ZSTD_freeDCtx(source->zstd);
+#endif
+    free(source->in);
+    if (source->file != NULL) {
+        close_input(source->file);
+    }
+    *source = (Source){ 0 };
 }
 
-static int
-print_bench(const unsigned char *data, size_t len, const Options *options)
+static int source_open(Source *source, const char *path)
 {
-    for (size_t i = 0; i < options->bench_warmups; i++) {
-        WfResult result = { 0 };
-        if (wf_count_bytes(data, len, options->max_word, &result) != 0) {
-            return -1;
-        }
-        (void)checksum_result(&result, options->top);
-        wf_result_free(&result);
+    *source = (Source){ .file = open_input(path) };
+    if (source->file == NULL) {
+        return -1;
+    }
+    source->in = malloc(SOURCE_BUFFER);
+    if (source->in == NULL) {
+        source_close(source);
+        errno = ENOMEM;
+        return -1;
     }
 
-    uint32_t checksum = CHECKSUM_OFFSET;
-    double started = now_ms();
-    for (size_t i = 0; i < options->bench_runs; i++) {
-        WfResult result = { 0 };
-        if (wf_count_bytes(data, len, options->max_word, &result) != 0) {
+    source->in_len = fread(source->in, 1u, 4u, source->file);
+    if (source->in_len < 4u) {
+        source->drained = true;
+        if (ferror(source->file)) {
+            int error = errno;
+            source_close(source);
+            errno = error;
             return -1;
         }
-        checksum = mix_u32(checksum, checksum_result(&result, options->top));
-        wf_result_free(&result);
     }
-    double mean_ms = (now_ms() - started) / (double)options->bench_runs;
 
-    printf("{\"mean_ms\":%.6f,\"checksum\":%" PRIu32 "}\n", mean_ms, checksum);
+    int error = 0;
+    source->codec = detect_codec(source->in, source->in_len);
+    if (source->codec == CODEC_GZIP) {
+#if defined(WFC_ZLIB)
+        error = inflateInit2(&source->gzip, 15 + 16) == Z_OK ? 0 : ENOMEM;
+#else
+        error = UNSUPPORTED_INPUT;
+#endif
+    } else if (source->codec == CODEC_ZSTD) {
+#if defined(WFC_ZSTD)
+        source->zstd = ZSTD_createDCtx();
+        error = source->zstd != NULL ? 0 : ENOMEM;
+#else
+        error = UNSUPPORTED_INPUT;
+#endif
+    }
+    if (error != 0) {
+        source->codec = CODEC_RAW;
+        source_close(source);
+        errno = error;
+        return -1;
+    }
     return 0;
 }
 
-int main(int argc, char **argv)
+static size_t copy_raw(Source *source, unsigned char *out, size_t size)
 {
-    Options options;
-    unsigned char *data = NULL;
-    size_t len = 0;
-    WfResult result = { 0 };
+    size_t got = source->in_len - source->in_pos;
+    if (got > size) {
+        got = size;
+    }
+    memcpy(out, source->in + source->in_pos, got);
+    source->in_pos += got;
 
-    if (parse_options(argc, argv, &options) != 0) {
-        usage(argv[0]);
-        return 2;
+    if (got < size && !source->drained) {
+        size_t read = fread(out + got, 1u, size - got, source->file);
+        if (read < size - got) {
+            source->drained = true;
+            if (ferror(source->file)) {
+                source->error = errno != 0 ? errno : EIO;
+            }
+        }
+        got += read;
     }
+    return got;
+}
 
-    if (read_file(options.path, &data, &len) != 0) {
-        (void)fprintf(stderr,
-                      "wordcount_c: cannot read %s: %s\n",
-                      options.path,
-                      strerror(errno));
-        return 1;
+#if defined(WFC_ZLIB) || defined(WFC_ZSTD)
+static bool source_fill(Source *source)
+{
+    if (source->in_pos < source->in_len) {
+        return true;
+    }
+    if (source->drained) {
+        return false;
     }
 
-    if (options.bench_runs > 0u) {
-        if (print_bench(data, len, &options) != 0) {
-            (void)fprintf(stderr, "wordcount_c: out of memory\n");
-            free(data);
-            return 1;
+    source->in_pos = 0;
+    source->in_len = fread(source->in, 1u, SOURCE_BUFFER, source->file);
+    if (source->in_len < SOURCE_BUFFER) {
+        source->drained = true;
+        if (ferror(source->file)) {
+            source->error = errno != 0 ? errno : EIO;
         }
-        free(data);
-        return 0;
     }
+    return source->in_len > 0u;
+}
+#endif
 
-    if (wf_count_bytes(data, len, options.max_word, &result) != 0) {
-        (void)fprintf(stderr, "wordcount_c: out of memory\n");
-        free(data);
-        return 1;
+#if defined(WFC_ZLIB)
+static size_t inflate_into(Source *source, unsigned char *out, size_t size)
+{
+    z_stream *gzip = &source->gzip;
+    gzip->next_out = out;
+    gzip->avail_out = (uInt)(size < UINT_MAX ? size : UINT_MAX);
+
+    while (gzip->avail_out > 0u && source->error == 0) {
+        bool more = source_fill(source);
+        if (!more && source->finished) {
+            break;
+        }
+        if (more && source->finished) {
+            if (inflateReset(gzip) != Z_OK) {
+                source->error = CORRUPT_INPUT;
+                break;
+            }
+            source->finished = false;
+        }
+
+        gzip->next_in = source->in + source->in_pos;
+        gzip->avail_in = (uInt)(source->in_len - source->in_pos);
+        int status = inflate(gzip, Z_NO_FLUSH);
+        source->in_pos = source->in_len - gzip->avail_in;
+        if (status == Z_STREAM_END) {
+            source->finished = true;
+        } else if (status != Z_OK && source->error == 0) {
+            source->error = CORRUPT_INPUT;
+        }
     }
+    return (size_t)(gzip->next_out - out);
+}
+#endif
 
-    if (options.json) {
-        print_json(&result, options.top);
-    } else {
-        print_table(&result, options.top);
+#if defined(WFC_ZSTD)
+static size_t zstd_into(Source *source, unsigned char *out, size_t size)
+{
+    ZSTD_outBuffer output = { .dst = out, .size = size, .pos = 0 };
+
+    while (output.pos < output.size && source->error == 0) {
+        bool more = source_fill(source);
+        if (!more && source->finished) {
+            break;
+        }
+
+        ZSTD_inBuffer input = { .src = source->in,
+                                .size = source->in_len,
+                                .pos = source->in_pos };
+        size_t before = output.pos;
+        size_t status = ZSTD_decompressStream(source->zstd, &output, &input);
+        source->in_pos = input.pos;
+        if (ZSTD_isError(status) ||
+            (!more && status != 0u && output.pos == before)) {
+            if (source->error == 0) {
+                source->error = CORRUPT_INPUT;
+            }
+            break;
+        }
+        source->finished = status == 0u;
     }
+    return output.pos;
+}
+#endif
 
-    wf_result_free(&result);
-    free(data);
+static size_t source_read(Source *source, unsigned char *out, size_t size)
+{
+    switch (source->codec) {
+#if defined(WFC_ZLIB)
+    case CODEC_GZIP:
+        return inflate_into(source, out, size);
+#endif
+#if defined(WFC_ZSTD)
+    case CODEC_ZSTD:
+        return zstd_into(source, out, size);
+#endif
+    default:
+        return copy_raw(source, out, size);
+    }
+}
+
+static int read_source(Source *source, unsigned char **data, size_t *len)
+{
+    size_t cap = DEFAULT_CHUNK_SIZE;
+    unsigned char *buffer = malloc(cap);
+    size_t used = 0;
+    size_t got = 0;
+
+    while (buffer != NULL &&
+           (got = source_read(source, buffer + used, cap - used)) > 0u) {
+        used += got;
+        if (used == cap) {
+            unsigned char *grown =
+                    cap > SIZE_MAX / 2u ? NULL : realloc(buffer, cap * 2u);
+            if (grown == NULL) {
+                free(buffer);
+                buffer = NULL;
+                break;
+            }
+            buffer = grown;
+            cap *= 2u;
+        }
+    }
+    if (buffer == NULL || source->error != 0) {
+        free(buffer);
+        errno = buffer == NULL ? ENOMEM : source->error;
+        return -1;
+    }
+
+    *data = buffer;
+    *len = used;
     return 0;
 }
+
+static int read_whole(FILE *file, unsigned char **data, size_t *len)
+{
+    if (fseek(file, 0, SEEK_END) != 0) {
+        return -1;
+    }
+
+    long size = ftell(file);
+    if (size < 0 || fseek(file, 0, SEEK_SET) != 0) {
+        return -1;
+    }
+
+    *len = (size_t)size;
+    *data = malloc(*len == 0 ? 1u : *len);
+    if (*data == NULL) {
+        return -1;
+    }
+
+    if (*len > 0 && fread(*data, 1u, *len, file) != *len) {
+        free(*data);
+        return -1;
+    }
+    return 0;
+}
+
+static int read_file(const char *path, unsigned char **data, size_t *len)
+{
+    Source source;
+    if (source_open(&source, path) != 0) {
+        return -1;
+    }
+
+    int status = source.codec == CODEC_RAW && !is_pipe(path)
+                         ? read_whole(source.file, data, len)
+                         : read_source(&source, data, len);
+    int error = errno;
+    source_close(&source);
+    errno = error;
+    return status;
+}
+
+#if defined(_WIN32)
+static int map_file(const char *path, Input *input)
+{
+    (void)path;
+    (void)input;
+    return -1;
+}
+
+static void unmap_file(Input *input)
+{
+    (void)input;
+}
+#else
+static int map_file(const char *path, Input *input)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return -1;
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || !S_ISREG(info.st_mode) || info.st_size <= 0) {
+        (void)close(fd);
+        return -1;
+    }
+
+    size_t len = (size_t)info.st_size;
+    void *data = mmap(NULL, len, PROT_READ, MAP_PRIVATE, fd, 0);
+    (void)close(fd);
+    if (data == MAP_FAILED) {
+        return -1;
+    }
+
+    (void)posix_madvise(data, len, POSIX_MADV_SEQUENTIAL);
+    (void)posix_madvise(data, len, POSIX_MADV_WILLNEED);
+    *input = (Input){ .data = data, .len = len, .mapped = true };
+    return 0;
+}
+
+static void unmap_file(Input *input)
+{
+    (void)munmap(input->data, input->len);
+}
+#endif
+
+static int load_input(const char *path, InputMode mode, Input *input)
+{
+    *input = (Input){ .data = NULL, .len = 0u, .mapped = false };
+    if (mode == INPUT_MMAP && !is_compressed(path) &&
+        map_file(path, input) == 0) {
+        return 0;
+    }
+    return read_file(path, &input->data, &input->len);
+}
+
+static void free_input(Input *input)
+{
+    if (input->mapped) {
+        unmap_file(input);
+    } else {
+        free(input->data);
+    }
+    *input = (Input){ .data = NULL, .len = 0u, .mapped = false };
+}
+
+typedef int (*FeedFn)(void *sink, const unsigned char *data, size_t len);
+
+static int feed_counter(void *sink, const unsigned char *data, size_t len)
+{
+    return wf_counter_feed(sink, data, len);
+}
+
+static int feed_approx(void *sink, const unsigned char *data, size_t len)
+{
+    return wf_approx_feed(sink, data, len);
+}
+
+static int read_ahead(void *arg)
+{
+    Readahead *ahead = arg;
+
+    for (size_t i = 0;; i ^= 1u) {
+        (void)mtx_lock(&ahead->lock);
+        while (ahead->full[i] && !ahead->stop) {
+            (void)cnd_wait(&ahead->changed, &ahead->lock);
+        }
+        bool stop = ahead->stop;
+        (void)mtx_unlock(&ahead->lock);
+        if (stop) {
+            return 0;
+        }
+
+        size_t got = source_read(ahead->source, ahead->buffers[i], ahead->size);
+
+        (void)mtx_lock(&ahead->lock);
+        ahead->lens[i] = got;
+        ahead->full[i] = got > 0u;
+        ahead->done = got == 0u || ahead->source->error != 0;
+        ahead->error = ahead->source->error;
+        bool done = ahead->done;
+        (void)cnd_broadcast(&ahead->changed);
+        (void)mtx_unlock(&ahead->lock);
+        if (done) {
+            return 0;
+        }
+    }
+}
+
+static bool readahead_next(Readahead *ahead,
+                           const unsigned char **data,
+                           size_t *len)
+{
+    size_t i = ahead->next;
+
+    (void)mtx_lock(&ahead->lock);
+    if (ahead->holding) {
+        ahead->full[i ^ 1u] = false;
+        (void)cnd_broadcast(&ahead->changed);
+    }
+    while (!ahead->full[i] && !ahead->done) {
+        (void)cnd_wait(&ahead->changed, &ahead->lock);
+    }
+    bool ready = ahead->full[i];
+    (void)mtx_unlock(&ahead->lock);
+
+    *data = ahead->buffers[i];
+    *len = ahead->lens[i];
+    ahead->next = i ^ 1u;
+    ahead->holding = true;
+    return ready;
+}
+
+static int feed_ahead(Source *source,
+                      unsigned char *chunk,
+                      size_t chunk_size,
+                      FeedFn feed,
+                      void *sink)
+{
+    Readahead ahead = { .source = source,
+                        .buffers = { chunk, malloc(chunk_size) },
+                        .size = chunk_size };
+    if (ahead.buffers[1] == NULL) {
+        return OUT_OF_MEMORY;
+    }
+    if (mtx_init(&ahead.lock, mtx_plain) != thrd_success) {
+        free(ahead.buffers[1]);
+        return OUT_OF_MEMORY;
+    }
+    if (cnd_init(&ahead.changed) != thrd_success) {
+        mtx_destroy(&ahead.lock);
+        free(ahead.buffers[1]);
+        return OUT_OF_MEMORY;
+    }
+    if (thrd_create(&ahead.reader, read_ahead, &ahead) != thrd_success) {
+        cnd_destroy(&ahead.changed);
+        mtx_destroy(&ahead.lock);
+        free(ahead.buffers[1]);
+        return OUT_OF_MEMORY;
+    }
+
+    int status = 0;
+    const unsigned char *data = NULL;
+    size_t len = 0;
+    while (readahead_next(&ahead, &data, &len)) {
+        if (feed(sink, data, len) != 0) {
+            status = OUT_OF_MEMORY;
+            break;
+        }
+    }
+
+    (void)mtx_lock(&ahead.lock);
+    ahead.stop = true;
+    (void)cnd_broadcast(&ahead.changed);
+    (void)mtx_unlock(&ahead.lock);
+    (void)thrd_join(ahead.reader, NULL);
+    if (status == 0 && ahead.error != 0) {
+        errno = ahead.error;
+        status = READ_ERROR;
+    }
+
+    cnd_destroy(&ahead.changed);
+    mtx_destroy(&ahead.lock);
+    free(ahead.buffers[1]);
+    return status;
+}
+
+static int feed_stream(const char *path,
+                       unsigned char *chunk,
+                       size_t chunk_size,
+                       FeedFn feed,
+                       void *sink)
+{
+    Source source;
+    if (source_open(&source, path) != 0) {
+        return READ_ERROR;
+    }
+    if (source.codec != CODEC_RAW || is_pipe(path)) {
+        int status = feed_ahead(&source, chunk, chunk_size, feed, sink);
+        int error = errno;
+        source_close(&source);
+        errno = error;
+        return status;
+    }
+
+    int status = 0;
+    size_t got = 0;
+    while ((got = source_read(&source, chunk, chunk_size)) > 0u) {
+        if (feed(sink, chunk, got) != 0) {
+            status = OUT_OF_MEMORY;
+            break;
+        }
+    }
+    if (status == 0 && source.error != 0) {
+        errno = source.error;
+        status = READ_ERROR;
+    }
+
+    source_close(&source);
+    return status;
+}
+
+static WfCounter *open_counter(const Options *options)
+{
+    WfCounter *counter = wf_counter_new(options->max_word, 0u);
+    if (counter != NULL) {
+        wf_counter_set_options(counter, &options->counting);
+    }
+    return counter;
+}
+
+static int stream_file(const char *path,
+                       const Options *options,
+                       WfResult *result)
+{
+    unsigned char *chunk = malloc(options->chunk_size);
+    WfCounter *counter = open_counter(options);
+    if (chunk == NULL || counter == NULL) {
+        free(chunk);
+        wf_counter_free(counter);
+        return OUT_OF_MEMORY;
+    }
+
+    int status = feed_stream(
+            path, chunk, options->chunk_size, feed_counter, counter);
+    if (status == 0 && wf_counter_finish(counter, result) != 0) {
+        status = OUT_OF_MEMORY;
+    }
+
+    wf_counter_free(counter);
+    free(chunk);
+    return status;
+}
+
+static int out_of_memory(void)
+{
+    (void)fprintf(stderr, "wordcount_c: out of memory\n");
+    return -1;
+}
+
+static int cannot_read(const char *path)
+{
+    const char *reason = errno == CORRUPT_INPUT ? "corrupt compressed data"
+                         : errno == UNSUPPORTED_INPUT
+                                 ? "compression format not supported"
+                                 : strerror(errno);
+    (void)fprintf(stderr, "wordcount_c: cannot read %s: %s\n", path, reason);
+    return -1;
+}
+
+static int cannot_write(const char *path)
+{
+    (void)fprintf(stderr,
+                  "wordcount_c: cannot write %s: %s\n",
+                  path,
+                  strerror(errno));
+    return -1;
+}
+
+static int path_list_push(PathList *paths, char *path)
+{
+    if (paths->len == paths->cap) {
+        size_t cap = paths->cap == 0u ? 16u : paths->cap * 2u;
+        char **items = realloc(paths->items, cap * sizeof(*items));
+        if (items == NULL) {
+            free(path);
+            return out_of_memory();
+        }
+        paths->items = items;
+        paths->cap = cap;
+    }
+
+    paths->items[paths->len++] = path;
+    return 0;
+}
+
+static void path_list_free(PathList *paths)
+{
+    for (size_t i = 0; i < paths->len; i++) {
+        free(paths->items[i]);
+    }
+    free(paths->items);
+    *paths = (PathList){ 0 };
+}
+
+static char *copy_path(const char *path, size_t len)
+{
+    char *copy = malloc(len + 1u);
+    if (copy != NULL) {
+        memcpy(copy, path, len);
+        copy[len] = '\0';
+    }
+    return copy;
+}
+
+static char *join_path(const char *dir, const char *name)
+{
+    size_t dir_len = strlen(dir);
+    size_t name_len = strlen(name);
+    bool slash = dir_len > 0u && dir[dir_len - 1u] != '/';
+    char *path = malloc(dir_len + (slash ? 1u : 0u) + name_len + 1u);
+    if (path == NULL) {
+        return NULL;
+    }
+
+    memcpy(path, dir, dir_len);
+    if (slash) {
+        path[dir_len++] = '/';
+    }
+    memcpy(path + dir_len, name, name_len + 1u);
+    return path;
+}
+
+static int compare_paths(const void *left, const void *right)
+{
+    return strcmp(*(char *const *)left, *(char *const *)right);
+}
+
+#if defined(_WIN32)
+static bool is_directory(const char *path)
+{
+    DWORD attributes = GetFileAttributesA(path);
+    return attributes != INVALID_FILE_ATTRIBUTES &&
+           (attributes & FILE_ATTRIBUTE_DIRECTORY) != 0;
+}
+
+static uint64_t file_size(const char *path)
+{
+    WIN32_FILE_ATTRIBUTE_DATA info;
+    if (!GetFileAttributesExA(path, GetFileExInfoStandard, &info)) {
+        return 0u;
+    }
+    return ((uint64_t)info.nFileSizeHigh << 32u) | info.nFileSizeLow;
+}
+
+static int walk_directory(PathList *paths, const char *dir)
+{
+    char *pattern = join_path(dir, "*");
+    if (pattern == NULL) {
+        return out_of_memory();
+    }
+
+    WIN32_FIND_DATAA entry;
+    HANDLE find = FindFirstFileA(pattern, &entry);
+    free(pattern);
+    if (find == INVALID_HANDLE_VALUE) {
+        return cannot_read(dir);
+    }
+
+    int status = 0;
+    do {
+        if (strcmp(entry.cFileName, ".") == 0 ||
+            strcmp(entry.cFileName, "..") == 0) {
+            continue;
+        }
+        char *child = join_path(dir, entry.cFileName);
+        if (child == NULL) {
+            status = out_of_memory();
+        } else if ((entry.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) == 0) {
+            status = path_list_push(paths, child);
+        } else {
+            if ((entry.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT) == 0) {
+                status = walk_directory(paths, child);
+            }
+            free(child);
+        }
+    } while (status == 0 && FindNextFileA(find, &entry));
+
+    (void)FindClose(find);
+    return status;
+}
+#else
+static bool is_directory(const char *path)
+{
+    struct stat info;
+    return stat(path, &info) == 0 && S_ISDIR(info.st_mode);
+}
+
+static uint64_t file_size(const char *path)
+{
+    struct stat info;
+    return stat(path, &info) == 0 && info.st_size > 0 ? (uint64_t)info.st_size
+                                                       : 0u;
+}
+
+static int walk_directory(PathList *paths, const char *dir)
+{
+    DIR *stream = opendir(dir);
+    if (stream == NULL) {
+        return cannot_read(dir);
+    }
+
+    int status = 0;
+    struct dirent *entry = NULL;
+    while (status == 0 && (entry = readdir(stream)) != NULL) {
+        if (strcmp(entry->d_name, ".") == 0 ||
+            strcmp(entry->d_name, "..") == 0) {
+            continue;
+        }
+        char *child = join_path(dir, entry->d_name);
+        if (child == NULL) {
+            status = out_of_memory();
+            break;
+        }
+
+        struct stat info;
+        if (lstat(child, &info) == 0 && S_ISDIR(info.st_mode)) {
+            status = walk_directory(paths, child);
+        } else if (stat(child, &info) == 0 && S_ISREG(info.st_mode)) {
+            status = path_list_push(paths, child);
+            continue;
+        }
+        free(child);
+    }
+
+    (void)closedir(stream);
+    return status;
+}
+#endif
+
+static int expand_path(PathList *paths, const char *path, size_t len)
+{
+    char *copy = copy_path(path, len);
+    if (copy == NULL) {
+        return out_of_memory();
+    }
+    if (!is_directory(copy)) {
+        return path_list_push(paths, copy);
+    }
+
+    size_t start = paths->len;
+    int status = walk_directory(paths, copy);
+    free(copy);
+    if (status == 0) {
+        qsort(paths->items + start,
+              paths->len - start,
+              sizeof(*paths->items),
+              compare_paths);
+    }
+    return status;
+}
+
+static int expand_list(PathList *paths, const char *list)
+{
+    unsigned char *data = NULL;
+    size_t len = 0;
+    if (read_file(list, &data, &len) != 0) {
+        return cannot_read(list);
+    }
+
+    int status = 0;
+    size_t start = 0;
+    while (status == 0 && start < len) {
+        const unsigned char *newline = memchr(data + start, '\n', len - start);
+        size_t end = newline == NULL ? len : (size_t)(newline - data);
+        size_t line_end = end;
+        if (line_end > start && data[line_end - 1u] == '\r') {
+            line_end--;
+        }
+        if (line_end > start) {
+            status = expand_path(
+                    paths, (const char *)data + start, line_end - start);
+        }
+        start = end + 1u;
+    }
+
+    free(data);
+    return status;
+}
+
+static int expand_paths(const Options *options, PathList *paths)
+{
+    *paths = (PathList){ 0 };
+    for (size_t i = 0; i < options->arg_count; i++) {
+        const char *arg = options->args[i];
+        int status = arg[0] == '@'
+                             ? expand_list(paths, arg + 1u)
+                             : expand_path(paths, arg, strlen(arg));
+        if (status != 0) {
+            path_list_free(paths);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static int compare_sized(const void *left, const void *right)
+{
+    const SizedPath *a = left;
+    const SizedPath *b = right;
+
+    if (a->size != b->size) {
+        return a->size > b->size ? -1 : 1;
+    }
+    return a->index < b->index ? -1 : a->index > b->index;
+}
+
+static bool next_file(FileWorker *worker, size_t *index)
+{
+    for (size_t offset = 0; offset < worker->workers; offset++) {
+        FileQueue *queue =
+                &worker->queues[(worker->id + offset) % worker->workers];
+        bool found = false;
+
+        (void)mtx_lock(&queue->lock);
+        if (queue->head < queue->tail) {
+            *index = offset == 0u ? queue->items[queue->head++]
+                                  : queue->items[--queue->tail];
+            found = true;
+        }
+        (void)mtx_unlock(&queue->lock);
+        if (found) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static int count_file(FileWorker *worker, const char *path)
+{
+    const Options *options = worker->options;
+    int status = 0;
+
+    if (options->input == INPUT_STREAM || is_sequential(path)) {
+        if (worker->chunk == NULL) {
+            worker->chunk = malloc(options->chunk_size);
+        }
+        if (worker->chunk == NULL) {
+            return OUT_OF_MEMORY;
+        }
+        status = feed_stream(path,
+                             worker->chunk,
+                             options->chunk_size,
+                             feed_counter,
+                             worker->counter);
+    } else {
+        Input input;
+        if (load_input(path, options->input, &input) != 0) {
+            return READ_ERROR;
+        }
+        if (wf_counter_feed(worker->counter, input.data, input.len) != 0) {
+            status = OUT_OF_MEMORY;
+        }
+        free_input(&input);
+    }
+
+    if (status == 0 && wf_counter_end_word(worker->counter) != 0) {
+        status = OUT_OF_MEMORY;
+    }
+    return status;
+}
+
+static int file_worker(void *arg)
+{
+    FileWorker *worker = arg;
+    size_t index = 0;
+
+    while (worker->status == 0 && next_file(worker, &index)) {
+        const char *path = worker->paths->items[index];
+        worker->status = count_file(worker, path);
+        if (worker->status == READ_ERROR) {
+            worker->failed = path;
+            worker->error = errno;
+        }
+    }
+    return 0;
+}
+
+static int schedule_files(const PathList *paths,
+                          FileQueue *queues,
+                          size_t *items,
+                          size_t workers)
+{
+    SizedPath *sized = malloc(paths->len * sizeof(*sized));
+    if (sized == NULL) {
+        return -1;
+    }
+    for (size_t i = 0; i < paths->len; i++) {
+        sized[i] = (SizedPath){ .size = file_size(paths->items[i]),
+                                .index = i };
+    }
+    qsort(sized, paths->len, sizeof(*sized), compare_sized);
+
+    size_t per_queue = (paths->len + workers - 1u) / workers;
+    for (size_t w = 0; w < workers; w++) {
+        queues[w].items = items + w * per_queue;
+    }
+    for (size_t rank = 0; rank < paths->len; rank++) {
+        FileQueue *queue = &queues[rank % workers];
+        queue->items[queue->tail++] = sized[rank].index;
+    }
+
+    free(sized);
+    return 0;
+}
+
+static int count_files(const PathList *paths,
+                       const Options *options,
+                       WfResult *result,
+                       const char **failed)
+{
+    size_t workers = options->threads < paths->len ? options->threads
+                                                   : paths->len;
+    if (workers == 0u) {
+        workers = 1u;
+    }
+
+    FileQueue *queues = calloc(workers, sizeof(*queues));
+    FileWorker *pool = calloc(workers, sizeof(*pool));
+    thrd_t *handles = calloc(workers, sizeof(*handles));
+    size_t *items = calloc(paths->len + workers, sizeof(*items));
+    if (queues == NULL || pool == NULL || handles == NULL || items == NULL ||
+        schedule_files(paths, queues, items, workers) != 0) {
+        free(queues);
+        free(pool);
+        free(handles);
+        free(items);
+        return OUT_OF_MEMORY;
+    }
+
+    int status = 0;
+    size_t ready = 0;
+    for (; ready < workers; ready++) {
+        pool[ready] = (FileWorker){ .queues = queues,
+                                    .workers = workers,
+                                    .id = ready,
+                                    .paths = paths,
+                                    .options = options };
+        if (mtx_init(&queues[ready].lock, mtx_plain) != thrd_success) {
+            status = OUT_OF_MEMORY;
+            break;
+        }
+        pool[ready].counter = open_counter(options);
+        if (options->input == INPUT_STREAM) {
+            pool[ready].chunk = malloc(options->chunk_size);
+        }
+        if (pool[ready].counter == NULL ||
+            (options->input == INPUT_STREAM && pool[ready].chunk == NULL)) {
+            status = OUT_OF_MEMORY;
+            ready++;
+            break;
+        }
+    }
+
+    size_t started = 1;
+    if (status == 0) {
+        for (; started < workers; started++) {
+            if (thrd_create(&handles[started], file_worker, &pool[started]) !=
+                thrd_success) {
+                break;
+            }
+        }
+        (void)file_worker(&pool[0]);
+        for (size_t w = 1; w < started; w++) {
+            (void)thrd_join(handles[w], NULL);
+        }
+    }
+
+    int error = 0;
+    for (size_t w = 0; w < ready; w++) {
+        if (status == 0 && pool[w].status != 0) {
+            status = pool[w].status;
+            *failed = pool[w].failed;
+            error = pool[w].error;
+        }
+        if (status == 0 && w > 0u &&
+            wf_counter_merge(pool[0].counter, pool[w].counter) != 0) {
+            status = OUT_OF_MEMORY;
+        }
+    }
+    if (status == 0 && wf_counter_finish(pool[0].counter, result) != 0) {
+        status = OUT_OF_MEMORY;
+    }
+
+    for (size_t w = 0; w < ready; w++) {
+        wf_counter_free(pool[w].counter);
+        free(pool[w].chunk);
+        mtx_destroy(&queues[w].lock);
+    }
+    free(queues);
+    free(pool);
+    free(handles);
+    free(items);
+    errno = error;
+    return status;
+}
+
+static int count_bytes(const unsigned char *data,
+                       size_t len,
+                       const Options *options,
+                       WfResult *result)
+{
+    if (options->input != INPUT_STREAM && options->threads > 1u) {
+        return wf_count_bytes_parallel_with(data,
+                                            len,
+                                            options->max_word,
+                                            options->threads,
+                                            &options->counting,
+                                            result);
+    }
+    if (options->input != INPUT_STREAM) {
+        return wf_count_bytes_with(
+                data, len, options->max_word, &options->counting, result);
+    }
+
+    WfCounter *counter = open_counter(options);
+    if (counter == NULL) {
+        return -1;
+    }
+
+    size_t chunk_size = options->chunk_size;
+    for (size_t offset = 0; offset < len; offset += chunk_size) {
+        size_t remaining = len - offset;
+        size_t size = remaining < chunk_size ? remaining : chunk_size;
+        if (wf_counter_feed(counter, data + offset, size) != 0) {
+            wf_counter_free(counter);
+            return -1;
+        }
+    }
+
+    int status = wf_counter_finish(counter, result);
+    wf_counter_free(counter);
+    return status;
+}
+
+static void output_flush(Output *out)
+{
+    if (out->len > 0u && !out->failed &&
+        fwrite(out->bytes, 1u, out->len, stdout) != out->len) {
+        out->failed = true;
+    }
+    out->len = 0;
+}
+
+static void output_bytes(Output *out, const char *bytes, size_t len)
+{
+    if (OUTPUT_BUFFER - out->len < len) {
+        output_flush(out);
+    }
+    if (len > OUTPUT_BUFFER) {
+        if (!out->failed && fwrite(bytes, 1u, len, stdout) != len) {
+            out->failed = true;
+        }
+        return;
+    }
+    memcpy(out->bytes + out->len, bytes, len);
+    out->len += len;
+}
+
+static void output_text(Output *out, const char *text)
+{
+    output_bytes(out, text, strlen(text));
+}
+
+static void output_u64(Output *out, uint64_t value)
+{
+    char digits[20];
+    size_t len = 0;
+
+    do {
+        digits[sizeof(digits) - ++len] = (char)('0' + value % 10u);
+        value /= 10u;
+    } while (value != 0u);
+    output_bytes(out, digits + sizeof(digits) - len, len);
+}
+
+static void output_json(Output *out, const char *text)
+{
+    static const char hex[] = "0123456789abcdef";
+    const char *run = text;
+
+    output_bytes(out, "\"", 1u);
+    for (;; text++) {
+        unsigned char byte = (unsigned char)*text;
+
+        if (byte >= 0x20u && byte != '"' && byte != '\\') {
+            continue;
+        }
+        output_bytes(out, run, (size_t)(text - run));
+        if (byte == '\0') {
+            break;
+        }
+        if (byte == '"' || byte == '\\') {
+            char escape[2] = { '\\', (char)byte };
+            output_bytes(out, escape, sizeof(escape));
+        } else {
+            char escape[6] = { '\\', 'u', '0', '0', hex[byte >> 4u],
+                               hex[byte & 0xfu] };
+            output_bytes(out, escape, sizeof(escape));
+        }
+        run = text + 1;
+    }
+    output_bytes(out, "\"", 1u);
+}
+
+static void output_row(Output *out,
+                       Format format,
+                       size_t index,
+                       const char *word,
+                       uint64_t count,
+                       const uint64_t *error)
+{
+    if (format == FORMAT_TEXT) {
+        output_u64(out, count);
+        output_bytes(out, " ", 1u);
+        output_text(out, word);
+        if (error != NULL) {
+            output_bytes(out, " ", 1u);
+            output_u64(out, *error);
+        }
+        output_bytes(out, "\n", 1u);
+        return;
+    }
+    if (format == FORMAT_TSV) {
+        output_text(out, word);
+        output_bytes(out, "\t", 1u);
+        output_u64(out, count);
+        if (error != NULL) {
+            output_bytes(out, "\t", 1u);
+            output_u64(out, *error);
+        }
+        output_bytes(out, "\n", 1u);
+        return;
+    }
+
+    output_text(out,
+                format == FORMAT_JSON && index > 0u ? ",{\"word\":"
+                                                    : "{\"word\":");
+    output_json(out, word);
+    output_text(out, ",\"count\":");
+    output_u64(out, count);
+    if (error != NULL) {
+        output_text(out, ",\"error\":");
+        output_u64(out, *error);
+    }
+    output_text(out, format == FORMAT_NDJSON ? "}\n" : "}");
+}
+
+static int output_finish(Output *out)
+{
+    output_flush(out);
+    if (fflush(stdout) != 0) {
+        out->failed = true;
+    }
+    return out->failed ? cannot_write("standard output") : 0;
+}
+
+static int print_ranked(const WfResult *result,
+                        size_t unique,
+                        const Options *options)
+{
+    size_t limit = result->unique < options->top ? result->unique
+                                                 : options->top;
+    Output out = { .len = 0 };
+
+    if (options->format == FORMAT_JSON) {
+        output_text(&out, "{\"total\":");
+        output_u64(&out, result->total);
+        output_text(&out, ",\"unique\":");
+        output_u64(&out, (uint64_t)unique);
+        output_text(&out, ",\"top\":[");
+    } else if (options->format == FORMAT_TEXT) {
+        output_text(&out, "count word\n");
+    } else if (options->format == FORMAT_TSV) {
+        output_text(&out, "word\tcount\n");
+    }
+
+    for (size_t i = 0; i < limit; i++) {
+        output_row(&out,
+                   options->format,
+                   i,
+                   result->entries[i].word,
+                   result->entries[i].count,
+                   NULL);
+    }
+
+    if (options->format == FORMAT_JSON) {
+        output_text(&out, "]}\n");
+    } else if (options->format == FORMAT_TEXT) {
+        output_text(&out, "total ");
+        output_u64(&out, result->total);
+        output_text(&out, "\nunique ");
+        output_u64(&out, (uint64_t)unique);
+        output_text(&out, "\n");
+    }
+    return output_finish(&out);
+}
+
+static int print_entries(const WfResult *result, const Options *options)
+{
+    return print_ranked(result, result->unique, options);
+}
+
+static double now_ms(void)
+{
+#if defined(_WIN32)
+    LARGE_INTEGER frequency;
+    LARGE_INTEGER counter;
+    (void)QueryPerformanceFrequency(&frequency);
+    (void)QueryPerformanceCounter(&counter);
+    return (double)counter.QuadPart * 1000.0 / (double)frequency.QuadPart;
+#else
+    struct timespec time;
+    (void)clock_gettime(CLOCK_MONOTONIC, &time);
+    return (double)time.tv_sec * 1000.0 + (double)time.tv_nsec / 1000000.0;
+#endif
+}
+
+static uint32_t mix_byte(uint32_t checksum, unsigned char byte)
+{
+    return (checksum ^ (uint32_t)byte) * CHECKSUM_PRIME;
+}
+
+static uint32_t mix_u32(uint32_t checksum, uint32_t value)
+{
+    for (size_t i = 0; i < 4u; i++) {
+        checksum = mix_byte(checksum, (unsigned char)(value & UINT32_C(0xff)));
+        value >>= 8u;
+    }
+    return checksum;
+}
+
+static uint32_t mix_u64(uint32_t checksum, uint64_t value)
+{
+    for (size_t i = 0; i < 8u; i++) {
+        checksum = mix_byte(checksum, (unsigned char)(value & UINT64_C(0xff)));
+        value >>= 8u;
+    }
+    return checksum;
+}
+
+static uint32_t checksum_result(const WfResult *result, size_t top)
+{
+    size_t limit = result->unique < top ? result->unique : top;
+    uint32_t checksum = CHECKSUM_OFFSET;
+
+    checksum = mix_u64(checksum, result->total);
+    checksum = mix_u64(checksum, (uint64_t)result->unique);
+
+    for (size_t i = 0; i < limit; i++) {
+        const unsigned char *word =
+                (const unsigned char *)result->entries[i].word;
+        for (size_t index = 0; word[index] != '\0'; index++) {
+            checksum = mix_byte(checksum, word[index]);
+        }
+        checksum = mix_u64(checksum, result->entries[i].count);
+    }
+
+    return checksum;
+}
+
+static int count_once(const Input *input,
+                      const PathList *paths,
+                      const Options *options,
+                      WfResult *result,
+                      const char **failed)
+{
+    if (input == NULL) {
+        return count_files(paths, options, result, failed);
+    }
+    return count_bytes(input->data, input->len, options, result) != 0
+                   ? OUT_OF_MEMORY
+                   : 0;
+}
+
+static int time_runs(const Input *input,
+                     const PathList *paths,
+                     const Options *options,
+                     const char **failed,
+                     double *mean_ms,
+                     uint32_t *checksum)
+{
+    for (size_t i = 0; i < options->bench_warmups; i++) {
+        WfResult result = { 0 };
+        int status = count_once(input, paths, options, &result, failed);
+        if (status != 0) {
+            return status;
+        }
+        (void)checksum_result(&result, options->top);
+        wf_result_free(&result);
+    }
+
+    *checksum = CHECKSUM_OFFSET;
+    double started = now_ms();
+    for (size_t i = 0; i < options->bench_runs; i++) {
+        WfResult result = { 0 };
+        int status = count_once(input, paths, options, &result, failed);
+        if (status != 0) {
+            return status;
+        }
+        *checksum = mix_u32(*checksum, checksum_result(&result, options->top));
+        wf_result_free(&result);
+    }
+    *mean_ms = (now_ms() - started) / (double)options->bench_runs;
+    return 0;
+}
+
+static int print_bench(const Input *input,
+                       const PathList *paths,
+                       const Options *options,
+                       const char **failed)
+{
+    double mean_ms = 0.0;
+    uint32_t checksum = 0u;
+    int status = time_runs(input, paths, options, failed, &mean_ms, &checksum);
+    if (status != 0) {
+        return status;
+    }
+
+    printf("{\"mean_ms\":%.6f,\"checksum\":%" PRIu32 "}\n", mean_ms, checksum);
+    return 0;
+}
+
+static int recount_once(WfCounter *counter,
+                        const Input *input,
+                        const Options *options,
+                        uint32_t *checksum)
+{
+    size_t chunk_size =
+            options->input == INPUT_STREAM ? options->chunk_size : input->len;
+    WfResult result = { 0 };
+
+    if (wf_counter_reset(counter) != 0) {
+        return OUT_OF_MEMORY;
+    }
+    for (size_t offset = 0; offset < input->len; offset += chunk_size) {
+        size_t remaining = input->len - offset;
+        size_t size = remaining < chunk_size ? remaining : chunk_size;
+        if (wf_counter_feed(counter, input->data + offset, size) != 0) {
+            return OUT_OF_MEMORY;
+        }
+    }
+    if (wf_counter_view(counter, &result) != 0) {
+        return OUT_OF_MEMORY;
+    }
+    *checksum = checksum_result(&result, options->top);
+    wf_result_free(&result);
+    return 0;
+}
+
+static int time_reused(const Input *input,
+                       const Options *options,
+                       double *mean_ms,
+                       uint32_t *checksum)
+{
+    WfCounter *counter = open_counter(options);
+    if (counter == NULL ||
+        wf_counter_reserve(counter,
+                           wf_estimate_unique(input->data,
+                                              input->len,
+                                              options->max_word)) != 0) {
+        wf_counter_free(counter);
+        return OUT_OF_MEMORY;
+    }
+
+    *checksum = CHECKSUM_OFFSET;
+    double started = now_ms();
+    for (size_t i = 0; i < options->bench_warmups + options->bench_runs; i++) {
+        uint32_t value = 0u;
+        int status = recount_once(counter, input, options, &value);
+        if (status != 0) {
+            wf_counter_free(counter);
+            return status;
+        }
+        if (i < options->bench_warmups) {
+            started = now_ms();
+            continue;
+        }
+        *checksum = mix_u32(*checksum, value);
+    }
+    *mean_ms = (now_ms() - started) / (double)options->bench_runs;
+    wf_counter_free(counter);
+    return 0;
+}
+
+#if defined(POSIX_FADV_DONTNEED)
+static bool evict_file(const char *path)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+
+    (void)fdatasync(fd);
+    bool evicted = posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED) == 0;
+    (void)close(fd);
+    return evicted;
+}
+#else
+static bool evict_file(const char *path)
+{
+    (void)path;
+    return false;
+}
+#endif
+
+static int count_cold(const Options *options, uint32_t *checksum)
+{
+    Input input;
+    WfResult result = { 0 };
+
+    (void)evict_file(options->path);
+    if (load_input(options->path, options->input, &input) != 0) {
+        return READ_ERROR;
+    }
+    int status = count_bytes(input.data, input.len, options, &result) != 0
+                         ? OUT_OF_MEMORY
+                         : 0;
+    free_input(&input);
+    if (status == 0) {
+        *checksum = checksum_result(&result, options->top);
+        wf_result_free(&result);
+    }
+    return status;
+}
+
+static int
+time_cold(const Options *options, double *mean_ms, uint32_t *checksum)
+{
+    *checksum = CHECKSUM_OFFSET;
+    double started = now_ms();
+    for (size_t i = 0; i < options->bench_warmups + options->bench_runs; i++) {
+        uint32_t value = 0u;
+        int status = count_cold(options, &value);
+        if (status != 0) {
+            return status;
+        }
+        if (i < options->bench_warmups) {
+            started = now_ms();
+            continue;
+        }
+        *checksum = mix_u32(*checksum, value);
+    }
+    *mean_ms = (now_ms() - started) / (double)options->bench_runs;
+    return 0;
+}
+
+static int print_reuse_bench(Input *input, const Options *options)
+{
+    double mean_ms = 0.0;
+    double reuse_ms = 0.0;
+    double cold_ms = 0.0;
+    uint32_t checksum = 0u;
+    uint32_t reuse_checksum = 0u;
+    uint32_t cold_checksum = 0u;
+
+    int status = time_runs(input, NULL, options, NULL, &mean_ms, &checksum);
+    if (status == 0) {
+        status = time_reused(input, options, &reuse_ms, &reuse_checksum);
+    }
+    free_input(input);
+    if (status != 0) {
+        return status;
+    }
+
+    bool cold = !is_sequential(options->path) && evict_file(options->path);
+    if (cold) {
+        status = time_cold(options, &cold_ms, &cold_checksum);
+        if (status != 0) {
+            return status;
+        }
+    }
+    if (reuse_checksum != checksum || (cold && cold_checksum != checksum)) {
+        (void)fprintf(stderr, "wordcount_c: bench checksum mismatch\n");
+        return 1;
+    }
+
+    printf("{\"mean_ms\":%.6f,\"reuse_ms\":%.6f,", mean_ms, reuse_ms);
+    if (cold) {
+        printf("\"cold_ms\":%.6f,", cold_ms);
+    } else {
+        printf("\"cold_ms\":null,");
+    }
+    printf("\"checksum\":%" PRIu32 "}\n", checksum);
+    return 0;
+}
+
+static int write_dump(const WfResult *result, const char *path)
+{
+    unsigned char *data = NULL;
+    size_t len = 0;
+    if (wf_result_encode(result, &data, &len) != 0) {
+        return out_of_memory();
+    }
+
+    FILE *file = fopen(path, "wb");
+    if (file == NULL) {
+        free(data);
+        return cannot_write(path);
+    }
+    bool written = fwrite(data, 1u, len, file) == len;
+    if (fclose(file) != 0) {
+        written = false;
+    }
+
+    free(data);
+    return written ? 0 : cannot_write(path);
+}
+
+static int print_result(const WfResult *result, const Options *options)
+{
+    if (options->dump != NULL && write_dump(result, options->dump) != 0) {
+        return -1;
+    }
+    return print_entries(result, options);
+}
+
+static uint64_t elapsed_ns(double started)
+{
+    return (uint64_t)((now_ms() - started) * 1000000.0);
+}
+
+static void print_stats(const WfResult *result, const Phases *phases)
+{
+    const WfStats *stats = &result->stats;
+    uint64_t rank = stats->rank_ns < phases->count_ns ? stats->rank_ns
+                                                      : phases->count_ns;
+    uint64_t lookups = stats->inserts + stats->hits;
+
+    (void)fprintf(stderr,
+                  "{\"engine\":\"c\",\"tokens\":%" PRIu64 ",\"unique\":%zu,",
+                  result->total,
+                  result->unique);
+    if (wf_stats_enabled()) {
+        (void)fprintf(stderr,
+                      "\"inserts\":%" PRIu64 ",\"hits\":%" PRIu64
+                      ",\"probe_mean\":%.3f,\"probe_max\":%" PRIu64 ",",
+                      stats->inserts,
+                      stats->hits,
+                      lookups == 0u ? 0.0
+                                    : (double)stats->probes / (double)lookups,
+                      stats->max_probe);
+    } else {
+        (void)fputs("\"inserts\":null,\"hits\":null,\"probe_mean\":null,"
+                    "\"probe_max\":null,",
+                    stderr);
+    }
+    (void)fprintf(stderr,
+                  "\"resizes\":%zu,\"capacity\":%zu,\"load_factor\":%.3f,"
+                  "\"max_bucket\":null,\"table_bytes\":%zu,\"phases_ns\":{",
+                  stats->resizes,
+                  stats->capacity,
+                  stats->capacity == 0u ? 0.0
+                                        : (double)result->unique /
+                                                  (double)stats->capacity,
+                  stats->bytes);
+    if (phases->loaded) {
+        (void)fprintf(stderr, "\"read\":%" PRIu64 ",", phases->read_ns);
+    } else {
+        (void)fputs("\"read\":null,", stderr);
+    }
+    (void)fprintf(stderr,
+                  "\"count\":%" PRIu64 ",\"rank\":%" PRIu64
+                  ",\"output\":%" PRIu64 "}}\n",
+                  phases->count_ns - rank,
+                  rank,
+                  phases->output_ns);
+}
+
+static int report_result(const WfResult *result,
+                         const Options *options,
+                         Phases *phases)
+{
+    double started = now_ms();
+    if (print_result(result, options) != 0) {
+        return 1;
+    }
+
+    phases->output_ns = elapsed_ns(started);
+    if (options->stats) {
+        print_stats(result, phases);
+    }
+    return 0;
+}
+
+static bool is_word_byte(unsigned char byte)
+{
+    return (byte >= (unsigned char)'A' && byte <= (unsigned char)'Z') ||
+           (byte >= (unsigned char)'a' && byte <= (unsigned char)'z');
+}
+
+static void store_u64(unsigned char *out, uint64_t value)
+{
+    for (size_t i = 0; i < 8u; i++) {
+        out[i] = (unsigned char)(value >> (8u * i));
+    }
+}
+
+static uint64_t load_u64(const unsigned char *bytes)
+{
+    uint64_t value = 0;
+    for (size_t i = 0; i < 8u; i++) {
+        value |= (uint64_t)bytes[i] << (8u * i);
+    }
+    return value;
+}
+
+#if defined(_WIN32)
+static int file_identity(const char *path, FileIdentity *file)
+{
+    HANDLE handle = CreateFileA(path,
+                                0,
+                                FILE_SHARE_READ | FILE_SHARE_WRITE |
+                                        FILE_SHARE_DELETE,
+                                NULL,
+                                OPEN_EXISTING,
+                                FILE_ATTRIBUTE_NORMAL,
+                                NULL);
+    if (handle == INVALID_HANDLE_VALUE) {
+        errno = ENOENT;
+        return -1;
+    }
+
+    BY_HANDLE_FILE_INFORMATION info;
+    BOOL found = GetFileInformationByHandle(handle, &info);
+    (void)CloseHandle(handle);
+    if (!found || (info.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    *file = (FileIdentity){
+        .device = info.dwVolumeSerialNumber,
+        .inode = ((uint64_t)info.nFileIndexHigh << 32u) | info.nFileIndexLow,
+        .mtime = ((uint64_t)info.ftLastWriteTime.dwHighDateTime << 32u) |
+                 info.ftLastWriteTime.dwLowDateTime,
+        .size = ((uint64_t)info.nFileSizeHigh << 32u) | info.nFileSizeLow
+    };
+    return 0;
+}
+
+static int seek_file(FILE *file, uint64_t offset)
+{
+    return _fseeki64(file, (__int64)offset, SEEK_SET);
+}
+
+static int replace_file(const char *from, const char *to)
+{
+    return MoveFileExA(from, to, MOVEFILE_REPLACE_EXISTING) ? 0 : -1;
+}
+#else
+static int file_identity(const char *path, FileIdentity *file)
+{
+    struct stat info;
+    if (stat(path, &info) != 0) {
+        return -1;
+    }
+    if (!S_ISREG(info.st_mode)) {
+        errno = EINVAL;
+        return -1;
+    }
+
+#if defined(__APPLE__)
+    struct timespec mtime = info.st_mtimespec;
+#else
+    struct timespec mtime = info.st_mtim;
+#endif
+    *file = (FileIdentity){ .device = (uint64_t)info.st_dev,
+                            .inode = (uint64_t)info.st_ino,
+                            .mtime = (uint64_t)mtime.tv_sec * 1000000000u +
+                                     (uint64_t)mtime.tv_nsec,
+                            .size = (uint64_t)info.st_size };
+    return 0;
+}
+
+static int seek_file(FILE *file, uint64_t offset)
+{
+    return fseeko(file, (off_t)offset, SEEK_SET);
+}
+
+static int replace_file(const char *from, const char *to)
+{
+    return rename(from, to);
+}
+#endif
+
+static bool index_valid(const Input *index,
+                        const FileIdentity *file,
+                        size_t max_word,
+                        uint64_t *offset)
+{
+    if (index->len < INDEX_HEADER ||
+        memcmp(index->data, INDEX_MAGIC, sizeof(INDEX_MAGIC)) != 0) {
+        return false;
+    }
+
+    const unsigned char *fields = index->data + sizeof(INDEX_MAGIC);
+    uint64_t size = load_u64(fields + 32u);
+    *offset = load_u64(fields + 40u);
+    return load_u64(fields) == (uint64_t)max_word &&
+           load_u64(fields + 8u) == file->device &&
+           load_u64(fields + 16u) == file->inode && *offset <= size &&
+           (size < file->size ||
+            (size == file->size && load_u64(fields + 24u) == file->mtime));
+}
+
+static bool index_current(const Input *index, const FileIdentity *file)
+{
+    const unsigned char *fields = index->data + sizeof(INDEX_MAGIC);
+    return load_u64(fields + 24u) == file->mtime &&
+           load_u64(fields + 32u) == file->size;
+}
+
+static int read_tail(const char *path,
+                     uint64_t offset,
+                     uint64_t size,
+                     unsigned char **data,
+                     size_t *len)
+{
+    FILE *file = fopen(path, "rb");
+    if (file == NULL) {
+        return -1;
+    }
+
+    size_t want = (size_t)(size - offset);
+    *data = malloc(want == 0u ? 1u : want);
+    int status = *data == NULL ? -1 : seek_file(file, offset);
+    if (status == 0) {
+        *len = fread(*data, 1u, want, file);
+        status = ferror(file) ? -1 : 0;
+    }
+
+    int error = errno;
+    (void)fclose(file);
+    if (status != 0) {
+        free(*data);
+        *data = NULL;
+    }
+    errno = error;
+    return status;
+}
+
+static int write_index(const char *path,
+                       const FileIdentity *file,
+                       const Options *options,
+                       uint64_t offset,
+                       const unsigned char *counts,
+                       size_t len)
+{
+    size_t path_len = strlen(path);
+    char *temp = malloc(path_len + 5u);
+    if (temp == NULL) {
+        return out_of_memory();
+    }
+    memcpy(temp, path, path_len);
+    memcpy(temp + path_len, ".tmp", 5u);
+
+    unsigned char header[INDEX_HEADER];
+    memcpy(header, INDEX_MAGIC, sizeof(INDEX_MAGIC));
+    store_u64(header + 4u, (uint64_t)options->max_word);
+    store_u64(header + 12u, file->device);
+    store_u64(header + 20u, file->inode);
+    store_u64(header + 28u, file->mtime);
+    store_u64(header + 36u, file->size);
+    store_u64(header + 44u, offset);
+
+    FILE *out = fopen(temp, "wb");
+    bool written = out != NULL &&
+                   fwrite(header, 1u, sizeof(header), out) == sizeof(header) &&
+                   fwrite(counts, 1u, len, out) == len;
+    if (out != NULL && fclose(out) != 0) {
+        written = false;
+    }
+    if (written && replace_file(temp, path) == 0) {
+        free(temp);
+        return 0;
+    }
+
+    int error = errno;
+    if (out != NULL) {
+        (void)remove(temp);
+    }
+    free(temp);
+    errno = error;
+    return cannot_write(path);
+}
+
+static int encode_count(const unsigned char *data,
+                        size_t len,
+                        const Options *options,
+                        unsigned char **counts,
+                        size_t *counts_len)
+{
+    WfResult result = { 0 };
+    if (count_bytes(data, len, options, &result) != 0) {
+        return -1;
+    }
+    int status = wf_result_encode(&result, counts, counts_len);
+    wf_result_free(&result);
+    return status;
+}
+
+static int count_indexed(const Options *options,
+                         const FileIdentity *file,
+                         Input *index,
+                         bool cached)
+{
+    uint64_t offset = 0;
+    if (cached && !index_valid(index, file, options->max_word, &offset)) {
+        free_input(index);
+        cached = false;
+        offset = 0u;
+    }
+
+    unsigned char *tail = NULL;
+    size_t len = 0;
+    if (read_tail(options->path, offset, file->size, &tail, &len) != 0) {
+        (void)cannot_read(options->path);
+        free_input(index);
+        return -1;
+    }
+    size_t keep = len;
+    while (keep > 0u && is_word_byte(tail[keep - 1u])) {
+        keep--;
+    }
+
+    unsigned char *fresh = NULL;
+    unsigned char *merged = NULL;
+    unsigned char *partial = NULL;
+    const unsigned char *counts = cached ? index->data + INDEX_HEADER : NULL;
+    size_t counts_len = cached ? index->len - INDEX_HEADER : 0u;
+    const unsigned char *parts[2] = { counts, NULL };
+    size_t lens[2] = { counts_len, 0u };
+    WfResult result = { 0 };
+    int status = 0;
+
+    if (!cached || keep > 0u) {
+        status = encode_count(tail, keep, options, &fresh, &lens[1]);
+        parts[1] = fresh;
+        if (status != 0) {
+            status = out_of_memory();
+        } else if (!cached) {
+            counts = fresh;
+            counts_len = lens[1];
+        } else if (wf_result_merge(parts, lens, 2u, &result) != 0) {
+            status = CORRUPT_INDEX;
+        } else if (wf_result_encode(&result, &merged, &counts_len) != 0) {
+            status = out_of_memory();
+        } else {
+            counts = merged;
+        }
+        wf_result_free(&result);
+    }
+
+    uint64_t next = offset + keep;
+    if (status == 0 && (!cached || keep > 0u || !index_current(index, file))) {
+        FileIdentity seen = *file;
+        seen.size = offset + len;
+        status = write_index(
+                options->index, &seen, options, next, counts, counts_len);
+    }
+
+    parts[0] = counts;
+    lens[0] = counts_len;
+    size_t count = 1;
+    if (status == 0 && keep < len) {
+        WfResult word = { 0 };
+        if (wf_count_bytes_with(tail + keep,
+                                len - keep,
+                                options->max_word,
+                                &options->counting,
+                                &word) != 0 ||
+            wf_result_encode(&word, &partial, &lens[1]) != 0) {
+            status = out_of_memory();
+        }
+        parts[count++] = partial;
+        wf_result_free(&word);
+    }
+    if (status == 0 &&
+        wf_result_merge_with(
+                parts, lens, count, &options->counting, &result) != 0) {
+        status = CORRUPT_INDEX;
+    }
+    if (status == 0) {
+        status = print_result(&result, options);
+        wf_result_free(&result);
+    }
+
+    free(tail);
+    free(fresh);
+    free(merged);
+    free(partial);
+    free_input(index);
+    return status;
+}
+
+static int run_index(const Options *options)
+{
+    FileIdentity file;
+    if (file_identity(options->path, &file) != 0) {
+        (void)cannot_read(options->path);
+        return 1;
+    }
+    if (is_compressed(options->path)) {
+        (void)fprintf(stderr,
+                      "wordcount_c: cannot index %s: compressed input\n",
+                      options->path);
+        return 1;
+    }
+
+    Input index;
+    bool cached = load_input(options->index, INPUT_MMAP, &index) == 0;
+    int status = count_indexed(options, &file, &index, cached);
+    if (status == CORRUPT_INDEX && cached) {
+        status = count_indexed(options, &file, &index, false);
+    }
+    if (status == CORRUPT_INDEX) {
+        (void)fprintf(stderr,
+                      "wordcount_c: cannot merge partial results\n");
+    }
+    return status == 0 ? 0 : 1;
+}
+
+static int run_stream(const Options *options)
+{
+    WfResult result = { 0 };
+    Phases phases = { .loaded = false };
+    double started = now_ms();
+    int status = stream_file(options->path, options, &result);
+
+    phases.count_ns = elapsed_ns(started);
+    if (status == READ_ERROR) {
+        (void)cannot_read(options->path);
+        return 1;
+    }
+    if (status != 0) {
+        (void)fprintf(stderr, "wordcount_c: out of memory\n");
+        return 1;
+    }
+
+    status = report_result(&result, options, &phases);
+    wf_result_free(&result);
+    return status;
+}
+
+static int run_files(const PathList *paths, const Options *options)
+{
+    WfResult result = { 0 };
+    Phases phases = { .loaded = false };
+    const char *failed = NULL;
+    double started = now_ms();
+    int status = options->bench_runs > 0u
+                         ? print_bench(NULL, paths, options, &failed)
+                         : count_files(paths, options, &result, &failed);
+
+    phases.count_ns = elapsed_ns(started);
+    if (status == READ_ERROR) {
+        (void)cannot_read(failed);
+        return 1;
+    }
+    if (status != 0) {
+        (void)out_of_memory();
+        return 1;
+    }
+
+    if (options->bench_runs == 0u) {
+        status = report_result(&result, options, &phases);
+        wf_result_free(&result);
+    }
+    return status;
+}
+
+static int run_file(const Options *options)
+{
+    Input input;
+    WfResult result = { 0 };
+    Phases phases = { .loaded = true };
+
+    if ((options->input == INPUT_STREAM || is_sequential(options->path)) &&
+        options->bench_runs == 0u) {
+        return run_stream(options);
+    }
+
+    double started = now_ms();
+    if (load_input(options->path, options->input, &input) != 0) {
+        (void)cannot_read(options->path);
+        return 1;
+    }
+    phases.read_ns = elapsed_ns(started);
+
+    if (options->bench_reuse) {
+        int status = print_reuse_bench(&input, options);
+        if (status == READ_ERROR) {
+            (void)cannot_read(options->path);
+            return 1;
+        }
+        if (status == OUT_OF_MEMORY) {
+            (void)out_of_memory();
+        }
+        return status == 0 ? 0 : 1;
+    }
+    if (options->bench_runs > 0u) {
+        int status = print_bench(&input, NULL, options, NULL);
+        free_input(&input);
+        if (status != 0) {
+            (void)out_of_memory();
+            return 1;
+        }
+        return 0;
+    }
+
+    started = now_ms();
+    if (count_bytes(input.data, input.len, options, &result) != 0) {
+        (void)out_of_memory();
+        free_input(&input);
+        return 1;
+    }
+    phases.count_ns = elapsed_ns(started);
+
+    int status = report_result(&result, options, &phases);
+    wf_result_free(&result);
+    free_input(&input);
+    return status;
+}
+
+static int print_approx(const WfApproxResult *result, const Options *options)
+{
+    size_t limit = result->len < options->top ? result->len : options->top;
+    Output out = { .len = 0 };
+    char error[32];
+
+    if (options->format == FORMAT_JSON) {
+        output_text(&out, "{\"total\":");
+        output_u64(&out, result->total);
+        output_text(&out, ",\"unique\":");
+        output_u64(&out, result->unique);
+        output_text(&out, ",\"top\":[");
+    } else if (options->format == FORMAT_TEXT) {
+        output_text(&out, "count word error\n");
+    } else if (options->format == FORMAT_TSV) {
+        output_text(&out, "word\tcount\terror\n");
+    }
+
+    for (size_t i = 0; i < limit; i++) {
+        output_row(&out,
+                   options->format,
+                   i,
+                   result->entries[i].word,
+                   result->entries[i].count,
+                   &result->entries[i].error);
+    }
+
+    (void)snprintf(error, sizeof(error), "%.6f", result->unique_error);
+    if (options->format == FORMAT_JSON) {
+        output_text(&out, "],\"approximate\":{\"counters\":");
+        output_u64(&out, (uint64_t)result->counters);
+        output_text(&out, ",\"max_error\":");
+        output_u64(&out, result->max_error);
+        output_text(&out, ",\"unique_error\":");
+        output_text(&out, error);
+        output_text(&out, "}}\n");
+    } else if (options->format == FORMAT_TEXT) {
+        output_text(&out, "total ");
+        output_u64(&out, result->total);
+        output_text(&out, "\nunique ");
+        output_u64(&out, result->unique);
+        output_text(&out, "\ncounters ");
+        output_u64(&out, (uint64_t)result->counters);
+        output_text(&out, "\nmax_error ");
+        output_u64(&out, result->max_error);
+        output_text(&out, "\nunique_error ");
+        output_text(&out, error);
+        output_text(&out, "\n");
+    }
+    return output_finish(&out);
+}
+
+static int approx_path(WfApprox *approx,
+                       const char *path,
+                       const Options *options,
+                       unsigned char *chunk)
+{
+    int status = feed_stream(
+            path, chunk, options->chunk_size, feed_approx, approx);
+    if (status == 0) {
+        status = wf_approx_end_word(approx);
+    }
+    return status;
+}
+
+static int run_approx(const PathList *paths, const Options *options)
+{
+    errno = 0;
+    WfApprox *approx = wf_approx_new(options->max_word, options->approx);
+    if (approx == NULL && errno == EINVAL) {
+        (void)fprintf(stderr, "wordcount_c: --approx budget is too small\n");
+        return 1;
+    }
+    unsigned char *chunk = malloc(options->chunk_size);
+    if (approx == NULL || chunk == NULL) {
+        wf_approx_free(approx);
+        free(chunk);
+        (void)out_of_memory();
+        return 1;
+    }
+    wf_approx_set_scanner(approx, options->scanner);
+
+    int status = 0;
+    for (size_t i = 0; i < paths->len && status == 0; i++) {
+        status = approx_path(approx, paths->items[i], options, chunk);
+        if (status == READ_ERROR) {
+            (void)cannot_read(paths->items[i]);
+        } else if (status != 0) {
+            (void)out_of_memory();
+        }
+    }
+
+    WfApproxResult result = { 0 };
+    if (status == 0 && wf_approx_finish(approx, options->top, &result) != 0) {
+        status = out_of_memory();
+    }
+    if (status == 0) {
+        status = print_approx(&result, options);
+        wf_approx_result_free(&result);
+    }
+
+    wf_approx_free(approx);
+    free(chunk);
+    return status == 0 ? 0 : 1;
+}
+
+static int window_report(WindowSink *sink)
+{
+    WfResult result = { 0 };
+    if (wf_window_advance(sink->window) != 0 ||
+        wf_window_top(sink->window, &result) != 0) {
+        return -1;
+    }
+
+    int status = print_ranked(
+            &result, wf_window_unique(sink->window), sink->options);
+    wf_result_free(&result);
+    sink->lines = 0u;
+    sink->pending = false;
+    sink->failed = status != 0;
+    return status;
+}
+
+static int feed_window(void *arg, const unsigned char *data, size_t len)
+{
+    WindowSink *sink = arg;
+
+    while (len > 0u) {
+        size_t take = len;
+        bool full = false;
+        const unsigned char *cursor = data;
+        const unsigned char *end = data + len;
+        while ((cursor = memchr(cursor, '\n', (size_t)(end - cursor))) !=
+               NULL) {
+            cursor++;
+            if (++sink->lines == sink->options->bucket_lines) {
+                take = (size_t)(cursor - data);
+                full = true;
+                break;
+            }
+        }
+
+        if (wf_window_feed(sink->window, data, take) != 0) {
+            return -1;
+        }
+        sink->pending = true;
+        if (full && window_report(sink) != 0) {
+            return -1;
+        }
+        data += take;
+        len -= take;
+    }
+    return 0;
+}
+
+static int run_window(const PathList *paths, const Options *options)
+{
+    WindowSink sink = { .window = wf_window_new(options->max_word,
+                                                options->window,
+                                                options->top),
+                        .options = options };
+    unsigned char *chunk = malloc(options->chunk_size);
+    if (sink.window == NULL || chunk == NULL) {
+        wf_window_free(sink.window);
+        free(chunk);
+        (void)out_of_memory();
+        return 1;
+    }
+    wf_window_set_scanner(sink.window, options->scanner);
+
+    int status = 0;
+    for (size_t i = 0; i < paths->len && status == 0; i++) {
+        status = feed_stream(paths->items[i],
+                             chunk,
+                             options->chunk_size,
+                             feed_window,
+                             &sink);
+        if (status == 0 && wf_window_end_word(sink.window) != 0) {
+            status = OUT_OF_MEMORY;
+        }
+        if (status == READ_ERROR) {
+            (void)cannot_read(paths->items[i]);
+        }
+    }
+    if (status == 0 && sink.pending && window_report(&sink) != 0) {
+        status = OUT_OF_MEMORY;
+    }
+    if (status == OUT_OF_MEMORY && !sink.failed) {
+        (void)out_of_memory();
+    }
+
+    wf_window_free(sink.window);
+    free(chunk);
+    return status == 0 ? 0 : 1;
+}
+
+static int run_merge(const PathList *paths, const Options *options)
+{
+    unsigned char **parts = calloc(paths->len + 1u, sizeof(*parts));
+    size_t *lens = calloc(paths->len + 1u, sizeof(*lens));
+    if (parts == NULL || lens == NULL) {
+        free(parts);
+        free(lens);
+        (void)out_of_memory();
+        return 1;
+    }
+
+    int status = 0;
+    size_t loaded = 0;
+    for (; loaded < paths->len; loaded++) {
+        if (read_file(paths->items[loaded], &parts[loaded], &lens[loaded]) !=
+            0) {
+            status = cannot_read(paths->items[loaded]);
+            break;
+        }
+    }
+
+    WfResult result = { 0 };
+    if (status == 0 &&
+        wf_result_merge_with((const unsigned char *const *)parts,
+                             lens,
+                             loaded,
+                             &options->counting,
+                             &result) != 0) {
+        (void)fprintf(stderr,
+                      "wordcount_c: cannot merge partial results\n");
+        status = -1;
+    }
+    if (status == 0) {
+        status = print_result(&result, options);
+        wf_result_free(&result);
+    }
+
+    for (size_t i = 0; i < loaded; i++) {
+        free(parts[i]);
+    }
+    free(parts);
+    free(lens);
+    return status == 0 ? 0 : 1;
+}
+
+int main(int argc, char **argv)
+{
+    Options options;
+    PathList paths;
+
+    if (parse_options(argc, argv, &options) != 0) {
+        free(options.args);
+        usage(argv[0]);
+        return 2;
+    }
+
+    options.counting = (WfOptions){ .scanner = options.scanner,
+                                    .top = options.select ? options.top : 0u,
+                                    .sort_threads = options.threads };
+    int status = expand_paths(&options, &paths);
+    free(options.args);
+    options.args = NULL;
+    options.arg_count = 0u;
+    if (status != 0) {
+        return 1;
+    }
+
+    if (options.approx > 0u) {
+        status = run_approx(&paths, &options);
+    } else if (options.window > 0u) {
+        status = run_window(&paths, &options);
+    } else if (options.merge) {
+        status = run_merge(&paths, &options);
+    } else if (options.index != NULL) {
+        if (paths.len != 1u || is_stdin(paths.items[0])) {
+            usage(argv[0]);
+            status = 2;
+        } else {
+            options.path = paths.items[0];
+            status = run_index(&options);
+        }
+    } else if (paths.len == 1u) {
+        options.path = paths.items[0];
+        status = run_file(&options);
+    } else if (options.bench_reuse) {
+        usage(argv[0]);
+        status = 2;
+    } else {
+        status = run_files(&paths, &options);
+    }
+
+    path_list_free(&paths);
+    return status;
+}
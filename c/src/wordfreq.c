@@ -1,16 +1,75 @@
 #include "wordfreq.h"
 
+#include <errno.h>
+#include <math.h>
+#include <stdalign.h>
+#include <stdatomic.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
+#include <threads.h>
+#include <time.h>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#include <emmintrin.h>
+#define SCAN_SSE2 1
+#if defined(__GNUC__)
+#include <immintrin.h>
+#define SCAN_AVX2 1
+#endif
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#include <arm_neon.h>
+#define SCAN_NEON 1
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
 
 enum {
+    APPROX_MAX_REGISTER_BITS = 16,
+    APPROX_MIN_REGISTER_BITS = 4,
+    APPROX_WORD_BYTES = 8,
+    APPROX_WORD_HEADER = 4,
+    ARENA_BLOCK = 4096,
+    ARENA_MAX_BLOCK = 1024 * 1024,
+    CTRL_EMPTY = 0x80,
     DEFAULT_MAX_WORD = 64,
     ESTIMATED_BYTES_PER_UNIQUE_WORD = 32,
+    GROUP_WIDTH = 16,
     INITIAL_CAPACITY = 16,
     MAX_WORD = 1024,
-    MIN_WORD = 4
+    MIN_WORD = 4,
+    MIGRATE_CHUNK = 4096,
+    MIN_THREAD_SLICE = 64 * 1024,
+    SAMPLE_CHUNK = 16 * 1024,
+    SAMPLE_CHUNKS = 16,
+    SAMPLE_REGISTER_BITS = 12,
+    SCAN_BATCH = 4096,
+    SCAN_BLOCK = 64,
+    SLOTS_PER_THREAD = 64,
+    SORT_MIN_RUN = 16 * 1024
+};
+
+static const uint32_t APPROX_DEAD = UINT32_C(0x80000000);
+
+#if defined(WFC_FAST_HASH)
+static const uint64_t HASH_SEED = UINT64_C(0xa0761d6478bd642f);
+static const uint64_t HASH_PRIME = UINT64_C(0xe7037ed1a0b428db);
+static const uint64_t FOLD_MASK = UINT64_C(0x2020202020202020);
+#endif
+
+enum {
+    PHASE_IDLE,
+    PHASE_DRAINING,
+    PHASE_MIGRATING
+};
+
+enum {
+    PROBE_DONE,
+    PROBE_FULL,
+    PROBE_FAILED
 };
 
 typedef struct {
@@ -22,11 +81,147 @@ typedef struct {
 
 typedef struct {
     Slot *slots;
+#if defined(WFC_SWISS_TABLE)
+    uint8_t *ctrl;
+#endif
+    WfArena *arena;
     size_t cap;
     size_t len;
     uint64_t total;
+    WfStats stats;
 } Table;
 
+struct WfArena {
+    WfArena *next;
+    size_t used;
+    size_t cap;
+    char bytes[];
+};
+
+typedef uint64_t (*ClassifyFn)(const unsigned char *block);
+
+struct WfCounter {
+    Table table;
+    WfOptions options;
+    ClassifyFn classify;
+    size_t max_word;
+    size_t pending_len;
+    bool in_word;
+    unsigned char pending[MAX_WORD];
+};
+
+typedef struct {
+    uint64_t count;
+    uint64_t error;
+    uint64_t hash;
+    size_t offset;
+    size_t room;
+    size_t len;
+    size_t heap;
+} ApproxSlot;
+
+struct WfApprox {
+    ApproxSlot *slots;
+    size_t *heap;
+    size_t *index;
+    char *words;
+    unsigned char *registers;
+    ClassifyFn classify;
+    size_t capacity;
+    size_t len;
+    size_t index_cap;
+    size_t words_cap;
+    size_t words_used;
+    size_t words_live;
+    size_t register_bits;
+    uint64_t total;
+    uint64_t dropped;
+    bool evicted;
+    size_t max_word;
+    size_t pending_len;
+    bool in_word;
+    unsigned char pending[MAX_WORD];
+};
+
+struct WfWindow {
+    WfCounter current;
+    WfResult *buckets;
+    size_t bucket_count;
+    size_t head;
+    Table table;
+    size_t live;
+    WfEntry *ranked;
+    size_t ranked_len;
+    size_t reserve;
+    size_t top;
+    bool complete;
+};
+
+typedef struct {
+    const unsigned char *data;
+    size_t len;
+    ClassifyFn classify;
+    size_t base;
+    uint64_t letters;
+} Scanner;
+
+typedef struct {
+    _Atomic uint64_t hash;
+    _Atomic(char *) word;
+    size_t len;
+    _Atomic uint64_t count;
+} SharedSlot;
+
+typedef struct {
+    atomic_bool active;
+    char padding[64 - sizeof(atomic_bool)];
+} SharedGate;
+
+typedef struct {
+    SharedSlot *slots;
+    size_t cap;
+    SharedSlot *next;
+    size_t next_cap;
+    SharedGate *gates;
+    size_t workers;
+    size_t resizes;
+    alignas(64) atomic_size_t len;
+    alignas(64) atomic_int phase;
+    atomic_bool failed;
+    alignas(64) atomic_size_t cursor;
+    atomic_size_t chunks;
+    atomic_size_t done;
+    atomic_size_t helpers;
+} SharedTable;
+
+typedef struct {
+    SharedTable *table;
+    SharedGate *gate;
+    WfArena *arena;
+    char *spare;
+    size_t spare_cap;
+    const unsigned char *data;
+    size_t len;
+    size_t max_word;
+    ClassifyFn classify;
+    uint64_t total;
+    WfStats stats;
+} SharedWorker;
+
+typedef struct {
+    uint64_t count;
+    uint64_t prefix;
+    char *word;
+} SortKey;
+
+typedef struct {
+    const SortKey *left;
+    const SortKey *right;
+    SortKey *out;
+    size_t left_len;
+    size_t right_len;
+} SortTask;
+
 static bool is_letter(unsigned char byte)
 {
     return (byte >= (unsigned char)'A' && byte <= (unsigned char)'Z') ||
@@ -66,252 +261,3052 @@ static uint64_t hash_word(const unsigned char *bytes, size_t len)
     return hash;
 }
 
-static size_t estimated_unique_words(size_t len)
+#if defined(WFC_FAST_HASH)
+static uint64_t fold_multiply(uint64_t a, uint64_t b)
 {
-    return len / ESTIMATED_BYTES_PER_UNIQUE_WORD;
+#if defined(__SIZEOF_INT128__)
+    __extension__ typedef unsigned __int128 Product;
+    Product product = (Product)a * b;
+    return (uint64_t)product ^ (uint64_t)(product >> 64u);
+#elif defined(_MSC_VER) && defined(_M_X64)
+    uint64_t high;
+    uint64_t low = _umul128(a, b, &high);
+    return low ^ high;
+#else
+    uint64_t a_low = a & 0xffffffffu;
+    uint64_t a_high = a >> 32u;
+    uint64_t b_low = b & 0xffffffffu;
+    uint64_t b_high = b >> 32u;
+    uint64_t low = a_low * b_low;
+    uint64_t middle = a_high * b_low;
+    uint64_t cross = a_low * b_high;
+    uint64_t high = a_high * b_high;
+    uint64_t carry = ((low >> 32u) + (middle & 0xffffffffu) +
+                      (cross & 0xffffffffu)) >>
+                     32u;
+    high += (middle >> 32u) + (cross >> 32u) + carry;
+    low += (middle << 32u) + (cross << 32u);
+    return low ^ high;
+#endif
 }
 
-static size_t table_capacity_for(size_t expected)
+static uint64_t read_block(const unsigned char *bytes)
 {
-    size_t needed = INITIAL_CAPACITY;
+    uint64_t block;
+    memcpy(&block, bytes, sizeof(block));
+    return block;
+}
 
-    if (expected > 0u) {
-        if (expected > (SIZE_MAX - 6u) / 10u) {
-            return 0u;
-        }
-        needed = (expected * 10u + 6u) / 7u;
-        if (needed < INITIAL_CAPACITY) {
-            needed = INITIAL_CAPACITY;
-        }
+static uint64_t read_tail(const unsigned char *bytes, size_t len)
+{
+    if (len >= 4u) {
+        uint32_t head;
+        uint32_t tail;
+        memcpy(&head, bytes, sizeof(head));
+        memcpy(&tail, bytes + len - 4u, sizeof(tail));
+        return ((uint64_t)head << 32u) | tail;
     }
+    return ((uint64_t)bytes[0] << 16u) | ((uint64_t)bytes[len >> 1u] << 8u) |
+           bytes[len - 1u];
+}
 
-    size_t cap = INITIAL_CAPACITY;
-    while (cap < needed) {
-        if (cap > SIZE_MAX / 2u) {
-            return 0u;
-        }
-        cap *= 2u;
+static uint64_t fold_tail(const unsigned char *bytes, size_t len)
+{
+    return read_tail(bytes, len) |
+           (len >= 4u ? FOLD_MASK : UINT64_C(0x202020));
+}
+
+static uint64_t table_hash(const unsigned char *bytes, size_t len)
+{
+    uint64_t hash = HASH_SEED ^ (uint64_t)len;
+    size_t i = 0;
+
+    for (; i + 8u < len; i += 8u) {
+        hash = fold_multiply(hash ^ (read_block(bytes + i) | FOLD_MASK),
+                             HASH_PRIME);
+    }
+    if (i < len) {
+        hash = fold_multiply(hash ^ fold_tail(bytes + i, len - i),
+                             HASH_PRIME);
     }
 
-    return cap;
+    return fold_multiply(hash, HASH_SEED ^ HASH_PRIME);
 }
+#else
+static uint64_t table_hash(const unsigned char *bytes, size_t len)
+{
+    return hash_word(bytes, len);
+}
+#endif
 
-static bool same_word(const Slot *slot, const unsigned char *bytes, size_t len)
+static size_t estimated_unique_words(size_t len)
 {
-    if (slot->len != len) {
-        return false;
-    }
+    return len / ESTIMATED_BYTES_PER_UNIQUE_WORD;
+}
 
-    for (size_t i = 0; i < len; i++) {
-        if ((unsigned char)slot->word[i] != lower_ascii(bytes[i])) {
-            return false;
-        }
-    }
+static unsigned trailing_zeros(uint64_t bits)
+{
+#if defined(_MSC_VER)
+    unsigned long index;
+    (void)_BitScanForward64(&index, bits);
+    return (unsigned)index;
+#else
+    return (unsigned)__builtin_ctzll(bits);
+#endif
+}
 
-    return true;
+static unsigned leading_zeros(uint64_t bits)
+{
+#if defined(_MSC_VER)
+    unsigned long index;
+    (void)_BitScanReverse64(&index, bits);
+    return 63u - (unsigned)index;
+#else
+    return (unsigned)__builtin_clzll(bits);
+#endif
 }
 
-static int table_resize(Table *table, size_t next_cap)
+static uint64_t mix_hash(uint64_t hash)
 {
-    Slot *next = calloc(next_cap, sizeof(*next));
+    hash ^= hash >> 33u;
+    hash *= 0xff51afd7ed558ccdull;
+    hash ^= hash >> 33u;
+    hash *= 0xc4ceb9fe1a85ec53ull;
+    hash ^= hash >> 33u;
+    return hash;
+}
 
-    if (next == NULL) {
-        return -1;
-    }
+static void sketch_observe(unsigned char *registers, size_t bits, uint64_t hash)
+{
+    size_t index = (size_t)(hash >> (64u - bits));
+    uint64_t rest = (hash << bits) | ((uint64_t)1u << (bits - 1u));
+    unsigned char rank = (unsigned char)(leading_zeros(rest) + 1u);
 
-    for (size_t i = 0; i < table->cap; i++) {
-        Slot slot = table->slots[i];
+    if (rank > registers[index]) {
+        registers[index] = rank;
+    }
+}
 
-        if (slot.word == NULL) {
-            continue;
-        }
+static double sketch_estimate(const unsigned char *registers, size_t bits)
+{
+    size_t count = (size_t)1u << bits;
+    double sum = 0.0;
+    size_t zeros = 0;
 
-        size_t index = (size_t)slot.hash & (next_cap - 1u);
-        while (next[index].word != NULL) {
-            index = (index + 1u) & (next_cap - 1u);
-        }
-        next[index] = slot;
+    for (size_t i = 0; i < count; i++) {
+        sum += ldexp(1.0, -(int)registers[i]);
+        zeros += registers[i] == 0u ? 1u : 0u;
     }
 
-    free(table->slots);
-    table->slots = next;
-    table->cap = next_cap;
-    return 0;
+    double m = (double)count;
+    double alpha = count == 16u   ? 0.673
+                   : count == 32u ? 0.697
+                   : count == 64u ? 0.709
+                                  : 0.7213 / (1.0 + 1.079 / m);
+    double estimate = alpha * m * m / sum;
+    if (estimate <= 2.5 * m && zeros > 0u) {
+        estimate = m * log(m / (double)zeros);
+    }
+    return estimate;
 }
 
-static int table_grow(Table *table)
+static uint64_t sample_words(const unsigned char *data,
+                             size_t start,
+                             size_t end,
+                             size_t max_word,
+                             unsigned char *registers)
 {
-    if (table->cap == 0u) {
-        return table_resize(table, INITIAL_CAPACITY);
+    uint64_t words = 0;
+    size_t i = start;
+
+    while (i > 0u && i < end && is_letter(data[i - 1u])) {
+        i++;
     }
-    if (table->cap > SIZE_MAX / 2u) {
-        return -1;
+    for (;;) {
+        while (i < end && !is_letter(data[i])) {
+            i++;
+        }
+        size_t word = i;
+        while (i < end && is_letter(data[i])) {
+            i++;
+        }
+        if (i == end) {
+            return words;
+        }
+
+        size_t len = i - word < max_word ? i - word : max_word;
+        sketch_observe(registers,
+                       SAMPLE_REGISTER_BITS,
+                       mix_hash(hash_word(data + word, len)));
+        words++;
     }
-    return table_resize(table, table->cap * 2u);
 }
 
-static int table_insert(Table *table, const unsigned char *bytes, size_t len)
+size_t
+wf_estimate_unique(const unsigned char *data, size_t len, size_t max_word)
 {
-    uint64_t hash = hash_word(bytes, len);
+    size_t sampled = (size_t)SAMPLE_CHUNKS * SAMPLE_CHUNK;
 
-    if (table->cap == 0 || (table->len + 1u) * 10u >= table->cap * 7u) {
-        if (table_grow(table) != 0) {
-            return -1;
-        }
+    if (len <= sampled * 2u) {
+        return estimated_unique_words(len);
     }
 
-    size_t index = (size_t)hash & (table->cap - 1u);
-    while (table->slots[index].word != NULL) {
-        Slot *slot = &table->slots[index];
+    unsigned char registers[2][(size_t)1u << SAMPLE_REGISTER_BITS] = { 0 };
+    uint64_t words[2] = { 0 };
+    size_t stride = (len - SAMPLE_CHUNK) / (SAMPLE_CHUNKS - 1u);
 
-        if (slot->hash == hash && same_word(slot, bytes, len)) {
-            slot->count++;
-            table->total++;
-            return 0;
-        }
+    max_word = normalize_max_word(max_word);
+    for (size_t i = 0; i < SAMPLE_CHUNKS; i++) {
+        size_t start = stride * i;
+        words[i % 2u] += sample_words(
+                data, start, start + SAMPLE_CHUNK, max_word, registers[i % 2u]);
+    }
+    if (words[0] == 0u || words[1] == 0u) {
+        return 0u;
+    }
 
-        index = (index + 1u) & (table->cap - 1u);
+    double half = sketch_estimate(registers[0], SAMPLE_REGISTER_BITS);
+    for (size_t i = 0; i < sizeof(registers[1]); i++) {
+        if (registers[1][i] < registers[0][i]) {
+            registers[1][i] = registers[0][i];
+        }
+    }
+    double whole = sketch_estimate(registers[1], SAMPLE_REGISTER_BITS);
+    double tokens = (double)(words[0] + words[1]);
+    double growth = log(whole / half) / log(tokens / (double)words[0]);
+    if (!(growth > 0.0)) {
+        growth = 0.0;
+    } else if (growth > 1.0) {
+        growth = 1.0;
     }
 
-    char *word = malloc(len + 1u);
-    if (word == NULL) {
-        return -1;
+    double scale = (double)len / (double)sampled;
+    double estimate = whole * pow(scale, growth);
+    if (estimate > tokens * scale) {
+        estimate = tokens * scale;
     }
+    return (size_t)(estimate * 1.25);
+}
+
+static uint64_t classify_tail(const unsigned char *block, size_t len)
+{
+    uint64_t letters = 0;
 
     for (size_t i = 0; i < len; i++) {
-        word[i] = (char)lower_ascii(bytes[i]);
+        if (is_letter(block[i])) {
+            letters |= 1ull << i;
+        }
     }
-    word[len] = '\0';
 
-    table->slots[index] =
-            (Slot){ .word = word, .len = len, .count = 1u, .hash = hash };
-    table->len++;
-    table->total++;
-    return 0;
+    return letters;
 }
 
-static void table_free(Table *table)
+#if defined(SCAN_SSE2)
+static uint64_t classify_sse2(const unsigned char *block)
 {
-    for (size_t i = 0; i < table->cap; i++) {
-        free(table->slots[i].word);
+    const __m128i fold = _mm_set1_epi8(0x20);
+    const __m128i shift = _mm_set1_epi8((char)(0x80 - 'a'));
+    const __m128i limit = _mm_set1_epi8((char)(-128 + 26));
+    uint64_t letters = 0;
+
+    for (unsigned i = 0; i < SCAN_BLOCK / 16; i++) {
+        __m128i bytes = _mm_loadu_si128((const void *)(block + 16u * i));
+        __m128i folded = _mm_add_epi8(_mm_or_si128(bytes, fold), shift);
+        uint64_t mask =
+                (unsigned)_mm_movemask_epi8(_mm_cmplt_epi8(folded, limit));
+        letters |= mask << (16u * i);
     }
-    free(table->slots);
-    *table = (Table){ 0 };
+
+    return letters;
 }
+#endif
 
-static int finish(Table *table, WfResult *result)
+#if defined(SCAN_AVX2)
+__attribute__((target("avx2"))) static uint64_t
+classify_avx2(const unsigned char *block)
 {
-    size_t unique = table->len;
-    uint64_t total = table->total;
-    WfEntry *entries = NULL;
+    const __m256i fold = _mm256_set1_epi8(0x20);
+    const __m256i shift = _mm256_set1_epi8((char)(0x80 - 'a'));
+    const __m256i limit = _mm256_set1_epi8((char)(-128 + 26));
+    uint64_t letters = 0;
 
-    if (unique == 0) {
-        result->unique = 0;
-        result->total = total;
-        free(table->slots);
-        *table = (Table){ 0 };
-        return 0;
+    for (unsigned i = 0; i < SCAN_BLOCK / 32; i++) {
+        __m256i bytes = _mm256_loadu_si256((const void *)(block + 32u * i));
+        __m256i folded =
+                _mm256_add_epi8(_mm256_or_si256(bytes, fold), shift);
+        uint64_t mask = (uint32_t)_mm256_movemask_epi8(
+                _mm256_cmpgt_epi8(limit, folded));
+        letters |= mask << (32u * i);
     }
 
-    entries = calloc(unique, sizeof(*entries));
-    if (entries == NULL) {
-        return -1;
-    }
+    return letters;
+}
+#endif
 
-    size_t out = 0;
-    for (size_t i = 0; i < table->cap && out < unique; i++) {
-        Slot *slot = &table->slots[i];
+#if defined(SCAN_NEON)
+static uint64_t classify_neon(const unsigned char *block)
+{
+    static const uint8_t weights[16] = { 1, 2, 4, 8, 16, 32, 64, 128,
+                                         1, 2, 4, 8, 16, 32, 64, 128 };
+    const uint8x16_t bit = vld1q_u8(weights);
+    uint64_t letters = 0;
 
-        if (slot->word == NULL) {
-            continue;
-        }
+    for (unsigned i = 0; i < SCAN_BLOCK / 16; i++) {
+        uint8x16_t bytes = vld1q_u8(block + 16u * i);
+        uint8x16_t folded =
+                vsubq_u8(vorrq_u8(bytes, vdupq_n_u8(0x20)), vdupq_n_u8('a'));
+        uint8x16_t bits =
+                vandq_u8(vcltq_u8(folded, vdupq_n_u8(26)), bit);
+        uint64_t mask = (uint64_t)vaddv_u8(vget_low_u8(bits)) |
+                        (uint64_t)vaddv_u8(vget_high_u8(bits)) << 8;
+        letters |= mask << (16u * i);
+    }
 
-        entries[out++] = (WfEntry){ .word = slot->word, .count = slot->count };
+    return letters;
+}
+#endif
+
+static ClassifyFn simd_classifier(void)
+{
+#if defined(SCAN_AVX2)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return classify_avx2;
     }
+#endif
+#if defined(SCAN_SSE2)
+    return classify_sse2;
+#elif defined(SCAN_NEON)
+    return classify_neon;
+#else
+    return NULL;
+#endif
+}
 
-    free(table->slots);
-    *table = (Table){ 0 };
-    result->entries = entries;
-    result->unique = unique;
-    result->total = total;
-    wf_result_sort(result);
-    return 0;
+static ClassifyFn classifier_for(WfScanner scanner)
+{
+    return scanner == WF_SCANNER_SIMD ? simd_classifier() : NULL;
 }
 
-int wf_count_bytes(const unsigned char *data,
-                   size_t len,
-                   size_t max_word,
-                   WfResult *result)
+static void scanner_load(Scanner *scanner, size_t base)
 {
-    Table table = { 0 };
-    size_t cursor = 0;
-    size_t expected = estimated_unique_words(len);
+    size_t left = scanner->len - base;
 
-    *result = (WfResult){ 0 };
-    max_word = normalize_max_word(max_word);
-    if (expected > 0u) {
-        size_t capacity = table_capacity_for(expected);
-        if (capacity == 0u || table_resize(&table, capacity) != 0) {
-            return -1;
-        }
+    scanner->base = base;
+    scanner->letters = left >= SCAN_BLOCK
+                               ? scanner->classify(scanner->data + base)
+                               : classify_tail(scanner->data + base, left);
+}
+
+static void scanner_init(Scanner *scanner,
+                         const unsigned char *data,
+                         size_t len,
+                         ClassifyFn classify)
+{
+    *scanner = (Scanner){ .data = data, .len = len, .classify = classify };
+    if (scanner->classify != NULL && len > 0u) {
+        scanner_load(scanner, 0);
     }
+}
 
-    while (cursor < len) {
-        while (cursor < len && !is_letter(data[cursor])) {
+static size_t scan_run(Scanner *scanner, size_t cursor, bool letters)
+{
+    if (scanner->classify == NULL) {
+        while (cursor < scanner->len &&
+               is_letter(scanner->data[cursor]) == letters) {
             cursor++;
         }
+        return cursor;
+    }
 
-        size_t start = cursor;
-        while (cursor < len && is_letter(data[cursor])) {
-            cursor++;
+    while (cursor < scanner->len) {
+        if (cursor - scanner->base >= SCAN_BLOCK) {
+            scanner_load(scanner, cursor);
         }
 
-        size_t word_len = cursor - start;
-        size_t stored_len = word_len < max_word ? word_len : max_word;
-
-        if (stored_len > 0 &&
-            table_insert(&table, data + start, stored_len) != 0) {
-            table_free(&table);
-            return -1;
+        uint64_t stops = letters ? ~scanner->letters : scanner->letters;
+        stops &= ~0ull << (cursor - scanner->base);
+        if (stops != 0u) {
+            size_t stop = scanner->base + trailing_zeros(stops);
+            return stop < scanner->len ? stop : scanner->len;
         }
+        cursor = scanner->base + SCAN_BLOCK;
     }
 
-    if (finish(&table, result) != 0) {
-        table_free(&table);
-        wf_result_free(result);
-        return -1;
-    }
-
-    return 0;
+    return scanner->len;
 }
 
-static int compare_entries(const void *left, const void *right)
+typedef struct {
+    const unsigned char *data;
+    size_t len;
+    size_t pos;
+    uint64_t total;
+    uint64_t remaining;
+    uint64_t sum;
+    const unsigned char *word;
+    size_t word_len;
+    uint64_t count;
+} DumpCursor;
+
+static size_t table_capacity_for(size_t expected)
 {
-    const WfEntry *a = left;
-    const WfEntry *b = right;
+    size_t needed = INITIAL_CAPACITY;
 
-    if (a->count < b->count) {
-        return 1;
+    if (expected > 0u) {
+        if (expected > (SIZE_MAX - 6u) / 10u) {
+            return 0u;
+        }
+        needed = (expected * 10u + 6u) / 7u;
+        if (needed < INITIAL_CAPACITY) {
+            needed = INITIAL_CAPACITY;
+        }
     }
-    if (a->count > b->count) {
-        return -1;
+
+    size_t cap = INITIAL_CAPACITY;
+    while (cap < needed) {
+        if (cap > SIZE_MAX / 2u) {
+            return 0u;
+        }
+        cap *= 2u;
     }
-    return strcmp(a->word, b->word);
-}
 
-void wf_result_sort(WfResult *result)
-{
-    qsort(result->entries,
-          result->unique,
-          sizeof(*result->entries),
-          compare_entries);
+    return cap;
 }
 
-void wf_result_free(WfResult *result)
+#if defined(WFC_FAST_HASH)
+static bool
+same_bytes(const char *word, const unsigned char *bytes, size_t len)
 {
-    for (size_t i = 0; i < result->unique; i++) {
-        free(result->entries[i].word);
+    const unsigned char *stored = (const unsigned char *)word;
+    size_t i = 0;
+
+    for (; i + 8u < len; i += 8u) {
+        if (read_block(stored + i) != (read_block(bytes + i) | FOLD_MASK)) {
+            return false;
+        }
+    }
+    return i == len ||
+           read_tail(stored + i, len - i) == fold_tail(bytes + i, len - i);
+}
+#else
+static bool
+same_bytes(const char *word, const unsigned char *bytes, size_t len)
+{
+    for (size_t i = 0; i < len; i++) {
+        if ((unsigned char)word[i] != lower_ascii(bytes[i])) {
+            return false;
+        }
+    }
+
+    return true;
+}
+#endif
+
+static bool same_word(const Slot *slot, const unsigned char *bytes, size_t len)
+{
+    return slot->len == len && same_bytes(slot->word, bytes, len);
+}
+
+#if defined(WFC_SWISS_TABLE)
+static uint8_t slot_tag(uint64_t hash)
+{
+    return (uint8_t)(hash >> 57);
+}
+
+#if defined(SCAN_NEON)
+static uint32_t group_bits(uint8x16_t hits)
+{
+    static const uint8_t weights[16] = { 1, 2, 4, 8, 16, 32, 64, 128,
+                                         1, 2, 4, 8, 16, 32, 64, 128 };
+    uint8x16_t bits = vandq_u8(hits, vld1q_u8(weights));
+
+    return (uint32_t)vaddv_u8(vget_low_u8(bits)) |
+           (uint32_t)vaddv_u8(vget_high_u8(bits)) << 8;
+}
+#endif
+
+static uint32_t group_match(const uint8_t *ctrl, uint8_t tag)
+{
+#if defined(SCAN_SSE2)
+    __m128i group = _mm_loadu_si128((const void *)ctrl);
+    return (uint32_t)_mm_movemask_epi8(
+            _mm_cmpeq_epi8(group, _mm_set1_epi8((char)tag)));
+#elif defined(SCAN_NEON)
+    return group_bits(vceqq_u8(vld1q_u8(ctrl), vdupq_n_u8(tag)));
+#else
+    uint32_t hits = 0;
+    for (unsigned i = 0; i < GROUP_WIDTH; i++) {
+        hits |= (uint32_t)(ctrl[i] == tag) << i;
+    }
+    return hits;
+#endif
+}
+
+static uint32_t group_empty(const uint8_t *ctrl)
+{
+#if defined(SCAN_SSE2)
+    return (uint32_t)_mm_movemask_epi8(_mm_loadu_si128((const void *)ctrl));
+#elif defined(SCAN_NEON)
+    return group_bits(vtstq_u8(vld1q_u8(ctrl), vdupq_n_u8(CTRL_EMPTY)));
+#else
+    uint32_t empty = 0;
+    for (unsigned i = 0; i < GROUP_WIDTH; i++) {
+        empty |= (uint32_t)(ctrl[i] == CTRL_EMPTY) << i;
+    }
+    return empty;
+#endif
+}
+
+static size_t table_vacancy(const Table *table, uint64_t hash)
+{
+    size_t mask = table->cap / GROUP_WIDTH - 1u;
+    size_t group = (size_t)hash & mask;
+
+    for (size_t stride = 1;; stride++) {
+        uint32_t empty = group_empty(table->ctrl + group * GROUP_WIDTH);
+
+        if (empty != 0u) {
+            return group * GROUP_WIDTH + trailing_zeros(empty);
+        }
+        group = (group + stride) & mask;
+    }
+}
+
+static size_t table_slot(const Table *table,
+                         uint64_t hash,
+                         const unsigned char *bytes,
+                         size_t len)
+{
+    size_t mask = table->cap / GROUP_WIDTH - 1u;
+    size_t group = (size_t)hash & mask;
+    uint8_t tag = slot_tag(hash);
+
+    for (size_t stride = 1;; stride++) {
+        const uint8_t *ctrl = table->ctrl + group * GROUP_WIDTH;
+        uint32_t hits = group_match(ctrl, tag);
+
+        while (hits != 0u) {
+            size_t index = group * GROUP_WIDTH + trailing_zeros(hits);
+            const Slot *slot = &table->slots[index];
+
+            if (slot->hash == hash && same_word(slot, bytes, len)) {
+                return index;
+            }
+            hits &= hits - 1u;
+        }
+
+        uint32_t empty = group_empty(ctrl);
+        if (empty != 0u) {
+            return group * GROUP_WIDTH + trailing_zeros(empty);
+        }
+        group = (group + stride) & mask;
+    }
+}
+
+#if defined(WFC_STATS)
+static size_t table_distance(const Table *table, uint64_t hash, size_t index)
+{
+    size_t mask = table->cap / GROUP_WIDTH - 1u;
+    size_t group = (size_t)hash & mask;
+    size_t probes = 1;
+
+    for (size_t stride = 1; group != index / GROUP_WIDTH; stride++) {
+        group = (group + stride) & mask;
+        probes++;
+    }
+    return probes;
+}
+#endif
+
+static void table_fill(Table *table, size_t index, Slot slot)
+{
+    table->ctrl[index] = slot_tag(slot.hash);
+    table->slots[index] = slot;
+}
+
+static int table_storage(Table *table)
+{
+    table->slots = calloc(table->cap, sizeof(*table->slots));
+    table->ctrl = malloc(table->cap);
+    if (table->slots == NULL || table->ctrl == NULL) {
+        free(table->slots);
+        free(table->ctrl);
+        return -1;
+    }
+
+    memset(table->ctrl, CTRL_EMPTY, table->cap);
+    return 0;
+}
+
+static void table_release(Table *table)
+{
+    free(table->slots);
+    free(table->ctrl);
+}
+#else
+static size_t table_vacancy(const Table *table, uint64_t hash)
+{
+    size_t index = (size_t)hash & (table->cap - 1u);
+
+    while (table->slots[index].word != NULL) {
+        index = (index + 1u) & (table->cap - 1u);
+    }
+
+    return index;
+}
+
+static size_t table_slot(const Table *table,
+                         uint64_t hash,
+                         const unsigned char *bytes,
+                         size_t len)
+{
+    size_t index = (size_t)hash & (table->cap - 1u);
+
+    while (table->slots[index].word != NULL) {
+        const Slot *slot = &table->slots[index];
+
+        if (slot->hash == hash && same_word(slot, bytes, len)) {
+            break;
+        }
+        index = (index + 1u) & (table->cap - 1u);
+    }
+
+    return index;
+}
+
+#if defined(WFC_STATS)
+static size_t table_distance(const Table *table, uint64_t hash, size_t index)
+{
+    return ((index - (size_t)hash) & (table->cap - 1u)) + 1u;
+}
+#endif
+
+static void table_fill(Table *table, size_t index, Slot slot)
+{
+    table->slots[index] = slot;
+}
+
+static int table_storage(Table *table)
+{
+    table->slots = calloc(table->cap, sizeof(*table->slots));
+    return table->slots == NULL ? -1 : 0;
+}
+
+static void table_release(Table *table)
+{
+    free(table->slots);
+}
+#endif
+
+static int table_resize(Table *table, size_t next_cap)
+{
+    Table next = { .cap = next_cap };
+
+    if (table_storage(&next) != 0) {
+        return -1;
+    }
+
+    for (size_t i = 0; i < table->cap; i++) {
+        Slot slot = table->slots[i];
+
+        if (slot.word == NULL) {
+            continue;
+        }
+
+        table_fill(&next, table_vacancy(&next, slot.hash), slot);
+    }
+
+    table_release(table);
+    next.arena = table->arena;
+    next.len = table->len;
+    next.total = table->total;
+    next.stats = table->stats;
+    *table = next;
+    return 0;
+}
+
+static int table_grow(Table *table)
+{
+    if (table->cap == 0u) {
+        return table_resize(table, INITIAL_CAPACITY);
+    }
+    if (table->cap > SIZE_MAX / 2u) {
+        return -1;
+    }
+    if (table_resize(table, table->cap * 2u) != 0) {
+        return -1;
+    }
+    table->stats.resizes++;
+    return 0;
+}
+
+static char *arena_alloc(WfArena **arena, size_t size)
+{
+    WfArena *block = *arena;
+
+    if (block == NULL || block->cap - block->used < size) {
+        size_t cap = block == NULL ? ARENA_BLOCK : block->cap * 2u;
+        if (cap > ARENA_MAX_BLOCK) {
+            cap = ARENA_MAX_BLOCK;
+        }
+        if (cap < size) {
+            cap = size;
+        }
+
+        WfArena *next = malloc(sizeof(*next) + cap);
+        if (next == NULL) {
+            return NULL;
+        }
+        next->next = block;
+        next->used = 0;
+        next->cap = cap;
+        *arena = next;
+        block = next;
+    }
+
+    char *bytes = block->bytes + block->used;
+    block->used += size;
+    return bytes;
+}
+
+static void arena_splice(WfArena **arena, WfArena *blocks)
+{
+    if (blocks == NULL) {
+        return;
+    }
+
+    WfArena *tail = blocks;
+    while (tail->next != NULL) {
+        tail = tail->next;
+    }
+    tail->next = *arena;
+    *arena = blocks;
+}
+
+static void arena_free(WfArena *arena)
+{
+    while (arena != NULL) {
+        WfArena *next = arena->next;
+        free(arena);
+        arena = next;
+    }
+}
+
+static int arena_rewind(WfArena **arena)
+{
+    WfArena *block = *arena;
+
+    if (block == NULL || block->next == NULL) {
+        if (block != NULL) {
+            block->used = 0;
+        }
+        return 0;
+    }
+
+    size_t used = 0;
+    for (; block != NULL; block = block->next) {
+        used += block->used;
+    }
+
+    WfArena *next = malloc(sizeof(*next) + used);
+    if (next == NULL) {
+        return -1;
+    }
+    arena_free(*arena);
+    next->next = NULL;
+    next->used = 0;
+    next->cap = used;
+    *arena = next;
+    return 0;
+}
+
+static size_t arena_bytes(const WfArena *arena)
+{
+    size_t bytes = 0;
+
+    for (; arena != NULL; arena = arena->next) {
+        bytes += sizeof(*arena) + arena->cap;
+    }
+    return bytes;
+}
+
+#if defined(WFC_STATS)
+static void stats_probe(WfStats *stats, uint64_t probes, bool hit)
+{
+    stats->probes += probes;
+    if (probes > stats->max_probe) {
+        stats->max_probe = probes;
+    }
+    if (hit) {
+        stats->hits++;
+    } else {
+        stats->inserts++;
+    }
+}
+#endif
+
+static void stats_merge(WfStats *into, const WfStats *from)
+{
+    into->inserts += from->inserts;
+    into->hits += from->hits;
+    into->probes += from->probes;
+    if (from->max_probe > into->max_probe) {
+        into->max_probe = from->max_probe;
+    }
+    into->resizes += from->resizes;
+}
+
+static WfStats table_stats(const Table *table)
+{
+    WfStats stats = table->stats;
+
+    stats.capacity = table->cap;
+    stats.bytes = table->cap * sizeof(*table->slots) +
+                  arena_bytes(table->arena);
+#if defined(WFC_SWISS_TABLE)
+    stats.bytes += table->cap;
+#endif
+    return stats;
+}
+
+static void fill_word(char *word, const unsigned char *bytes, size_t len)
+{
+    for (size_t i = 0; i < len; i++) {
+        word[i] = (char)lower_ascii(bytes[i]);
+    }
+    word[len] = '\0';
+}
+
+static char *
+copy_word(WfArena **arena, const unsigned char *bytes, size_t len)
+{
+    char *word = arena_alloc(arena, len + 1u);
+    if (word == NULL) {
+        return NULL;
+    }
+
+    fill_word(word, bytes, len);
+    return word;
+}
+
+static int table_insert(Table *table, const unsigned char *bytes, size_t len)
+{
+    uint64_t hash = table_hash(bytes, len);
+
+    if (table->cap == 0 || (table->len + 1u) * 10u >= table->cap * 7u) {
+        if (table_grow(table) != 0) {
+            return -1;
+        }
+    }
+
+    size_t index = table_slot(table, hash, bytes, len);
+#if defined(WFC_STATS)
+    stats_probe(&table->stats,
+                table_distance(table, hash, index),
+                table->slots[index].word != NULL);
+#endif
+    if (table->slots[index].word != NULL) {
+        table->slots[index].count++;
+        table->total++;
+        return 0;
+    }
+
+    char *word = copy_word(&table->arena, bytes, len);
+    if (word == NULL) {
+        return -1;
+    }
+
+    table_fill(table,
+               index,
+               (Slot){ .word = word, .len = len, .count = 1u, .hash = hash });
+    table->len++;
+    table->total++;
+    return 0;
+}
+
+static int table_absorb(Table *table, const Slot *from)
+{
+    if (table->cap == 0 || (table->len + 1u) * 10u >= table->cap * 7u) {
+        if (table_grow(table) != 0) {
+            return -1;
+        }
+    }
+
+    size_t index = table_slot(table,
+                              from->hash,
+                              (const unsigned char *)from->word,
+                              from->len);
+    if (table->slots[index].word != NULL) {
+        table->slots[index].count += from->count;
+        return 0;
+    }
+
+    table_fill(table, index, *from);
+    table->len++;
+    return 0;
+}
+
+static Slot *
+table_find(const Table *table, const unsigned char *bytes, size_t len)
+{
+    if (table->cap == 0u) {
+        return NULL;
+    }
+
+    size_t index = table_slot(table, table_hash(bytes, len), bytes, len);
+    Slot *slot = &table->slots[index];
+    return slot->word == NULL ? NULL : slot;
+}
+
+static void table_clear(Table *table)
+{
+    if (table->slots != NULL) {
+        memset(table->slots, 0, table->cap * sizeof(*table->slots));
+#if defined(WFC_SWISS_TABLE)
+        memset(table->ctrl, CTRL_EMPTY, table->cap);
+#endif
+    }
+    table->len = 0;
+    table->total = 0;
+}
+
+static void table_free(Table *table)
+{
+    arena_free(table->arena);
+    table_release(table);
+    *table = (Table){ 0 };
+}
+
+static uint64_t clock_ns(void)
+{
+    struct timespec now;
+
+#if defined(TIME_MONOTONIC)
+    (void)timespec_get(&now, TIME_MONOTONIC);
+#else
+    (void)timespec_get(&now, TIME_UTC);
+#endif
+    return (uint64_t)now.tv_sec * UINT64_C(1000000000) +
+           (uint64_t)now.tv_nsec;
+}
+
+static int collect(Table *table, WfResult *result)
+{
+    size_t unique = table->len;
+    uint64_t total = table->total;
+    WfEntry *entries = NULL;
+
+    if (unique == 0) {
+        result->unique = 0;
+        result->total = total;
+        result->stats = table_stats(table);
+        result->arena = table->arena;
+        table->arena = NULL;
+        return 0;
+    }
+
+    entries = calloc(unique, sizeof(*entries));
+    if (entries == NULL) {
+        return -1;
+    }
+
+    size_t out = 0;
+    for (size_t i = 0; i < table->cap && out < unique; i++) {
+        Slot *slot = &table->slots[i];
+
+        if (slot->word == NULL) {
+            continue;
+        }
+
+        entries[out++] = (WfEntry){ .word = slot->word, .count = slot->count };
+    }
+
+    result->entries = entries;
+    result->unique = unique;
+    result->total = total;
+    result->stats = table_stats(table);
+    result->arena = table->arena;
+    table->arena = NULL;
+    return 0;
+}
+
+static int finish(Table *table, const WfOptions *options, WfResult *result)
+{
+    if (collect(table, result) != 0) {
+        return -1;
+    }
+    wf_result_order(result, options);
+    return 0;
+}
+
+static int counter_init(WfCounter *counter, size_t max_word, size_t expected)
+{
+    counter->table = (Table){ 0 };
+    counter->options = (WfOptions){ 0 };
+    counter->classify = NULL;
+    counter->max_word = normalize_max_word(max_word);
+    counter->pending_len = 0;
+    counter->in_word = false;
+    if (expected > 0u) {
+        size_t capacity = table_capacity_for(expected);
+        if (capacity == 0u || table_resize(&counter->table, capacity) != 0) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+static int counter_flush(WfCounter *counter)
+{
+    if (!counter->in_word) {
+        return 0;
+    }
+    if (table_insert(&counter->table,
+                     counter->pending,
+                     counter->pending_len) != 0) {
+        return -1;
+    }
+    counter->pending_len = 0;
+    counter->in_word = false;
+    return 0;
+}
+
+static void counter_stash(WfCounter *counter,
+                          const unsigned char *bytes,
+                          size_t len)
+{
+    size_t room = counter->max_word - counter->pending_len;
+    size_t stored_len = len < room ? len : room;
+
+    memcpy(counter->pending + counter->pending_len, bytes, stored_len);
+    counter->pending_len += stored_len;
+    counter->in_word = true;
+}
+
+int wf_counter_feed(WfCounter *counter, const unsigned char *data, size_t len)
+{
+    Scanner scanner;
+    size_t cursor = 0;
+
+    scanner_init(&scanner, data, len, counter->classify);
+    if (counter->in_word) {
+        cursor = scan_run(&scanner, cursor, true);
+        if (cursor > 0) {
+            counter_stash(counter, data, cursor);
+        }
+        if (cursor == len) {
+            return 0;
+        }
+        if (counter_flush(counter) != 0) {
+            return -1;
+        }
+    }
+
+    while (cursor < len) {
+        cursor = scan_run(&scanner, cursor, false);
+
+        size_t start = cursor;
+        cursor = scan_run(&scanner, cursor, true);
+
+        size_t word_len = cursor - start;
+        if (word_len > 0 && cursor == len) {
+            counter_stash(counter, data + start, word_len);
+            return 0;
+        }
+
+        size_t stored_len =
+                word_len < counter->max_word ? word_len : counter->max_word;
+
+        if (stored_len > 0 &&
+            table_insert(&counter->table, data + start, stored_len) != 0) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+int wf_counter_end_word(WfCounter *counter)
+{
+    return counter_flush(counter);
+}
+
+int wf_counter_merge(WfCounter *counter, WfCounter *other)
+{
+    if (counter_flush(counter) != 0 || counter_flush(other) != 0) {
+        return -1;
+    }
+
+    Table *into = &counter->table;
+    Table *from = &other->table;
+    size_t cap = table_capacity_for(into->len + from->len);
+    if (cap == 0u || (cap > into->cap && table_resize(into, cap) != 0)) {
+        return -1;
+    }
+
+    arena_splice(&into->arena, from->arena);
+    from->arena = NULL;
+    into->total += from->total;
+    int status = 0;
+    for (size_t i = 0; i < from->cap && status == 0; i++) {
+        if (from->slots[i].word != NULL) {
+            status = table_absorb(into, &from->slots[i]);
+        }
+    }
+
+    stats_merge(&into->stats, &from->stats);
+#if defined(WFC_STATS)
+    /* A word both tables held is a single insert into the merged one. */
+    into->stats.hits += into->stats.inserts - into->len;
+    into->stats.inserts = into->len;
+#endif
+    table_free(from);
+    return status;
+}
+
+int wf_counter_snapshot(const WfCounter *counter, WfResult *result)
+{
+    const Table *table = &counter->table;
+    const Slot *pending = NULL;
+    size_t unique = table->len;
+
+    *result = (WfResult){ .total = table->total,
+                          .stats = table_stats(table) };
+    if (counter->in_word) {
+        pending = table_find(table, counter->pending, counter->pending_len);
+        result->total++;
+        if (pending == NULL) {
+            unique++;
+        }
+    }
+    if (unique == 0) {
+        return 0;
+    }
+
+    result->entries = calloc(unique, sizeof(*result->entries));
+    if (result->entries == NULL) {
+        *result = (WfResult){ 0 };
+        return -1;
+    }
+
+    for (size_t i = 0; i < table->cap && result->unique < table->len; i++) {
+        const Slot *slot = &table->slots[i];
+
+        if (slot->word == NULL) {
+            continue;
+        }
+
+        char *word = copy_word(&result->arena,
+                               (const unsigned char *)slot->word,
+                               slot->len);
+        if (word == NULL) {
+            wf_result_free(result);
+            return -1;
+        }
+        result->entries[result->unique++] = (WfEntry){
+            .word = word, .count = slot->count + (slot == pending ? 1u : 0u)
+        };
+    }
+
+    if (counter->in_word && pending == NULL) {
+        char *word = copy_word(
+                &result->arena, counter->pending, counter->pending_len);
+        if (word == NULL) {
+            wf_result_free(result);
+            return -1;
+        }
+        result->entries[result->unique++] =
+                (WfEntry){ .word = word, .count = 1u };
+    }
+
+    wf_result_order(result, &counter->options);
+    return 0;
+}
+
+int wf_counter_collect(WfCounter *counter, WfResult *result)
+{
+    *result = (WfResult){ 0 };
+    if (counter_flush(counter) != 0 || collect(&counter->table, result) != 0) {
+        return -1;
+    }
+    table_clear(&counter->table);
+    return 0;
+}
+
+int wf_counter_finish(WfCounter *counter, WfResult *result)
+{
+    if (wf_counter_collect(counter, result) != 0) {
+        return -1;
+    }
+    wf_result_order(result, &counter->options);
+    return 0;
+}
+
+int wf_counter_view(WfCounter *counter, WfResult *result)
+{
+    *result = (WfResult){ 0 };
+    if (counter_flush(counter) != 0 || collect(&counter->table, result) != 0) {
+        return -1;
+    }
+    counter->table.arena = result->arena;
+    result->arena = NULL;
+    wf_result_order(result, &counter->options);
+    return 0;
+}
+
+int wf_counter_reset(WfCounter *counter)
+{
+    if (arena_rewind(&counter->table.arena) != 0) {
+        return -1;
+    }
+    table_clear(&counter->table);
+    counter->table.stats = (WfStats){ 0 };
+    counter->pending_len = 0;
+    counter->in_word = false;
+    return 0;
+}
+
+WfCounter *wf_counter_new(size_t max_word, size_t size_hint)
+{
+    WfCounter *counter = malloc(sizeof(*counter));
+    size_t expected = estimated_unique_words(size_hint);
+
+    if (counter == NULL) {
+        return NULL;
+    }
+    if (counter_init(counter, max_word, expected) != 0) {
+        free(counter);
+        return NULL;
+    }
+
+    return counter;
+}
+
+int wf_counter_reserve(WfCounter *counter, size_t unique)
+{
+    size_t cap = table_capacity_for(unique);
+
+    if (cap == 0u) {
+        return -1;
+    }
+    return cap > counter->table.cap ? table_resize(&counter->table, cap) : 0;
+}
+
+void wf_counter_set_options(WfCounter *counter, const WfOptions *options)
+{
+    counter->options = options != NULL ? *options : (WfOptions){ 0 };
+    counter->classify = classifier_for(counter->options.scanner);
+}
+
+void wf_counter_free(WfCounter *counter)
+{
+    if (counter == NULL) {
+        return;
+    }
+    table_free(&counter->table);
+    free(counter);
+}
+
+int wf_count_bytes_with(const unsigned char *data,
+                        size_t len,
+                        size_t max_word,
+                        const WfOptions *options,
+                        WfResult *result)
+{
+    WfCounter counter;
+
+    *result = (WfResult){ 0 };
+    if (counter_init(&counter,
+                     max_word,
+                     wf_estimate_unique(data, len, max_word)) != 0) {
+        return -1;
+    }
+    wf_counter_set_options(&counter, options);
+
+    if (wf_counter_feed(&counter, data, len) != 0 ||
+        counter_flush(&counter) != 0 ||
+        finish(&counter.table, &counter.options, result) != 0) {
+        table_free(&counter.table);
+        return -1;
+    }
+
+    table_release(&counter.table);
+    return 0;
+}
+
+int wf_count_bytes(const unsigned char *data,
+                   size_t len,
+                   size_t max_word,
+                   WfResult *result)
+{
+    return wf_count_bytes_with(data, len, max_word, NULL, result);
+}
+
+static void
+shared_publish(SharedSlot *slot, char *word, size_t len, uint64_t count)
+{
+    slot->len = len;
+    atomic_store_explicit(&slot->count, count, memory_order_relaxed);
+    atomic_store_explicit(&slot->word, word, memory_order_release);
+}
+
+static int shared_probe(SharedTable *table,
+                        SharedWorker *worker,
+                        const unsigned char *bytes,
+                        size_t len)
+{
+    uint64_t hash = table_hash(bytes, len);
+    hash = hash == 0u ? 1u : hash;
+    size_t mask = table->cap - 1u;
+    size_t index = (size_t)hash & mask;
+
+    for (size_t probes = 0; probes < table->cap; probes++) {
+        SharedSlot *slot = &table->slots[index];
+        uint64_t seen = atomic_load_explicit(&slot->hash, memory_order_acquire);
+
+        if (seen == 0u) {
+            size_t used =
+                    atomic_load_explicit(&table->len, memory_order_relaxed);
+            if (used * 10u >= table->cap * 7u) {
+                return PROBE_FULL;
+            }
+            if (worker->spare_cap <= len) {
+                worker->spare = arena_alloc(&worker->arena, len + 1u);
+                if (worker->spare == NULL) {
+                    return PROBE_FAILED;
+                }
+                worker->spare_cap = len + 1u;
+            }
+            fill_word(worker->spare, bytes, len);
+            if (atomic_compare_exchange_strong(&slot->hash, &seen, hash)) {
+                shared_publish(slot, worker->spare, len, 1u);
+                worker->spare = NULL;
+                worker->spare_cap = 0;
+                atomic_fetch_add_explicit(
+                        &table->len, 1u, memory_order_relaxed);
+#if defined(WFC_STATS)
+                stats_probe(&worker->stats, probes + 1u, false);
+#endif
+                return PROBE_DONE;
+            }
+        }
+
+        if (seen == hash) {
+            char *word = NULL;
+            while ((word = atomic_load_explicit(
+                            &slot->word, memory_order_acquire)) == NULL) {
+                thrd_yield();
+            }
+            if (slot->len == len && same_bytes(word, bytes, len)) {
+                atomic_fetch_add_explicit(
+                        &slot->count, 1u, memory_order_relaxed);
+#if defined(WFC_STATS)
+                stats_probe(&worker->stats, probes + 1u, true);
+#endif
+                return PROBE_DONE;
+            }
+        }
+
+        index = (index + 1u) & mask;
+    }
+
+    return PROBE_FULL;
+}
+
+static void shared_move(SharedTable *table, const SharedSlot *from)
+{
+    uint64_t hash = atomic_load_explicit(&from->hash, memory_order_relaxed);
+    size_t mask = table->next_cap - 1u;
+    size_t index = (size_t)hash & mask;
+
+    for (;;) {
+        uint64_t empty = 0u;
+        if (atomic_compare_exchange_strong(
+                    &table->next[index].hash, &empty, hash)) {
+            shared_publish(
+                    &table->next[index],
+                    atomic_load_explicit(&from->word, memory_order_relaxed),
+                    from->len,
+                    atomic_load_explicit(&from->count, memory_order_relaxed));
+            return;
+        }
+        index = (index + 1u) & mask;
+    }
+}
+
+static void shared_migrate(SharedTable *table)
+{
+    for (;;) {
+        size_t chunk = atomic_fetch_add(&table->cursor, 1u);
+        if (chunk >= atomic_load(&table->chunks)) {
+            return;
+        }
+
+        size_t start = chunk * MIGRATE_CHUNK;
+        size_t end = table->cap - start < MIGRATE_CHUNK ? table->cap
+                                                        : start + MIGRATE_CHUNK;
+        for (size_t i = start; i < end; i++) {
+            if (atomic_load_explicit(&table->slots[i].hash,
+                                     memory_order_relaxed) != 0u) {
+                shared_move(table, &table->slots[i]);
+            }
+        }
+        atomic_fetch_add(&table->done, 1u);
+    }
+}
+
+static void shared_help(SharedTable *table)
+{
+    int phase = PHASE_IDLE;
+
+    while ((phase = atomic_load(&table->phase)) != PHASE_IDLE) {
+        if (phase == PHASE_MIGRATING) {
+            atomic_fetch_add(&table->helpers, 1u);
+            if (atomic_load(&table->phase) == PHASE_MIGRATING) {
+                shared_migrate(table);
+            }
+            atomic_fetch_sub(&table->helpers, 1u);
+        }
+        thrd_yield();
+    }
+}
+
+static void shared_resize(SharedTable *table, size_t seen_cap)
+{
+    int idle = PHASE_IDLE;
+
+    if (!atomic_compare_exchange_strong(
+                &table->phase, &idle, PHASE_DRAINING)) {
+        shared_help(table);
+        return;
+    }
+
+    for (size_t i = 0; i < table->workers; i++) {
+        while (atomic_load(&table->gates[i].active)) {
+            thrd_yield();
+        }
+    }
+
+    /* Another worker may have grown the table since this one found it full. */
+    if (table->cap != seen_cap ||
+        atomic_load(&table->len) * 10u < table->cap * 7u) {
+        atomic_store(&table->phase, PHASE_IDLE);
+        return;
+    }
+
+    size_t next_cap = table->cap <= SIZE_MAX / 2u ? table->cap * 2u : 0u;
+    SharedSlot *next =
+            next_cap == 0u ? NULL : calloc(next_cap, sizeof(*next));
+    if (next == NULL) {
+        atomic_store(&table->failed, true);
+        atomic_store(&table->phase, PHASE_IDLE);
+        return;
+    }
+
+    table->next = next;
+    table->next_cap = next_cap;
+    size_t chunks = (table->cap + MIGRATE_CHUNK - 1u) / MIGRATE_CHUNK;
+    atomic_store(&table->chunks, chunks);
+    atomic_store(&table->done, 0u);
+    atomic_store(&table->cursor, 0u);
+    atomic_store(&table->phase, PHASE_MIGRATING);
+
+    shared_migrate(table);
+    while (atomic_load(&table->done) < chunks) {
+        thrd_yield();
+    }
+    atomic_store(&table->phase, PHASE_DRAINING);
+    while (atomic_load(&table->helpers) > 0u) {
+        thrd_yield();
+    }
+
+    free(table->slots);
+    table->slots = next;
+    table->cap = next_cap;
+    table->next = NULL;
+    table->resizes++;
+    atomic_store(&table->phase, PHASE_IDLE);
+}
+
+static void shared_enter(SharedTable *table, SharedGate *gate)
+{
+    for (;;) {
+        atomic_store(&gate->active, true);
+        if (atomic_load(&table->phase) == PHASE_IDLE) {
+            return;
+        }
+        atomic_store(&gate->active, false);
+        shared_help(table);
+    }
+}
+
+static int shared_worker(void *arg)
+{
+    SharedWorker *worker = arg;
+    SharedTable *table = worker->table;
+    const unsigned char *data = worker->data;
+    size_t len = worker->len;
+    size_t cursor = 0;
+    Scanner scanner;
+
+    scanner_init(&scanner, data, len, worker->classify);
+
+    while (cursor < len && !atomic_load(&table->failed)) {
+        size_t batch_end =
+                len - cursor < SCAN_BATCH ? len : cursor + SCAN_BATCH;
+        int status = PROBE_DONE;
+
+        shared_enter(table, worker->gate);
+        size_t seen_cap = table->cap;
+        while (cursor < batch_end && status == PROBE_DONE) {
+            cursor = scan_run(&scanner, cursor, false);
+
+            size_t start = cursor;
+            cursor = scan_run(&scanner, cursor, true);
+
+            size_t word_len = cursor - start;
+            size_t stored_len =
+                    word_len < worker->max_word ? word_len : worker->max_word;
+            if (stored_len == 0u) {
+                continue;
+            }
+
+            status = shared_probe(table, worker, data + start, stored_len);
+            if (status == PROBE_DONE) {
+                worker->total++;
+            } else {
+                cursor = start;
+            }
+        }
+        atomic_store(&worker->gate->active, false);
+
+        if (status == PROBE_FULL) {
+            shared_resize(table, seen_cap);
+        } else if (status == PROBE_FAILED) {
+            atomic_store(&table->failed, true);
+        }
+    }
+
+    return 0;
+}
+
+static void shared_free(SharedTable *table)
+{
+    free(table->slots);
+    free(table->gates);
+}
+
+static int shared_finish(SharedTable *table,
+                         uint64_t total,
+                         const WfOptions *options,
+                         WfResult *result)
+{
+    size_t unique = atomic_load(&table->len);
+
+    result->total = total;
+    if (unique == 0u) {
+        return 0;
+    }
+
+    WfEntry *entries = calloc(unique, sizeof(*entries));
+    if (entries == NULL) {
+        return -1;
+    }
+
+    size_t out = 0;
+    for (size_t i = 0; i < table->cap && out < unique; i++) {
+        SharedSlot *slot = &table->slots[i];
+        char *word = atomic_load_explicit(&slot->word, memory_order_relaxed);
+
+        if (word == NULL) {
+            continue;
+        }
+
+        entries[out++] = (WfEntry){
+            .word = word,
+            .count = atomic_load_explicit(&slot->count, memory_order_relaxed)
+        };
+    }
+
+    result->entries = entries;
+    result->unique = unique;
+    wf_result_order(result, options);
+    return 0;
+}
+
+static size_t split_at_separator(const unsigned char *data,
+                                 size_t len,
+                                 size_t end)
+{
+    while (end < len && is_letter(data[end])) {
+        end++;
+    }
+    return end;
+}
+
+int wf_count_bytes_parallel_with(const unsigned char *data,
+                                 size_t len,
+                                 size_t max_word,
+                                 size_t threads,
+                                 const WfOptions *options,
+                                 WfResult *result)
+{
+    size_t parts = len / MIN_THREAD_SLICE;
+
+    if (parts > threads) {
+        parts = threads;
+    }
+    if (parts <= 1u) {
+        return wf_count_bytes_with(data, len, max_word, options, result);
+    }
+
+    *result = (WfResult){ 0 };
+    size_t cap = table_capacity_for(wf_estimate_unique(data, len, max_word));
+    while (cap != 0u && cap < parts * SLOTS_PER_THREAD) {
+        cap *= 2u;
+    }
+
+    SharedTable table = { .cap = cap, .workers = parts };
+    thrd_t *handles = calloc(parts, sizeof(*handles));
+    SharedWorker *workers = calloc(parts, sizeof(*workers));
+    table.slots = cap == 0u ? NULL : calloc(cap, sizeof(*table.slots));
+    table.gates = calloc(parts, sizeof(*table.gates));
+    if (handles == NULL || workers == NULL || table.slots == NULL ||
+        table.gates == NULL) {
+        free(handles);
+        free(workers);
+        free(table.slots);
+        free(table.gates);
+        return -1;
+    }
+
+    max_word = normalize_max_word(max_word);
+    ClassifyFn classify =
+            classifier_for(options != NULL ? options->scanner
+                                           : WF_SCANNER_SCALAR);
+    size_t start = 0;
+    size_t started = 0;
+    for (size_t part = 0; part < parts; part++) {
+        size_t end = len;
+        if (part + 1u < parts) {
+            end = split_at_separator(data, len, len / parts * (part + 1u));
+        }
+        if (end < start) {
+            end = start;
+        }
+        workers[part] = (SharedWorker){ .table = &table,
+                                        .gate = &table.gates[part],
+                                        .data = data + start,
+                                        .len = end - start,
+                                        .max_word = max_word,
+                                        .classify = classify };
+        start = end;
+        if (thrd_create(&handles[part], shared_worker, &workers[part]) !=
+            thrd_success) {
+            atomic_store(&table.failed, true);
+            break;
+        }
+        started++;
+    }
+
+    uint64_t total = 0;
+    WfArena *arena = NULL;
+    WfStats stats = { 0 };
+    for (size_t part = 0; part < started; part++) {
+        (void)thrd_join(handles[part], NULL);
+        total += workers[part].total;
+        arena_splice(&arena, workers[part].arena);
+        stats_merge(&stats, &workers[part].stats);
+    }
+
+    int status = -1;
+    if (!atomic_load(&table.failed) && started == parts) {
+        status = shared_finish(&table, total, options, result);
+    }
+    if (status == 0) {
+        stats.resizes = table.resizes;
+        stats.capacity = table.cap;
+        stats.bytes = table.cap * sizeof(*table.slots) + arena_bytes(arena);
+        stats.rank_ns = result->stats.rank_ns;
+        result->stats = stats;
+        result->arena = arena;
+    } else {
+        arena_free(arena);
+    }
+
+    shared_free(&table);
+    free(workers);
+    free(handles);
+    return status;
+}
+
+int wf_count_bytes_parallel(const unsigned char *data,
+                            size_t len,
+                            size_t max_word,
+                            size_t threads,
+                            WfResult *result)
+{
+    return wf_count_bytes_parallel_with(
+            data, len, max_word, threads, NULL, result);
+}
+
+static int compare_entries(const void *left, const void *right)
+{
+    const WfEntry *a = left;
+    const WfEntry *b = right;
+
+    if (a->count < b->count) {
+        return 1;
+    }
+    if (a->count > b->count) {
+        return -1;
+    }
+    return strcmp(a->word, b->word);
+}
+
+static uint64_t word_prefix(const char *word)
+{
+    uint64_t prefix = 0;
+
+    for (unsigned i = 0; i < 8u; i++) {
+        prefix <<= 8u;
+        if (*word != '\0') {
+            prefix |= (unsigned char)*word++;
+        }
+    }
+
+    return prefix;
+}
+
+static int compare_keys(const void *left, const void *right)
+{
+    const SortKey *a = left;
+    const SortKey *b = right;
+
+    if (a->count != b->count) {
+        return a->count < b->count ? 1 : -1;
+    }
+    if (a->prefix != b->prefix) {
+        return a->prefix < b->prefix ? -1 : 1;
+    }
+    return strcmp(a->word, b->word);
+}
+
+static int sort_run(void *arg)
+{
+    SortTask *task = arg;
+
+    qsort(task->out, task->left_len, sizeof(*task->out), compare_keys);
+    return 0;
+}
+
+static int merge_runs(void *arg)
+{
+    SortTask *task = arg;
+    SortKey *out = task->out;
+    size_t i = 0;
+    size_t j = 0;
+
+    while (i < task->left_len && j < task->right_len) {
+        if (compare_keys(&task->right[j], &task->left[i]) < 0) {
+            *out++ = task->right[j++];
+        } else {
+            *out++ = task->left[i++];
+        }
+    }
+    memcpy(out, task->left + i, (task->left_len - i) * sizeof(*out));
+    out += task->left_len - i;
+    memcpy(out, task->right + j, (task->right_len - j) * sizeof(*out));
+    return 0;
+}
+
+static void run_sort_tasks(thrd_start_t work,
+                           SortTask *tasks,
+                           size_t count,
+                           thrd_t *handles)
+{
+    size_t started = 0;
+
+    for (size_t i = 1; i < count; i++) {
+        if (thrd_create(&handles[started], work, &tasks[i]) == thrd_success) {
+            started++;
+        } else {
+            (void)work(&tasks[i]);
+        }
+    }
+    (void)work(&tasks[0]);
+    for (size_t i = 0; i < started; i++) {
+        (void)thrd_join(handles[i], NULL);
+    }
+}
+
+static int sort_keys(WfResult *result, size_t runs)
+{
+    size_t len = result->unique;
+    SortKey *keys = malloc((runs > 1u ? 2u : 1u) * len * sizeof(*keys));
+    SortTask *tasks = calloc(runs, sizeof(*tasks));
+    thrd_t *handles = calloc(runs, sizeof(*handles));
+    size_t *bounds = calloc(runs + 1u, sizeof(*bounds));
+    if (keys == NULL || tasks == NULL || handles == NULL || bounds == NULL) {
+        free(keys);
+        free(tasks);
+        free(handles);
+        free(bounds);
+        return -1;
+    }
+
+    for (size_t i = 0; i < len; i++) {
+        const WfEntry *entry = &result->entries[i];
+        keys[i] = (SortKey){ .count = entry->count,
+                             .prefix = word_prefix(entry->word),
+                             .word = entry->word };
+    }
+    for (size_t run = 0; run < runs; run++) {
+        bounds[run] = len / runs * run;
+    }
+    bounds[runs] = len;
+    for (size_t run = 0; run < runs; run++) {
+        tasks[run] = (SortTask){ .out = keys + bounds[run],
+                                 .left_len = bounds[run + 1u] - bounds[run] };
+    }
+    run_sort_tasks(sort_run, tasks, runs, handles);
+
+    SortKey *from = keys;
+    SortKey *to = keys + len;
+    for (size_t stride = 1; stride < runs; stride *= 2u) {
+        size_t pairs = 0;
+        for (size_t left = 0; left < runs; left += 2u * stride) {
+            size_t middle = left + stride < runs ? left + stride : runs;
+            size_t right = middle + stride < runs ? middle + stride : runs;
+            tasks[pairs++] =
+                    (SortTask){ .left = from + bounds[left],
+                                .right = from + bounds[middle],
+                                .out = to + bounds[left],
+                                .left_len = bounds[middle] - bounds[left],
+                                .right_len = bounds[right] - bounds[middle] };
+        }
+        run_sort_tasks(merge_runs, tasks, pairs, handles);
+
+        SortKey *held = from;
+        from = to;
+        to = held;
+    }
+
+    for (size_t i = 0; i < len; i++) {
+        result->entries[i] =
+                (WfEntry){ .word = from[i].word, .count = from[i].count };
+    }
+
+    free(keys);
+    free(tasks);
+    free(handles);
+    free(bounds);
+    return 0;
+}
+
+static void sort_result(WfResult *result, size_t threads)
+{
+    if (result->unique < 2u) {
+        return;
+    }
+
+    size_t runs = result->unique / SORT_MIN_RUN;
+    if (runs > threads) {
+        runs = threads > 1u ? threads : 1u;
+    }
+    if (runs > 0u && sort_keys(result, runs) == 0) {
+        return;
+    }
+    qsort(result->entries,
+          result->unique,
+          sizeof(*result->entries),
+          compare_entries);
+}
+
+void wf_result_sort(WfResult *result)
+{
+    sort_result(result, 1u);
+}
+
+static void swap_entries(WfEntry *a, WfEntry *b)
+{
+    WfEntry held = *a;
+    *a = *b;
+    *b = held;
+}
+
+static void sift_down(WfEntry *heap, size_t len, size_t root)
+{
+    for (;;) {
+        size_t worst = root;
+        size_t left = 2u * root + 1u;
+        size_t right = left + 1u;
+
+        if (left < len && compare_entries(&heap[left], &heap[worst]) > 0) {
+            worst = left;
+        }
+        if (right < len && compare_entries(&heap[right], &heap[worst]) > 0) {
+            worst = right;
+        }
+        if (worst == root) {
+            return;
+        }
+        swap_entries(&heap[root], &heap[worst]);
+        root = worst;
+    }
+}
+
+void wf_result_select(WfResult *result, size_t top)
+{
+    WfEntry *entries = result->entries;
+    size_t keep = top < result->unique ? top : result->unique;
+
+    if (keep == result->unique) {
+        wf_result_sort(result);
+        return;
+    }
+    if (keep == 0u) {
+        return;
+    }
+
+    for (size_t i = keep / 2u; i-- > 0u;) {
+        sift_down(entries, keep, i);
+    }
+    for (size_t i = keep; i < result->unique; i++) {
+        if (compare_entries(&entries[i], &entries[0]) < 0) {
+            swap_entries(&entries[0], &entries[i]);
+            sift_down(entries, keep, 0);
+        }
+    }
+    qsort(entries, keep, sizeof(*entries), compare_entries);
+}
+
+void wf_result_order(WfResult *result, const WfOptions *options)
+{
+    size_t top = options != NULL ? options->top : 0u;
+
+    if (result->unique == 0u) {
+        return;
+    }
+
+    uint64_t started = clock_ns();
+    if (top == 0u || top >= result->unique) {
+        sort_result(result, options != NULL ? options->sort_threads : 1u);
+    } else {
+        wf_result_select(result, top);
+    }
+    result->stats.rank_ns = clock_ns() - started;
+}
+
+static const unsigned char DUMP_MAGIC[4] = { 'W', 'F', 'D', '1' };
+
+static int compare_words(const void *left, const void *right)
+{
+    const WfEntry *a = *(const WfEntry *const *)left;
+    const WfEntry *b = *(const WfEntry *const *)right;
+
+    return strcmp(a->word, b->word);
+}
+
+static int compare_bytes(const unsigned char *a,
+                         size_t a_len,
+                         const unsigned char *b,
+                         size_t b_len)
+{
+    int order = memcmp(a, b, a_len < b_len ? a_len : b_len);
+    if (order != 0) {
+        return order;
+    }
+    return a_len < b_len ? -1 : a_len > b_len;
+}
+
+static size_t varint_size(uint64_t value)
+{
+    size_t size = 1;
+    while (value >= 0x80u) {
+        value >>= 7u;
+        size++;
+    }
+    return size;
+}
+
+static unsigned char *put_varint(unsigned char *out, uint64_t value)
+{
+    while (value >= 0x80u) {
+        *out++ = (unsigned char)(value | 0x80u);
+        value >>= 7u;
+    }
+    *out++ = (unsigned char)value;
+    return out;
+}
+
+static bool
+get_varint(const unsigned char *data, size_t len, size_t *pos, uint64_t *out)
+{
+    uint64_t value = 0;
+
+    for (unsigned shift = 0; shift < 64u && *pos < len; shift += 7u) {
+        unsigned char byte = data[(*pos)++];
+        value |= (uint64_t)(byte & 0x7fu) << shift;
+        if ((byte & 0x80u) == 0u) {
+            *out = value;
+            return true;
+        }
+    }
+    return false;
+}
+
+int wf_result_encode(const WfResult *result, unsigned char **data, size_t *len)
+{
+    size_t unique = result->unique;
+    const WfEntry **sorted = malloc((unique == 0u ? 1u : unique) *
+                                    sizeof(*sorted));
+    if (sorted == NULL) {
+        return -1;
+    }
+
+    size_t size = sizeof(DUMP_MAGIC) + varint_size(result->total) +
+                  varint_size((uint64_t)unique);
+    for (size_t i = 0; i < unique; i++) {
+        const WfEntry *entry = &result->entries[i];
+        size_t word_len = strlen(entry->word);
+
+        sorted[i] = entry;
+        size += varint_size((uint64_t)word_len) + word_len +
+                varint_size(entry->count);
+    }
+    if (unique > 1u) {
+        qsort(sorted, unique, sizeof(*sorted), compare_words);
+    }
+
+    unsigned char *out = malloc(size);
+    if (out == NULL) {
+        free(sorted);
+        return -1;
+    }
+
+    unsigned char *cursor = out;
+    memcpy(cursor, DUMP_MAGIC, sizeof(DUMP_MAGIC));
+    cursor = put_varint(cursor + sizeof(DUMP_MAGIC), result->total);
+    cursor = put_varint(cursor, (uint64_t)unique);
+    for (size_t i = 0; i < unique; i++) {
+        size_t word_len = strlen(sorted[i]->word);
+
+        cursor = put_varint(cursor, (uint64_t)word_len);
+        memcpy(cursor, sorted[i]->word, word_len);
+        cursor = put_varint(cursor + word_len, sorted[i]->count);
+    }
+
+    free(sorted);
+    *data = out;
+    *len = size;
+    return 0;
+}
+
+static int cursor_open(DumpCursor *cursor,
+                       const unsigned char *data,
+                       size_t len,
+                       uint64_t *total)
+{
+    *cursor = (DumpCursor){ .data = data, .len = len };
+    if (len < sizeof(DUMP_MAGIC) ||
+        memcmp(data, DUMP_MAGIC, sizeof(DUMP_MAGIC)) != 0) {
+        return -1;
+    }
+
+    cursor->pos = sizeof(DUMP_MAGIC);
+    if (!get_varint(data, len, &cursor->pos, &cursor->total) ||
+        !get_varint(data, len, &cursor->pos, &cursor->remaining) ||
+        cursor->remaining > (len - cursor->pos) / 3u) {
+        return -1;
+    }
+
+    *total += cursor->total;
+    return 0;
+}
+
+static int cursor_next(DumpCursor *cursor)
+{
+    if (cursor->remaining == 0u) {
+        return cursor->pos == cursor->len && cursor->sum == cursor->total
+                       ? 0
+                       : -1;
+    }
+
+    uint64_t word_len = 0;
+    uint64_t count = 0;
+    if (!get_varint(cursor->data, cursor->len, &cursor->pos, &word_len) ||
+        word_len == 0u || word_len > MAX_WORD ||
+        word_len > cursor->len - cursor->pos) {
+        return -1;
+    }
+
+    const unsigned char *word = cursor->data + cursor->pos;
+    cursor->pos += (size_t)word_len;
+    if (!get_varint(cursor->data, cursor->len, &cursor->pos, &count) ||
+        count == 0u) {
+        return -1;
+    }
+    for (size_t i = 0; i < (size_t)word_len; i++) {
+        if (word[i] < 'a' || word[i] > 'z') {
+            return -1;
+        }
+    }
+    if (cursor->word != NULL &&
+        compare_bytes(cursor->word, cursor->word_len, word, (size_t)word_len) >=
+                0) {
+        return -1;
+    }
+
+    cursor->word = word;
+    cursor->word_len = (size_t)word_len;
+    cursor->count = count;
+    cursor->sum += count;
+    cursor->remaining--;
+    return 1;
+}
+
+static bool cursor_after(const DumpCursor *a, const DumpCursor *b)
+{
+    return compare_bytes(a->word, a->word_len, b->word, b->word_len) > 0;
+}
+
+static void cursor_sift(DumpCursor **heap, size_t len, size_t root)
+{
+    for (;;) {
+        size_t least = root;
+        size_t left = 2u * root + 1u;
+        size_t right = left + 1u;
+
+        if (left < len && cursor_after(heap[least], heap[left])) {
+            least = left;
+        }
+        if (right < len && cursor_after(heap[least], heap[right])) {
+            least = right;
+        }
+        if (least == root) {
+            return;
+        }
+        DumpCursor *held = heap[root];
+        heap[root] = heap[least];
+        heap[least] = held;
+        root = least;
+    }
+}
+
+static int merge_cursors(DumpCursor **heap, size_t len, WfResult *result)
+{
+    for (size_t i = len / 2u; i-- > 0u;) {
+        cursor_sift(heap, len, i);
+    }
+
+    while (len > 0u) {
+        const unsigned char *word = heap[0]->word;
+        size_t word_len = heap[0]->word_len;
+        uint64_t count = 0;
+
+        while (len > 0u && heap[0]->word_len == word_len &&
+               memcmp(heap[0]->word, word, word_len) == 0) {
+            count += heap[0]->count;
+            int status = cursor_next(heap[0]);
+            if (status < 0) {
+                return -1;
+            }
+            if (status == 0) {
+                heap[0] = heap[--len];
+            }
+            cursor_sift(heap, len, 0);
+        }
+
+        char *copy = copy_word(&result->arena, word, word_len);
+        if (copy == NULL) {
+            return -1;
+        }
+        result->entries[result->unique++] =
+                (WfEntry){ .word = copy, .count = count };
+    }
+
+    return 0;
+}
+
+int wf_result_merge_with(const unsigned char *const *parts,
+                         const size_t *lens,
+                         size_t count,
+                         const WfOptions *options,
+                         WfResult *result)
+{
+    *result = (WfResult){ 0 };
+    DumpCursor *cursors = calloc(count == 0u ? 1u : count, sizeof(*cursors));
+    DumpCursor **heap = calloc(count == 0u ? 1u : count, sizeof(*heap));
+    if (cursors == NULL || heap == NULL) {
+        free(cursors);
+        free(heap);
+        return -1;
+    }
+
+    int status = 0;
+    uint64_t total = 0;
+    size_t capacity = 0;
+    size_t len = 0;
+    for (size_t i = 0; i < count && status == 0; i++) {
+        status = cursor_open(&cursors[i], parts[i], lens[i], &total);
+        capacity += (size_t)cursors[i].remaining;
+        if (status == 0) {
+            status = cursor_next(&cursors[i]);
+        }
+        if (status == 1) {
+            heap[len++] = &cursors[i];
+            status = 0;
+        }
+    }
+
+    if (status == 0 && capacity > 0u) {
+        result->entries = calloc(capacity, sizeof(*result->entries));
+        status = result->entries == NULL ? -1 : 0;
+    }
+    if (status == 0) {
+        status = merge_cursors(heap, len, result);
+    }
+
+    free(cursors);
+    free(heap);
+    if (status != 0) {
+        wf_result_free(result);
+        return -1;
+    }
+
+    result->total = total;
+    wf_result_order(result, options);
+    return 0;
+}
+
+int wf_result_merge(const unsigned char *const *parts,
+                    const size_t *lens,
+                    size_t count,
+                    WfResult *result)
+{
+    return wf_result_merge_with(parts, lens, count, NULL, result);
+}
+
+static const char *approx_word(const WfApprox *approx, size_t slot)
+{
+    return approx->words + approx->slots[slot].offset;
+}
+
+static bool approx_below(const WfApprox *approx, size_t a, size_t b)
+{
+    const ApproxSlot *x = &approx->slots[a];
+    const ApproxSlot *y = &approx->slots[b];
+
+    if (x->count != y->count) {
+        return x->count < y->count;
+    }
+    return compare_bytes((const unsigned char *)approx_word(approx, a),
+                         x->len,
+                         (const unsigned char *)approx_word(approx, b),
+                         y->len) > 0;
+}
+
+static void approx_swap(WfApprox *approx, size_t i, size_t j)
+{
+    size_t held = approx->heap[i];
+    approx->heap[i] = approx->heap[j];
+    approx->heap[j] = held;
+    approx->slots[approx->heap[i]].heap = i;
+    approx->slots[approx->heap[j]].heap = j;
+}
+
+static void approx_sift_up(WfApprox *approx, size_t position)
+{
+    while (position > 0u) {
+        size_t parent = (position - 1u) / 2u;
+        if (!approx_below(
+                    approx, approx->heap[position], approx->heap[parent])) {
+            return;
+        }
+        approx_swap(approx, position, parent);
+        position = parent;
+    }
+}
+
+static void approx_sift_down(WfApprox *approx, size_t position)
+{
+    for (;;) {
+        size_t least = position;
+        size_t left = 2u * position + 1u;
+        size_t right = left + 1u;
+
+        if (left < approx->len &&
+            approx_below(approx, approx->heap[left], approx->heap[least])) {
+            least = left;
+        }
+        if (right < approx->len &&
+            approx_below(approx, approx->heap[right], approx->heap[least])) {
+            least = right;
+        }
+        if (least == position) {
+            return;
+        }
+        approx_swap(approx, position, least);
+        position = least;
+    }
+}
+
+static size_t *approx_probe(WfApprox *approx,
+                            uint64_t hash,
+                            const unsigned char *word,
+                            size_t len)
+{
+    size_t mask = approx->index_cap - 1u;
+    size_t position = (size_t)hash & mask;
+
+    for (;; position = (position + 1u) & mask) {
+        size_t held = approx->index[position];
+        if (held == 0u) {
+            return &approx->index[position];
+        }
+
+        const ApproxSlot *slot = &approx->slots[held - 1u];
+        if (slot->hash == hash && slot->len == len &&
+            memcmp(approx_word(approx, held - 1u), word, len) == 0) {
+            return &approx->index[position];
+        }
+    }
+}
+
+static void approx_unlink(WfApprox *approx, size_t slot)
+{
+    size_t mask = approx->index_cap - 1u;
+    size_t hole = (size_t)approx->slots[slot].hash & mask;
+
+    while (approx->index[hole] != slot + 1u) {
+        hole = (hole + 1u) & mask;
+    }
+    for (size_t next = (hole + 1u) & mask; approx->index[next] != 0u;
+         next = (next + 1u) & mask) {
+        size_t home = (size_t)approx->slots[approx->index[next] - 1u].hash &
+                      mask;
+        if (((next - home) & mask) >= ((next - hole) & mask)) {
+            approx->index[hole] = approx->index[next];
+            hole = next;
+        }
+    }
+    approx->index[hole] = 0u;
+}
+
+static void approx_set_header(WfApprox *approx, size_t slot, uint32_t header)
+{
+    memcpy(approx->words + approx->slots[slot].offset - APPROX_WORD_HEADER,
+           &header,
+           sizeof(header));
+}
+
+static void approx_release(WfApprox *approx, size_t slot)
+{
+    size_t room = approx->slots[slot].room;
+
+    approx_set_header(approx, slot, APPROX_DEAD | (uint32_t)room);
+    approx->words_live -= APPROX_WORD_HEADER + room;
+}
+
+static void approx_compact(WfApprox *approx)
+{
+    size_t to = 0;
+
+    for (size_t from = 0; from < approx->words_used;) {
+        uint32_t header;
+        memcpy(&header, approx->words + from, sizeof(header));
+        if ((header & APPROX_DEAD) != 0u) {
+            from += APPROX_WORD_HEADER + (size_t)(header & ~APPROX_DEAD);
+            continue;
+        }
+
+        ApproxSlot *slot = &approx->slots[header];
+        memmove(approx->words + to,
+                approx->words + from,
+                APPROX_WORD_HEADER + slot->len);
+        from += APPROX_WORD_HEADER + slot->room;
+        approx->words_live -= slot->room - slot->len;
+        slot->offset = to + APPROX_WORD_HEADER;
+        slot->room = slot->len;
+        to += APPROX_WORD_HEADER + slot->len;
+    }
+    approx->words_used = to;
+}
+
+static void approx_drop(WfApprox *approx)
+{
+    size_t slot = approx->heap[0];
+    size_t last = approx->len - 1u;
+
+    approx->evicted = true;
+    approx->dropped = approx->slots[slot].count;
+    approx_unlink(approx, slot);
+    approx_release(approx, slot);
+    approx_swap(approx, 0u, last);
+    approx->len = last;
+    approx_sift_down(approx, 0u);
+    if (slot == last) {
+        return;
+    }
+
+    size_t mask = approx->index_cap - 1u;
+    size_t position = (size_t)approx->slots[last].hash & mask;
+    while (approx->index[position] != last + 1u) {
+        position = (position + 1u) & mask;
+    }
+    approx->index[position] = slot + 1u;
+    approx->slots[slot] = approx->slots[last];
+    approx->heap[approx->slots[slot].heap] = slot;
+    approx_set_header(approx, slot, (uint32_t)slot);
+}
+
+static void approx_reclaim(WfApprox *approx, size_t need)
+{
+    size_t slack = approx->words_cap / 8u;
+
+    while (approx->len > 0u &&
+           approx->words_live + need + slack > approx->words_cap) {
+        approx_drop(approx);
+    }
+    approx_compact(approx);
+}
+
+static void approx_fill(WfApprox *approx,
+                        size_t slot,
+                        uint64_t hash,
+                        const unsigned char *word,
+                        size_t len,
+                        uint64_t floor)
+{
+    memcpy(approx->words + approx->slots[slot].offset, word, len);
+    approx->slots[slot].hash = hash;
+    approx->slots[slot].len = len;
+    approx->slots[slot].count = floor + 1u;
+    approx->slots[slot].error = floor;
+}
+
+static void approx_store(WfApprox *approx,
+                         size_t slot,
+                         uint64_t hash,
+                         const unsigned char *word,
+                         size_t len,
+                         uint64_t floor)
+{
+    approx->slots[slot].offset = approx->words_used + APPROX_WORD_HEADER;
+    approx->slots[slot].room = len;
+    approx_set_header(approx, slot, (uint32_t)slot);
+    approx->words_used += APPROX_WORD_HEADER + len;
+    approx->words_live += APPROX_WORD_HEADER + len;
+    approx_fill(approx, slot, hash, word, len, floor);
+}
+
+static void approx_insert(WfApprox *approx,
+                          const unsigned char *bytes,
+                          size_t len)
+{
+    unsigned char word[MAX_WORD];
+    for (size_t i = 0; i < len; i++) {
+        word[i] = lower_ascii(bytes[i]);
+    }
+
+    uint64_t hash = mix_hash(hash_word(word, len));
+    approx->total++;
+    sketch_observe(approx->registers, approx->register_bits, hash);
+
+    size_t *cell = approx_probe(approx, hash, word, len);
+    if (*cell != 0u) {
+        size_t slot = *cell - 1u;
+        approx->slots[slot].count++;
+        approx_sift_down(approx, approx->slots[slot].heap);
+        return;
+    }
+
+    size_t need = APPROX_WORD_HEADER + len;
+    if (approx->len == approx->capacity) {
+        size_t victim = approx->heap[0];
+        bool reuse = len <= approx->slots[victim].room;
+        if (reuse || approx->words_used + need <= approx->words_cap) {
+            uint64_t floor = approx->slots[victim].count;
+            approx->evicted = true;
+            approx_unlink(approx, victim);
+            if (reuse) {
+                approx_fill(approx, victim, hash, word, len, floor);
+            } else {
+                approx_release(approx, victim);
+                approx_store(approx, victim, hash, word, len, floor);
+            }
+            *approx_probe(approx, hash, word, len) = victim + 1u;
+            approx_sift_down(approx, 0u);
+            return;
+        }
+        approx_drop(approx);
+    }
+    if (approx->words_used + need > approx->words_cap) {
+        approx_reclaim(approx, need);
+    }
+    size_t slot = approx->len++;
+    approx_store(approx, slot, hash, word, len, approx->dropped);
+    *approx_probe(approx, hash, word, len) = slot + 1u;
+    approx->heap[slot] = slot;
+    approx->slots[slot].heap = slot;
+    approx_sift_up(approx, slot);
+}
+
+static void approx_flush(WfApprox *approx)
+{
+    if (approx->in_word) {
+        approx_insert(approx, approx->pending, approx->pending_len);
+        approx->pending_len = 0;
+        approx->in_word = false;
+    }
+}
+
+static void approx_stash(WfApprox *approx,
+                         const unsigned char *bytes,
+                         size_t len)
+{
+    size_t room = approx->max_word - approx->pending_len;
+    size_t stored_len = len < room ? len : room;
+
+    memcpy(approx->pending + approx->pending_len, bytes, stored_len);
+    approx->pending_len += stored_len;
+    approx->in_word = true;
+}
+
+static void
+approx_rank_sift(const WfApprox *approx, size_t *best, size_t len, size_t root)
+{
+    for (;;) {
+        size_t lowest = root;
+        size_t left = 2u * root + 1u;
+        size_t right = left + 1u;
+
+        if (left < len && approx_below(approx, best[left], best[lowest])) {
+            lowest = left;
+        }
+        if (right < len && approx_below(approx, best[right], best[lowest])) {
+            lowest = right;
+        }
+        if (lowest == root) {
+            return;
+        }
+        size_t held = best[root];
+        best[root] = best[lowest];
+        best[lowest] = held;
+        root = lowest;
+    }
+}
+
+static void approx_rank(const WfApprox *approx, size_t *best, size_t keep)
+{
+    for (size_t slot = 0; slot < keep; slot++) {
+        best[slot] = slot;
+    }
+    for (size_t i = keep / 2u; i-- > 0u;) {
+        approx_rank_sift(approx, best, keep, i);
+    }
+    for (size_t slot = keep; slot < approx->len; slot++) {
+        if (approx_below(approx, best[0], slot)) {
+            best[0] = slot;
+            approx_rank_sift(approx, best, keep, 0u);
+        }
+    }
+    for (size_t end = keep; end-- > 1u;) {
+        size_t held = best[0];
+        best[0] = best[end];
+        best[end] = held;
+        approx_rank_sift(approx, best, end, 0u);
+    }
+}
+
+WfApprox *wf_approx_new(size_t max_word, size_t budget)
+{
+    size_t register_bits = APPROX_MIN_REGISTER_BITS;
+    while (register_bits < APPROX_MAX_REGISTER_BITS &&
+           ((size_t)2u << register_bits) <= budget / 16u) {
+        register_bits++;
+    }
+
+    max_word = normalize_max_word(max_word);
+    size_t registers = (size_t)1u << register_bits;
+    size_t word_bytes = APPROX_WORD_HEADER + APPROX_WORD_BYTES;
+    size_t counter_bytes = sizeof(ApproxSlot) + sizeof(size_t) + word_bytes;
+    size_t pool_floor = 2u * (APPROX_WORD_HEADER + max_word);
+    size_t room = budget > registers + pool_floor
+                          ? budget - registers - pool_floor
+                          : 0u;
+    size_t index_cap = table_capacity_for(
+            room / (counter_bytes + sizeof(size_t) * 10u / 7u));
+    if (index_cap == 0u) {
+        return NULL;
+    }
+
+    size_t index_bytes = index_cap * sizeof(size_t);
+    size_t capacity =
+            room > index_bytes ? (room - index_bytes) / counter_bytes : 0u;
+    if (capacity > index_cap * 7u / 10u) {
+        capacity = index_cap * 7u / 10u;
+    }
+    if (capacity == 0u) {
+        errno = EINVAL;
+        return NULL;
+    }
+    if (capacity >= APPROX_DEAD) {
+        capacity = APPROX_DEAD - 1u;
+    }
+    size_t words_cap = pool_floor + capacity * word_bytes;
+
+    WfApprox *approx = calloc(1u, sizeof(*approx));
+    if (approx == NULL) {
+        return NULL;
+    }
+    *approx = (WfApprox){ .slots = calloc(capacity, sizeof(ApproxSlot)),
+                          .heap = calloc(capacity, sizeof(size_t)),
+                          .index = calloc(index_cap, sizeof(size_t)),
+                          .words = malloc(words_cap),
+                          .registers = calloc(registers, 1u),
+                          .capacity = capacity,
+                          .index_cap = index_cap,
+                          .words_cap = words_cap,
+                          .register_bits = register_bits,
+                          .max_word = max_word };
+    if (approx->slots == NULL || approx->heap == NULL ||
+        approx->index == NULL || approx->words == NULL ||
+        approx->registers == NULL) {
+        wf_approx_free(approx);
+        return NULL;
+    }
+
+    return approx;
+}
+
+int wf_approx_feed(WfApprox *approx, const unsigned char *data, size_t len)
+{
+    Scanner scanner;
+    size_t cursor = 0;
+
+    scanner_init(&scanner, data, len, approx->classify);
+    if (approx->in_word) {
+        cursor = scan_run(&scanner, cursor, true);
+        if (cursor > 0) {
+            approx_stash(approx, data, cursor);
+        }
+        if (cursor == len) {
+            return 0;
+        }
+        approx_flush(approx);
+    }
+
+    while (cursor < len) {
+        cursor = scan_run(&scanner, cursor, false);
+
+        size_t start = cursor;
+        cursor = scan_run(&scanner, cursor, true);
+
+        size_t word_len = cursor - start;
+        if (word_len > 0 && cursor == len) {
+            approx_stash(approx, data + start, word_len);
+            return 0;
+        }
+        if (word_len > 0) {
+            approx_insert(approx,
+                          data + start,
+                          word_len < approx->max_word ? word_len
+                                                      : approx->max_word);
+        }
+    }
+
+    return 0;
+}
+
+int wf_approx_end_word(WfApprox *approx)
+{
+    approx_flush(approx);
+    return 0;
+}
+
+int wf_approx_finish(WfApprox *approx, size_t top, WfApproxResult *result)
+{
+    approx_flush(approx);
+    *result = (WfApproxResult){ .total = approx->total,
+                                .unique = approx->len,
+                                .counters = approx->capacity };
+    if (approx->evicted) {
+        size_t registers = (size_t)1u << approx->register_bits;
+        result->unique = (uint64_t)(sketch_estimate(approx->registers,
+                                                  approx->register_bits) +
+                                  0.5);
+        result->unique_error = 1.04 / sqrt((double)registers);
+        result->max_error = approx->slots[approx->heap[0]].count;
+    }
+    size_t keep = top == 0u || top > approx->len ? approx->len : top;
+    if (keep == 0u) {
+        return 0;
+    }
+
+    size_t *best = malloc(keep * sizeof(*best));
+    result->entries = calloc(keep, sizeof(*result->entries));
+    if (best == NULL || result->entries == NULL) {
+        free(best);
+        wf_approx_result_free(result);
+        return -1;
+    }
+
+    approx_rank(approx, best, keep);
+    for (size_t i = 0; i < keep; i++) {
+        const ApproxSlot *counter = &approx->slots[best[i]];
+        char *word = arena_alloc(&result->arena, counter->len + 1u);
+        if (word == NULL) {
+            free(best);
+            wf_approx_result_free(result);
+            return -1;
+        }
+        memcpy(word, approx_word(approx, best[i]), counter->len);
+        word[counter->len] = '\0';
+        result->entries[result->len++] = (WfApproxEntry){
+            .word = word, .count = counter->count, .error = counter->error
+        };
+    }
+    free(best);
+    return 0;
+}
+
+void wf_approx_set_scanner(WfApprox *approx, WfScanner scanner)
+{
+    approx->classify = classifier_for(scanner);
+}
+
+void wf_approx_free(WfApprox *approx)
+{
+    if (approx == NULL) {
+        return;
+    }
+    free(approx->slots);
+    free(approx->heap);
+    free(approx->index);
+    free(approx->words);
+    free(approx->registers);
+    free(approx);
+}
+
+void wf_approx_result_free(WfApproxResult *result)
+{
+    free(result->entries);
+    arena_free(result->arena);
+    *result = (WfApproxResult){ 0 };
+}
+
+static int window_add(WfWindow *window, const WfEntry *entry)
+{
+    Table *table = &window->table;
+    const unsigned char *bytes = (const unsigned char *)entry->word;
+    size_t len = strlen(entry->word);
+    uint64_t hash = table_hash(bytes, len);
+
+    if (table->cap == 0 || (table->len + 1u) * 10u >= table->cap * 7u) {
+        if (table_grow(table) != 0) {
+            return -1;
+        }
+    }
+
+    size_t index = table_slot(table, hash, bytes, len);
+    Slot *slot = &table->slots[index];
+    table->total += entry->count;
+    if (slot->word != NULL) {
+        window->live += slot->count == 0u ? 1u : 0u;
+        slot->count += entry->count;
+        return 0;
+    }
+
+    char *word = arena_alloc(&table->arena, len + 1u);
+    if (word == NULL) {
+        return -1;
+    }
+    memcpy(word, entry->word, len + 1u);
+    table_fill(table,
+               index,
+               (Slot){ .word = word,
+                       .len = len,
+                       .count = entry->count,
+                       .hash = hash });
+    table->len++;
+    window->live++;
+    return 0;
+}
+
+static void window_remove(WfWindow *window, const WfEntry *entry)
+{
+    Slot *slot = table_find(&window->table,
+                            (const unsigned char *)entry->word,
+                            strlen(entry->word));
+
+    slot->count -= entry->count;
+    window->table.total -= entry->count;
+    window->live -= slot->count == 0u ? 1u : 0u;
+}
+
+static int window_rank_all(WfWindow *window)
+{
+    const Table *table = &window->table;
+    WfResult all = { .entries = malloc((window->live == 0u ? 1u
+                                                           : window->live) *
+                                       sizeof(WfEntry)) };
+    if (all.entries == NULL) {
+        return -1;
+    }
+
+    for (size_t i = 0; i < table->cap && all.unique < window->live; i++) {
+        const Slot *slot = &table->slots[i];
+
+        if (slot->word != NULL && slot->count > 0u) {
+            all.entries[all.unique++] =
+                    (WfEntry){ .word = slot->word, .count = slot->count };
+        }
+    }
+    wf_result_select(&all, window->reserve);
+
+    window->ranked_len =
+            all.unique < window->reserve ? all.unique : window->reserve;
+    memcpy(window->ranked,
+           all.entries,
+           window->ranked_len * sizeof(*window->ranked));
+    window->complete = window->ranked_len == window->live;
+    free(all.entries);
+    return 0;
+}
+
+static int window_compact(WfWindow *window)
+{
+    Table *table = &window->table;
+    Table next = { .cap = table_capacity_for(window->live) };
+
+    if (next.cap == 0u || table_storage(&next) != 0) {
+        return -1;
+    }
+
+    for (size_t i = 0; i < table->cap; i++) {
+        Slot slot = table->slots[i];
+
+        if (slot.word == NULL || slot.count == 0u) {
+            continue;
+        }
+        slot.word = arena_alloc(&next.arena, slot.len + 1u);
+        if (slot.word == NULL) {
+            table_free(&next);
+            return -1;
+        }
+        memcpy(slot.word, table->slots[i].word, slot.len + 1u);
+        table_fill(&next, table_vacancy(&next, slot.hash), slot);
+        next.len++;
+    }
+
+    next.total = table->total;
+    table_free(table);
+    *table = next;
+    return window_rank_all(window);
+}
+
+static size_t window_candidates(const WfWindow *window,
+                                const WfResult *changed,
+                                const WfEntry *bound,
+                                WfEntry *out)
+{
+    size_t len = 0;
+
+    for (size_t i = 0; i < changed->unique; i++) {
+        const char *word = changed->entries[i].word;
+        const Slot *slot = table_find(
+                &window->table, (const unsigned char *)word, strlen(word));
+        WfEntry entry = { .word = slot->word, .count = slot->count };
+
+        if (entry.count > 0u &&
+            (bound == NULL || compare_entries(&entry, bound) <= 0)) {
+            out[len++] = entry;
+        }
+    }
+    return len;
+}
+
+static int window_rerank(WfWindow *window,
+                         const WfResult *closed,
+                         const WfResult *expired)
+{
+    const WfEntry *bound = NULL;
+    WfEntry last = { 0 };
+    if (!window->complete && window->ranked_len > 0u) {
+        last = window->ranked[window->ranked_len - 1u];
+        bound = &last;
+    }
+
+    size_t cap = window->ranked_len + closed->unique + expired->unique;
+    WfEntry *candidates = malloc((cap == 0u ? 1u : cap) * sizeof(*candidates));
+    if (candidates == NULL) {
+        return -1;
+    }
+
+    WfResult ranked = { .entries = window->ranked,
+                        .unique = window->ranked_len };
+    size_t len = window_candidates(window, &ranked, bound, candidates);
+    len += window_candidates(window, closed, bound, candidates + len);
+    len += window_candidates(window, expired, bound, candidates + len);
+    if (len > 1u) {
+        qsort(candidates, len, sizeof(*candidates), compare_entries);
+    }
+
+    size_t kept = 0;
+    for (size_t i = 0; i < len && kept < window->reserve; i++) {
+        if (kept > 0u && candidates[i].word == window->ranked[kept - 1u].word) {
+            continue;
+        }
+        window->ranked[kept++] = candidates[i];
+    }
+    free(candidates);
+
+    window->ranked_len = kept;
+    window->complete = kept == window->live;
+    if (!window->complete && kept < window->top) {
+        return window_rank_all(window);
+    }
+    return 0;
+}
+
+WfWindow *wf_window_new(size_t max_word, size_t buckets, size_t top)
+{
+    if (buckets == 0u || top == 0u || top > SIZE_MAX / 2u - 16u) {
+        return NULL;
+    }
+
+    WfWindow *window = calloc(1u, sizeof(*window));
+    if (window == NULL) {
+        return NULL;
+    }
+    window->buckets = calloc(buckets, sizeof(*window->buckets));
+    window->reserve = top * 2u + 16u;
+    window->ranked = malloc(window->reserve * sizeof(*window->ranked));
+    if (window->buckets == NULL || window->ranked == NULL ||
+        counter_init(&window->current, max_word, 0u) != 0) {
+        free(window->buckets);
+        free(window->ranked);
+        free(window);
+        return NULL;
+    }
+
+    window->bucket_count = buckets;
+    window->top = top;
+    window->complete = true;
+    return window;
+}
+
+void wf_window_set_scanner(WfWindow *window, WfScanner scanner)
+{
+    window->current.classify = classifier_for(scanner);
+}
+
+int wf_window_feed(WfWindow *window, const unsigned char *data, size_t len)
+{
+    return wf_counter_feed(&window->current, data, len);
+}
+
+int wf_window_end_word(WfWindow *window)
+{
+    return counter_flush(&window->current);
+}
+
+int wf_window_advance(WfWindow *window)
+{
+    WfResult closed = { 0 };
+    if (collect(&window->current.table, &closed) != 0) {
+        return -1;
+    }
+    table_clear(&window->current.table);
+
+    WfResult *slot = &window->buckets[window->head];
+    WfResult expired = *slot;
+    *slot = closed;
+    window->head = (window->head + 1u) % window->bucket_count;
+
+    int status = 0;
+    for (size_t i = 0; i < closed.unique && status == 0; i++) {
+        status = window_add(window, &closed.entries[i]);
+    }
+    for (size_t i = 0; i < expired.unique && status == 0; i++) {
+        window_remove(window, &expired.entries[i]);
     }
+    if (status == 0) {
+        status = window_rerank(window, &closed, &expired);
+    }
+    if (status == 0 && window->table.len > 1024u &&
+        window->table.len - window->live > window->live) {
+        status = window_compact(window);
+    }
+
+    wf_result_free(&expired);
+    return status;
+}
+
+int wf_window_top(const WfWindow *window, WfResult *result)
+{
+    size_t len = window->ranked_len < window->top ? window->ranked_len
+                                                  : window->top;
+
+    *result = (WfResult){ .unique = 0u, .total = window->table.total };
+    if (len > 0u) {
+        result->entries = calloc(len, sizeof(*result->entries));
+        if (result->entries == NULL) {
+            *result = (WfResult){ 0 };
+            return -1;
+        }
+    }
+
+    for (size_t i = 0; i < len; i++) {
+        const WfEntry *entry = &window->ranked[i];
+        char *word = copy_word(&result->arena,
+                               (const unsigned char *)entry->word,
+                               strlen(entry->word));
+        if (word == NULL) {
+            wf_result_free(result);
+            return -1;
+        }
+        result->entries[result->unique++] =
+                (WfEntry){ .word = word, .count = entry->count };
+    }
+    return 0;
+}
+
+size_t wf_window_unique(const WfWindow *window)
+{
+    return window->live;
+}
+
+void wf_window_free(WfWindow *window)
+{
+    if (window == NULL) {
+        return;
+    }
+    for (size_t i = 0; i < window->bucket_count; i++) {
+        wf_result_free(&window->buckets[i]);
+    }
+    table_free(&window->current.table);
+    table_free(&window->table);
+    free(window->buckets);
+    free(window->ranked);
+    free(window);
+}
+
+int wf_stats_enabled(void)
+{
+#if defined(WFC_STATS)
+    return 1;
+#else
+    return 0;
+#endif
+}
+
+void wf_result_free(WfResult *result)
+{
     free(result->entries);
+    arena_free(result->arena);
     *result = (WfResult){ 0 };
 }
@@ -0,0 +1,441 @@
+#include "wordcount.hpp"
+
+#include "wordfreq.h"
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <print>
+
+#if defined(__has_feature)
+#if __has_feature(address_sanitizer) || __has_feature(thread_sanitizer)
+#define BENCH_SANITIZED 1
+#endif
+#endif
+#if defined(__SANITIZE_ADDRESS__) || defined(__SANITIZE_THREAD__)
+#define BENCH_SANITIZED 1
+#endif
+#if defined(__GLIBC__) && !defined(BENCH_SANITIZED)
+#define BENCH_COUNTS_ALLOCATIONS 1
+#endif
+
+namespace
+{
+
+std::atomic<std::uint64_t> allocations{ 0 };
+std::atomic<std::int64_t> live_bytes{ 0 };
+
+}  // namespace
+
+#if defined(BENCH_COUNTS_ALLOCATIONS)
+#include <malloc.h>
+
+namespace
+{
+
+void track(void *pointer, std::int64_t sign)
+{
+    if (pointer != nullptr) {
+        live_bytes.fetch_add(
+                sign * static_cast<std::int64_t>(malloc_usable_size(pointer)),
+                std::memory_order_relaxed);
+    }
+}
+
+}  // namespace
+
+extern "C" {
+
+auto __libc_malloc(std::size_t size) -> void *;
+auto __libc_calloc(std::size_t count, std::size_t size) -> void *;
+auto __libc_realloc(void *pointer, std::size_t size) -> void *;
+void __libc_free(void *pointer);
+
+auto malloc(std::size_t size) noexcept -> void *
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    auto *pointer = __libc_malloc(size);
+    track(pointer, 1);
+    return pointer;
+}
+
+auto calloc(std::size_t count, std::size_t size) noexcept -> void *
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    auto *pointer = __libc_calloc(count, size);
+    track(pointer, 1);
+    return pointer;
+}
+
+auto realloc(void *pointer, std::size_t size) noexcept -> void *
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    track(pointer, -1);
+    auto *moved = __libc_realloc(pointer, size);
+    track(moved == nullptr && size != 0 ? pointer : moved, 1);
+    return moved;
+}
+
+void free(void *pointer) noexcept
+{
+    track(pointer, -1);
+    __libc_free(pointer);
+}
+}
+#endif
+
+namespace
+{
+
+using namespace wordcount;
+using Clock = std::chrono::steady_clock;
+
+constexpr auto usage = "usage: wordcount_bench [--runs N] [--warmups N] "
+                       "[--top N] [--max-word N] [--threads N] <file>...";
+
+struct BenchOptions {
+    std::vector<std::string> paths;
+    std::size_t runs = 10;
+    std::size_t warmups = 1;
+    std::size_t top = 10;
+    std::size_t max_word = 1024;
+    std::size_t threads = 1;
+};
+
+struct Sample {
+    double read_ms = 0;
+    double scan_ms = 0;
+    double count_ms = 0;
+    double materialize_ms = 0;
+    double sort_ms = 0;
+    std::uint64_t tokens = 0;
+    std::uint64_t allocations = 0;
+    std::int64_t table_bytes = 0;
+    std::size_t resizes = 0;
+    Result result;
+};
+
+struct Phase {
+    const char *name;
+    double (*value)(const Sample &sample);
+};
+
+constexpr std::array phases{
+    Phase{ "read", [](const Sample &sample) { return sample.read_ms; } },
+    Phase{ "scan", [](const Sample &sample) { return sample.scan_ms; } },
+    Phase{ "insert",
+           [](const Sample &sample) {
+               return std::max(0.0, sample.count_ms - sample.scan_ms);
+           } },
+    Phase{ "materialize",
+           [](const Sample &sample) { return sample.materialize_ms; } },
+    Phase{ "sort", [](const Sample &sample) { return sample.sort_ms; } },
+    Phase{ "engine",
+           [](const Sample &sample) {
+               return sample.count_ms + sample.materialize_ms +
+                      sample.sort_ms;
+           } },
+    Phase{ "total",
+           [](const Sample &sample) {
+               return sample.read_ms + sample.count_ms +
+                      sample.materialize_ms + sample.sort_ms;
+           } },
+};
+
+struct EngineBench {
+    const char *name;
+    void (*count)(std::span<const unsigned char> bytes,
+                  const BenchOptions &options,
+                  Sample &sample);
+};
+
+[[nodiscard]] auto parse_bench_args(int argc, char **argv) -> BenchOptions
+{
+    BenchOptions options;
+
+    for (int index = 1; index < argc; ++index) {
+        const std::string_view arg{ argv[index] };
+
+        if (arg == "--runs" || arg == "--warmups" || arg == "--top" ||
+            arg == "--max-word" || arg == "--threads") {
+            if (++index >= argc) {
+                throw std::invalid_argument{ usage };
+            }
+            const auto value = parse_size(argv[index]);
+            if (arg == "--runs") {
+                options.runs = value;
+            } else if (arg == "--warmups") {
+                options.warmups = value;
+            } else if (arg == "--top") {
+                options.top = value;
+            } else if (arg == "--threads") {
+                options.threads = value;
+            } else {
+                options.max_word = value;
+            }
+        } else if (arg.starts_with("--runs=")) {
+            options.runs = parse_size(arg.substr(7));
+        } else if (arg.starts_with("--warmups=")) {
+            options.warmups = parse_size(arg.substr(10));
+        } else if (arg.starts_with("--top=")) {
+            options.top = parse_size(arg.substr(6));
+        } else if (arg.starts_with("--max-word=")) {
+            options.max_word = parse_size(arg.substr(11));
+        } else if (arg.starts_with("--threads=")) {
+            options.threads = parse_size(arg.substr(10));
+        } else if (!arg.starts_with("-")) {
+            options.paths.emplace_back(arg);
+        } else {
+            throw std::invalid_argument{ usage };
+        }
+    }
+
+    if (options.paths.empty() || options.runs == 0 || options.top == 0 ||
+        options.threads == 0) {
+        throw std::invalid_argument{ usage };
+    }
+    options.max_word = normalize_max_word(options.max_word);
+
+    return options;
+}
+
+[[nodiscard]] auto json_string(std::string_view text) -> std::string
+{
+    std::string escaped;
+    escaped.reserve(text.size());
+    for (const auto character : text) {
+        if (character == '"' || character == '\\') {
+            escaped.push_back('\\');
+        }
+        escaped.push_back(character);
+    }
+    return escaped;
+}
+
+[[nodiscard]] auto elapsed_ms(Clock::time_point from, Clock::time_point to)
+        -> double
+{
+    return std::chrono::duration<double, std::milli>(to - from).count();
+}
+
+void count_c(std::span<const unsigned char> bytes,
+             const BenchOptions &options,
+             Sample &sample)
+{
+    const auto started = Clock::now();
+    const std::unique_ptr<WfCounter, decltype(&wf_counter_free)> counter{
+        wf_counter_new(options.max_word, 0), wf_counter_free
+    };
+    if (!counter ||
+        wf_counter_reserve(counter.get(),
+                           wf_estimate_unique(bytes.data(),
+                                              bytes.size(),
+                                              options.max_word)) != 0) {
+        throw std::bad_alloc{};
+    }
+
+    WfResult result{};
+    if (wf_counter_feed(counter.get(), bytes.data(), bytes.size()) != 0) {
+        throw std::bad_alloc{};
+    }
+    const auto counted = Clock::now();
+    sample.table_bytes = live_bytes.load(std::memory_order_relaxed);
+    if (wf_counter_collect(counter.get(), &result) != 0) {
+        throw std::bad_alloc{};
+    }
+    const auto collected = Clock::now();
+    const WfOptions sorting{ .sort_threads = options.threads };
+    wf_result_order(&result, &sorting);
+    const auto sorted = Clock::now();
+
+    sample.count_ms = elapsed_ms(started, counted);
+    sample.materialize_ms = elapsed_ms(counted, collected);
+    sample.sort_ms = elapsed_ms(collected, sorted);
+    sample.allocations = allocations.load(std::memory_order_relaxed);
+    sample.resizes = result.stats.resizes;
+
+    const auto keep = std::min(options.top, result.unique);
+    std::vector<Entry> top;
+    top.reserve(keep);
+    for (const auto &entry : std::span{ result.entries, keep }) {
+        top.push_back({ entry.word, entry.count });
+    }
+    sample.result = { .total = result.total,
+                      .unique = result.unique,
+                      .top = std::move(top) };
+    wf_result_free(&result);
+}
+
+template <typename Map>
+void count_cpp(std::span<const unsigned char> bytes,
+               const BenchOptions &options,
+               Sample &sample)
+{
+    const auto started = Clock::now();
+    Counter<Map> counter{ options.max_word, 0, nullptr };
+    counter.reserve(sampled_unique_words(bytes, options.max_word));
+    counter.feed(bytes);
+    counter.end_word();
+    const auto counted = Clock::now();
+    sample.table_bytes = live_bytes.load(std::memory_order_relaxed);
+    auto entries = counter.entries();
+    const auto collected = Clock::now();
+    sort_entries(entries, options.threads);
+    if (entries.size() > options.top) {
+        entries.resize(options.top);
+    }
+    const auto sorted = Clock::now();
+
+    sample.count_ms = elapsed_ms(started, counted);
+    sample.materialize_ms = elapsed_ms(counted, collected);
+    sample.sort_ms = elapsed_ms(collected, sorted);
+    sample.allocations = allocations.load(std::memory_order_relaxed);
+    sample.resizes = counter.resizes();
+    sample.result = { .total = counter.total(),
+                      .unique = counter.unique(),
+                      .top = std::move(entries) };
+}
+
+constexpr std::array engines{
+    EngineBench{ "c", count_c },
+    EngineBench{ "cpp", count_cpp<StandardMap> },
+    EngineBench{ "cpp-compact", count_cpp<CompactTable> },
+};
+
+[[nodiscard]] auto measure(const std::string &path,
+                           const EngineBench &engine,
+                           const BenchOptions &options) -> Sample
+{
+    Sample sample;
+
+    const auto started = Clock::now();
+    const auto bytes = read_file(path);
+    const auto read = Clock::now();
+    sample.tokens = count_tokens(bytes);
+    const auto scanned = Clock::now();
+    sample.read_ms = elapsed_ms(started, read);
+    sample.scan_ms = elapsed_ms(read, scanned);
+
+    const auto before = allocations.load(std::memory_order_relaxed);
+    const auto resident = live_bytes.load(std::memory_order_relaxed);
+    engine.count(bytes, options, sample);
+    sample.allocations -= before;
+    sample.table_bytes -= resident;
+
+    if (sample.tokens != sample.result.total) {
+        throw std::runtime_error{ "scan and count disagree on token total" };
+    }
+    return sample;
+}
+
+[[nodiscard]] auto percentile(std::vector<double> values, double quantile)
+        -> double
+{
+    std::ranges::sort(values);
+    const auto rank = static_cast<std::size_t>(
+            std::ceil(quantile * static_cast<double>(values.size())));
+    return values[std::clamp(rank, std::size_t{ 1 }, values.size()) - 1];
+}
+
+[[nodiscard]] auto per_second(double amount, double ms) -> double
+{
+    return ms > 0 ? amount * 1000.0 / ms : 0.0;
+}
+
+void render_engine(const EngineBench &engine,
+                   const std::vector<Sample> &samples,
+                   std::size_t bytes)
+{
+    const auto &first = samples.front();
+    std::print("{{\"engine\":\"{}\",\"checksum\":{},\"tokens\":{},"
+               "\"unique\":{},\"resizes\":{},",
+               engine.name,
+               checksum(first.result),
+               first.result.total,
+               first.result.unique,
+               first.resizes);
+
+#if defined(BENCH_COUNTS_ALLOCATIONS)
+    std::print("\"allocations\":{},\"bytes_per_unique\":{:.1f},",
+               first.allocations,
+               first.result.unique == 0
+                       ? 0.0
+                       : static_cast<double>(first.table_bytes) /
+                                 static_cast<double>(first.result.unique));
+#else
+    std::print("\"allocations\":null,\"bytes_per_unique\":null,");
+#endif
+
+    std::print("\"phases\":{{");
+    auto engine_p50 = 0.0;
+    for (std::size_t index = 0; index < phases.size(); ++index) {
+        std::vector<double> values;
+        values.reserve(samples.size());
+        for (const auto &sample : samples) {
+            values.push_back(phases[index].value(sample));
+        }
+        const auto p50 = percentile(values, 0.5);
+        if (std::string_view{ phases[index].name } == "engine") {
+            engine_p50 = p50;
+        }
+        std::print("{}\"{}\":{{\"p50_ms\":{:.6f},\"p99_ms\":{:.6f}}}",
+                   index == 0 ? "" : ",",
+                   phases[index].name,
+                   p50,
+                   percentile(values, 0.99));
+    }
+
+    std::print("}},\"bytes_per_s\":{:.0f},\"tokens_per_s\":{:.0f}}}",
+               per_second(static_cast<double>(bytes), engine_p50),
+               per_second(static_cast<double>(first.result.total),
+                          engine_p50));
+}
+
+void render_fixture(const std::string &path, const BenchOptions &options)
+{
+    const auto bytes = read_file(path).size();
+    std::print("{{\"fixture\":\"{}\",\"bytes\":{},\"engines\":[",
+               json_string(path),
+               bytes);
+
+    for (std::size_t index = 0; index < engines.size(); ++index) {
+        const auto &engine = engines[index];
+        for (std::size_t warmup = 0; warmup < options.warmups; ++warmup) {
+            (void)measure(path, engine, options);
+        }
+
+        std::vector<Sample> samples;
+        samples.reserve(options.runs);
+        for (std::size_t run = 0; run < options.runs; ++run) {
+            samples.push_back(measure(path, engine, options));
+        }
+
+        std::print("{}", index == 0 ? "" : ",");
+        render_engine(engine, samples, bytes);
+    }
+
+    std::print("]}}");
+}
+
+}  // namespace
+
+auto main(int argc, char **argv) -> int
+{
+    try {
+        const auto options = parse_bench_args(argc, argv);
+        std::print("{{\"runs\":{},\"fixtures\":[", options.runs);
+        for (std::size_t index = 0; index < options.paths.size(); ++index) {
+            std::print("{}", index == 0 ? "" : ",");
+            render_fixture(options.paths[index], options);
+        }
+        std::println("]}}");
+        return 0;
+    } catch (const std::exception &error) {
+        (void)std::fprintf(stderr, "wordcount_bench: %s\n", error.what());
+        return 1;
+    }
+}
@@ -1,91 +1,93 @@
-#include <algorithm>
+#include "server.hpp"
+#include "wordcount.hpp"
+
+#include <array>
 #include <charconv>
 #include <chrono>
-#include <cstddef>
 #include <cstdio>
-#include <cstdint>
-#include <fstream>
+#include <limits>
+#include <memory>
 #include <print>
-#include <stdexcept>
-#include <string>
-#include <string_view>
-#include <system_error>
-#include <unordered_map>
-#include <vector>
 
 namespace
 {
 
-constexpr auto default_max_word = std::size_t{ 64 };
-constexpr auto estimated_bytes_per_unique_word = std::size_t{ 32 };
-constexpr auto max_word_limit = std::size_t{ 1024 };
-constexpr auto min_word = std::size_t{ 4 };
-constexpr auto checksum_offset = std::uint32_t{ 2'166'136'261U };
-constexpr auto checksum_prime = std::uint32_t{ 16'777'619U };
-constexpr auto usage =
-        "usage: wordcount_cpp [--json] [--top N] [--max-word N] <file>";
-
-struct Entry {
-    std::string word;
-    std::uint64_t count;
-};
-
-struct Result {
-    std::uint64_t total;
-    std::size_t unique;
-    std::vector<Entry> top;
-};
-
-struct Options {
-    std::string path;
-    std::size_t top = 10;
-    std::size_t max_word = 1024;
-    std::size_t bench_runs = 0;
-    std::size_t bench_warmups = 0;
-    bool json = false;
-};
+using namespace wordcount;
 
-[[nodiscard]] auto is_letter(unsigned char byte) -> bool
+constexpr auto usage =
+        "usage: wordcount_cpp [--json] [--format text|json|ndjson|tsv] "
+        "[--top N] [--max-word N] "
+        "[--input read|mmap|stream] [--chunk-size N] [--threads N] "
+        "[--engine standard|transparent|compact] [--scan scalar|simd] "
+        "[--encoding ascii|utf8] "
+        "[--select] [--dump FILE] [--merge] [--index FILE] [--approx BYTES] "
+        "[--serve SOCKET] [--stats] [--numa] <path|@list|->...";
+
+[[nodiscard]] auto parse_input(std::string_view text) -> InputMode
 {
-    return (byte >= static_cast<unsigned char>('A') &&
-            byte <= static_cast<unsigned char>('Z')) ||
-           (byte >= static_cast<unsigned char>('a') &&
-            byte <= static_cast<unsigned char>('z'));
+    if (text == "read") {
+        return InputMode::read;
+    }
+    if (text == "mmap") {
+        return InputMode::mmap;
+    }
+    if (text == "stream") {
+        return InputMode::stream;
+    }
+    throw std::invalid_argument{ usage };
 }
 
-[[nodiscard]] auto lower_ascii(unsigned char byte) -> char
+[[nodiscard]] auto parse_engine(std::string_view text) -> Engine
 {
-    if (byte >= static_cast<unsigned char>('A') &&
-        byte <= static_cast<unsigned char>('Z')) {
-        return static_cast<char>(byte + 32U);
+    if (text == "standard") {
+        return Engine::standard;
+    }
+    if (text == "transparent") {
+        return Engine::transparent;
     }
-    return static_cast<char>(byte);
+    if (text == "compact") {
+        return Engine::compact;
+    }
+    throw std::invalid_argument{ usage };
 }
 
-[[nodiscard]] auto parse_size(std::string_view text) -> std::size_t
+[[nodiscard]] auto parse_format(std::string_view text) -> Format
 {
-    if (text.empty()) {
-        throw std::invalid_argument{ "expected numeric option value" };
+    if (text == "text") {
+        return Format::text;
     }
-
-    auto parsed = std::size_t{};
-    const auto *begin = text.data();
-    const auto *end = begin + text.size();
-    const auto [cursor, error] = std::from_chars(begin, end, parsed);
-
-    if (error != std::errc{} || cursor != end) {
-        throw std::invalid_argument{ "expected numeric option value" };
+    if (text == "json") {
+        return Format::json;
+    }
+    if (text == "ndjson") {
+        return Format::ndjson;
+    }
+    if (text == "tsv") {
+        return Format::tsv;
     }
+    throw std::invalid_argument{ usage };
+}
 
-    return parsed;
+[[nodiscard]] auto parse_scan(std::string_view text) -> Scan
+{
+    if (text == "scalar") {
+        return Scan::scalar;
+    }
+    if (text == "simd") {
+        return Scan::simd;
+    }
+    throw std::invalid_argument{ usage };
 }
 
-[[nodiscard]] auto normalize_max_word(std::size_t value) -> std::size_t
+[[nodiscard]] auto parse_encoding(std::string_view text) -> Encoding
 {
-    if (value == 0) {
-        return default_max_word;
+    if (text == "ascii") {
+        return Encoding::ascii;
+    }
+    if (text == "utf8") {
+        return Encoding::utf8;
     }
-    return std::clamp(value, min_word, max_word_limit);
+    throw std::invalid_argument{ usage };
 }
 
 [[nodiscard]] auto parse_args(int argc, char **argv) -> Options
@@ -96,9 +98,77 @@ struct Options {
         const std::string_view arg{ argv[index] };
 
         if (arg == "--json") {
-            options.json = true;
+            options.format = Format::json;
+        } else if (arg == "--format") {
+            if (++index >= argc) {
+                throw std::invalid_argument{ usage };
+            }
+            options.format = parse_format(argv[index]);
+        } else if (arg.starts_with("--format=")) {
+            options.format = parse_format(arg.substr(9));
+        } else if (arg == "--select") {
+            options.select = true;
+        } else if (arg == "--merge") {
+            options.merge = true;
+        } else if (arg == "--stats") {
+            options.stats = true;
+        } else if (arg == "--numa") {
+            options.numa = true;
+        } else if (arg == "--bench-reuse") {
+            options.bench_reuse = true;
+        } else if (arg == "--dump") {
+            if (++index >= argc) {
+                throw std::invalid_argument{ usage };
+            }
+            options.dump = argv[index];
+        } else if (arg.starts_with("--dump=")) {
+            options.dump = std::string{ arg.substr(7) };
+        } else if (arg == "--index") {
+            if (++index >= argc) {
+                throw std::invalid_argument{ usage };
+            }
+            options.index = argv[index];
+        } else if (arg.starts_with("--index=")) {
+            options.index = std::string{ arg.substr(8) };
+        } else if (arg == "--serve") {
+            if (++index >= argc) {
+                throw std::invalid_argument{ usage };
+            }
+            options.serve = argv[index];
+        } else if (arg.starts_with("--serve=")) {
+            options.serve = std::string{ arg.substr(8) };
+        } else if (arg == "--input") {
+            if (++index >= argc) {
+                throw std::invalid_argument{ usage };
+            }
+            options.input = parse_input(argv[index]);
+        } else if (arg.starts_with("--input=")) {
+            options.input = parse_input(arg.substr(8));
+        } else if (arg == "--engine") {
+            if (++index >= argc) {
+                throw std::invalid_argument{ usage };
+            }
+            options.engine = parse_engine(argv[index]);
+        } else if (arg.starts_with("--engine=")) {
+            options.engine = parse_engine(arg.substr(9));
+        } else if (arg == "--scan") {
+            if (++index >= argc) {
+                throw std::invalid_argument{ usage };
+            }
+            options.scan = parse_scan(argv[index]);
+        } else if (arg.starts_with("--scan=")) {
+            options.scan = parse_scan(arg.substr(7));
+        } else if (arg == "--encoding") {
+            if (++index >= argc) {
+                throw std::invalid_argument{ usage };
+            }
+            options.encoding = parse_encoding(argv[index]);
+        } else if (arg.starts_with("--encoding=")) {
+            options.encoding = parse_encoding(arg.substr(11));
         } else if (arg == "--top" || arg == "--max-word" ||
-                   arg == "--bench-runs" || arg == "--bench-warmups") {
+                   arg == "--bench-runs" || arg == "--bench-warmups" ||
+                   arg == "--chunk-size" || arg == "--threads" ||
+                   arg == "--approx") {
             if (++index >= argc) {
                 throw std::invalid_argument{ usage };
             }
@@ -109,6 +179,12 @@ struct Options {
                 options.max_word = value;
             } else if (arg == "--bench-runs") {
                 options.bench_runs = value;
+            } else if (arg == "--chunk-size") {
+                options.chunk_size = value;
+            } else if (arg == "--threads") {
+                options.threads = value;
+            } else if (arg == "--approx") {
+                options.approx = value;
             } else {
                 options.bench_warmups = value;
             }
@@ -120,193 +196,471 @@ struct Options {
             options.bench_runs = parse_size(arg.substr(13));
         } else if (arg.starts_with("--bench-warmups=")) {
             options.bench_warmups = parse_size(arg.substr(16));
-        } else if (options.path.empty() && !arg.starts_with("-")) {
-            options.path = std::string{ arg };
+        } else if (arg.starts_with("--chunk-size=")) {
+            options.chunk_size = parse_size(arg.substr(13));
+        } else if (arg.starts_with("--threads=")) {
+            options.threads = parse_size(arg.substr(10));
+        } else if (arg.starts_with("--approx=")) {
+            options.approx = parse_size(arg.substr(9));
+        } else if (!arg.starts_with("-") || arg == "-") {
+            options.paths.emplace_back(arg);
         } else {
             throw std::invalid_argument{ usage };
         }
     }
 
-    if (options.path.empty() || options.top == 0) {
+    if ((options.paths.empty() && options.serve.empty()) || options.top == 0 ||
+        options.chunk_size == 0) {
+        throw std::invalid_argument{ usage };
+    }
+    if (options.approx > 0 &&
+        (!options.dump.empty() || options.merge || options.bench_runs > 0)) {
+        throw std::invalid_argument{ usage };
+    }
+    if (!options.index.empty() &&
+        (options.approx > 0 || options.merge || options.bench_runs > 0)) {
+        throw std::invalid_argument{ usage };
+    }
+    if (!options.serve.empty() &&
+        (!options.dump.empty() || !options.index.empty() || options.merge ||
+         options.approx > 0 || options.bench_runs > 0)) {
+        throw std::invalid_argument{ usage };
+    }
+    if (options.encoding == Encoding::utf8 &&
+        (!options.serve.empty() || !options.index.empty())) {
+        throw std::invalid_argument{ usage };
+    }
+    if (options.stats &&
+        (!options.serve.empty() || !options.index.empty() || options.merge ||
+         options.approx > 0 || options.bench_runs > 0)) {
+        throw std::invalid_argument{ usage };
+    }
+    if (options.numa &&
+        (!options.serve.empty() || options.merge || options.approx > 0)) {
         throw std::invalid_argument{ usage };
     }
     options.max_word = normalize_max_word(options.max_word);
+    if (options.threads == 0) {
+        options.threads = std::max(1U, std::thread::hardware_concurrency());
+    }
+    if (options.bench_reuse &&
+        (options.bench_runs == 0 || options.threads != 1 || options.numa)) {
+        throw std::invalid_argument{ usage };
+    }
 
     return options;
 }
 
-[[nodiscard]] auto read_file(const std::string &path)
-        -> std::vector<unsigned char>
+constexpr auto output_buffer = std::size_t{ 64 } * 1024U;
+
+class Output
 {
-    std::ifstream file{ path, std::ios::binary | std::ios::ate };
-    if (!file) {
-        throw std::runtime_error{ "cannot open input file" };
+public:
+    void put(std::string_view text)
+    {
+        if (output_buffer - size_ < text.size()) {
+            flush();
+        }
+        if (text.size() > output_buffer) {
+            write(text);
+            return;
+        }
+        std::ranges::copy(text, bytes_.begin() + size_);
+        size_ += text.size();
     }
 
-    const auto size = file.tellg();
-    if (size < 0) {
-        throw std::runtime_error{ "cannot read input file" };
+    void put(std::unsigned_integral auto value)
+    {
+        std::array<char, std::numeric_limits<decltype(value)>::digits10 + 1>
+                digits{};
+        const auto end = std::to_chars(digits.data(),
+                                       digits.data() + digits.size(),
+                                       value)
+                                 .ptr;
+        put({ digits.data(), end });
     }
 
-    std::vector<unsigned char> bytes(static_cast<std::size_t>(size));
-    file.seekg(0);
-    if (!bytes.empty()) {
-        file.read(reinterpret_cast<char *>(bytes.data()),
-                  static_cast<std::streamsize>(bytes.size()));
-        if (!file) {
-            throw std::runtime_error{ "cannot read input file" };
-        }
+    void put(double value)
+    {
+        std::array<char, 32> digits{};
+        const auto end = std::to_chars(digits.data(),
+                                       digits.data() + digits.size(),
+                                       value,
+                                       std::chars_format::fixed,
+                                       6)
+                                 .ptr;
+        put({ digits.data(), end });
     }
 
-    return bytes;
-}
-
-[[nodiscard]] auto
-estimated_unique_words(const std::vector<unsigned char> &bytes) -> std::size_t
-{
-    return bytes.size() / estimated_bytes_per_unique_word;
-}
+    void put_json(std::string_view text)
+    {
+        static constexpr std::string_view hex = "0123456789abcdef";
+        const auto escaped = [](char character) {
+            const auto byte = static_cast<unsigned char>(character);
+            return byte < 0x20U || byte == '"' || byte == '\\';
+        };
+
+        put("\"");
+        for (auto found = std::ranges::find_if(text, escaped);
+             found != text.end();
+             found = std::ranges::find_if(text, escaped)) {
+            const auto byte = static_cast<unsigned char>(*found);
+            const auto at = static_cast<std::size_t>(found - text.begin());
+            put(text.substr(0, at));
+            if (byte == '"' || byte == '\\') {
+                const std::array escape{ '\\', static_cast<char>(byte) };
+                put({ escape.data(), escape.size() });
+            } else {
+                const std::array escape{
+                    '\\', 'u', '0', '0', hex[byte >> 4U], hex[byte & 0xfU]
+                };
+                put({ escape.data(), escape.size() });
+            }
+            text.remove_prefix(at + 1);
+        }
+        put(text);
+        put("\"");
+    }
 
-[[nodiscard]] auto count_words(const std::vector<unsigned char> &bytes,
-                               std::size_t top,
-                               std::size_t max_word) -> Result
-{
-    std::unordered_map<std::string, std::uint64_t> counts;
-    std::string word;
-    std::uint64_t total = 0;
-
-    max_word = normalize_max_word(max_word);
-    counts.reserve(estimated_unique_words(bytes));
-    word.reserve(std::min(max_word, default_max_word));
-
-    for (const auto byte : bytes) {
-        if (is_letter(byte)) {
-            if (word.size() < max_word) {
-                word.push_back(lower_ascii(byte));
+    void put_row(Format format,
+                 std::size_t index,
+                 std::string_view word,
+                 std::uint64_t count,
+                 const std::uint64_t *error)
+    {
+        if (format == Format::text || format == Format::tsv) {
+            const auto *separator = format == Format::text ? " " : "\t";
+            if (format == Format::text) {
+                put(count);
+                put(separator);
+                put(word);
+            } else {
+                put(word);
+                put(separator);
+                put(count);
+            }
+            if (error != nullptr) {
+                put(separator);
+                put(*error);
             }
-            continue;
+            put("\n");
+            return;
         }
 
-        if (!word.empty()) {
-            ++counts[word];
-            ++total;
-            word.clear();
+        put(format == Format::json && index > 0 ? ",{\"word\":"
+                                                : "{\"word\":");
+        put_json(word);
+        put(",\"count\":");
+        put(count);
+        if (error != nullptr) {
+            put(",\"error\":");
+            put(*error);
         }
+        put(format == Format::ndjson ? "}\n" : "}");
     }
 
-    if (!word.empty()) {
-        ++counts[word];
-        ++total;
+    void flush()
+    {
+        write({ bytes_.data(), size_ });
+        size_ = 0;
+        if (std::fflush(stdout) != 0) {
+            throw std::runtime_error{ "cannot write standard output" };
+        }
     }
 
-    std::vector<Entry> entries;
-    entries.reserve(counts.size());
-    for (auto &[entry_word, count] : counts) {
-        entries.push_back({ entry_word, count });
+private:
+    static void write(std::string_view bytes)
+    {
+        if (bytes.empty()) {
+            return;
+        }
+        const auto written =
+                std::fwrite(bytes.data(), 1, bytes.size(), stdout);
+        if (written != bytes.size()) {
+            throw std::runtime_error{ "cannot write standard output" };
+        }
     }
 
-    std::ranges::sort(entries, [](const Entry &left, const Entry &right) {
-        if (left.count != right.count) {
-            return left.count > right.count;
-        }
-        return left.word < right.word;
-    });
+    std::array<char, output_buffer> bytes_{};
+    std::size_t size_ = 0;
+};
+
+void render_result(const Result &result, Format format)
+{
+    const auto output = std::make_unique<Output>();
+    if (format == Format::json) {
+        output->put("{\"total\":");
+        output->put(result.total);
+        output->put(",\"unique\":");
+        output->put(result.unique);
+        output->put(",\"top\":[");
+    } else if (format == Format::text) {
+        output->put("count word\n");
+    } else if (format == Format::tsv) {
+        output->put("word\tcount\n");
+    }
 
-    if (entries.size() > top) {
-        entries.resize(top);
+    for (std::size_t index = 0; index < result.top.size(); ++index) {
+        const auto &entry = result.top[index];
+        output->put_row(format, index, entry.word, entry.count, nullptr);
     }
 
-    return { .total = total,
-             .unique = counts.size(),
-             .top = std::move(entries) };
+    if (format == Format::json) {
+        output->put("]}\n");
+    } else if (format == Format::text) {
+        output->put("total ");
+        output->put(result.total);
+        output->put("\nunique ");
+        output->put(result.unique);
+        output->put("\n");
+    }
+    output->flush();
 }
 
-void render_json(const Result &result)
+void render_approx(const ApproxResult &result, Format format)
 {
-    std::print("{{\"total\":{},\"unique\":{},\"top\":[",
-               result.total,
-               result.unique);
+    const auto output = std::make_unique<Output>();
+    if (format == Format::json) {
+        output->put("{\"total\":");
+        output->put(result.total);
+        output->put(",\"unique\":");
+        output->put(result.unique);
+        output->put(",\"top\":[");
+    } else if (format == Format::text) {
+        output->put("count word error\n");
+    } else if (format == Format::tsv) {
+        output->put("word\tcount\terror\n");
+    }
+
     for (std::size_t index = 0; index < result.top.size(); ++index) {
         const auto &entry = result.top[index];
-        std::print("{}{{\"word\":\"{}\",\"count\":{}}}",
-                   index == 0 ? "" : ",",
-                   entry.word,
-                   entry.count);
+        output->put_row(format, index, entry.word, entry.count, &entry.error);
     }
-    std::println("]}}");
+
+    if (format == Format::json) {
+        output->put("],\"approximate\":{\"counters\":");
+        output->put(result.counters);
+        output->put(",\"max_error\":");
+        output->put(result.max_error);
+        output->put(",\"unique_error\":");
+        output->put(result.unique_error);
+        output->put("}}\n");
+    } else if (format == Format::text) {
+        output->put("total ");
+        output->put(result.total);
+        output->put("\nunique ");
+        output->put(result.unique);
+        output->put("\ncounters ");
+        output->put(result.counters);
+        output->put("\nmax_error ");
+        output->put(result.max_error);
+        output->put("\nunique_error ");
+        output->put(result.unique_error);
+        output->put("\n");
+    }
+    output->flush();
+}
+
+struct Timing {
+    double mean_ms;
+    std::uint32_t checksum;
+};
+
+[[nodiscard]] auto mean_ms(const Options &options,
+                           std::chrono::steady_clock::time_point started)
+        -> double
+{
+    const auto elapsed = std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now() - started);
+    return elapsed.count() / static_cast<double>(options.bench_runs);
 }
 
-void render_text(const Result &result)
+[[nodiscard]] auto time_runs(const Options &options, const auto &count)
+        -> Timing
 {
-    std::println("count word");
-    for (const auto &entry : result.top) {
-        std::println("{} {}", entry.count, entry.word);
+    for (std::size_t index = 0; index < options.bench_warmups; ++index) {
+        (void)checksum(count());
+    }
+
+    auto checksum_value = checksum_offset;
+    const auto started = std::chrono::steady_clock::now();
+    for (std::size_t index = 0; index < options.bench_runs; ++index) {
+        checksum_value = mix_u32(checksum_value, checksum(count()));
     }
-    std::println("total {}\nunique {}", result.total, result.unique);
+    return { .mean_ms = mean_ms(options, started),
+             .checksum = checksum_value };
 }
 
-[[nodiscard]] auto mix_byte(std::uint32_t checksum, unsigned char byte)
-        -> std::uint32_t
+[[nodiscard]] auto time_reused(std::span<const unsigned char> bytes,
+                               const Options &options) -> Timing
 {
-    return (checksum ^ static_cast<std::uint32_t>(byte)) * checksum_prime;
+    auto checksum_value = checksum_offset;
+    auto started = std::chrono::steady_clock::now();
+    (void)recount(bytes,
+                  options,
+                  options.bench_warmups + options.bench_runs,
+                  [&](std::size_t run, const Result &result) {
+                      const auto value = checksum(result);
+                      if (run < options.bench_warmups) {
+                          started = std::chrono::steady_clock::now();
+                          return;
+                      }
+                      checksum_value = mix_u32(checksum_value, value);
+                  });
+    return { .mean_ms = mean_ms(options, started),
+             .checksum = checksum_value };
 }
 
-[[nodiscard]] auto mix_u32(std::uint32_t checksum, std::uint32_t value)
-        -> std::uint32_t
+void render_bench(const Options &options, const auto &count)
 {
-    for (auto index = 0; index < 4; ++index) {
-        checksum =
-                mix_byte(checksum, static_cast<unsigned char>(value & 0xffU));
-        value >>= 8U;
-    }
-    return checksum;
+    const auto timing = time_runs(options, count);
+    std::println("{{\"mean_ms\":{:.6f},\"checksum\":{}}}",
+                 timing.mean_ms,
+                 timing.checksum);
 }
 
-[[nodiscard]] auto mix_u64(std::uint32_t checksum, std::uint64_t value)
-        -> std::uint32_t
+void render_reuse_bench(const std::string &path, const Options &options)
 {
-    for (auto index = 0; index < 8; ++index) {
-        checksum =
-                mix_byte(checksum, static_cast<unsigned char>(value & 0xffU));
-        value >>= 8U;
+    Timing fresh{};
+    Timing reused{};
+    {
+        const Input input{ path, options.input };
+        fresh = time_runs(
+                options, [&] { return count_bytes(input.bytes(), options); });
+        reused = time_reused(input.bytes(), options);
     }
-    return checksum;
+
+    std::optional<Timing> cold;
+    if (!is_sequential(path) && evict_file(path)) {
+        cold = time_runs(options, [&] {
+            (void)evict_file(path);
+            const Input input{ path, options.input };
+            return count_bytes(input.bytes(), options);
+        });
+    }
+    if (reused.checksum != fresh.checksum ||
+        (cold && cold->checksum != fresh.checksum)) {
+        throw std::runtime_error{ "bench checksum mismatch" };
+    }
+
+    std::print("{{\"mean_ms\":{:.6f},\"reuse_ms\":{:.6f},",
+               fresh.mean_ms,
+               reused.mean_ms);
+    if (cold) {
+        std::print("\"cold_ms\":{:.6f},", cold->mean_ms);
+    } else {
+        std::print("\"cold_ms\":null,");
+    }
+    std::println("\"checksum\":{}}}", fresh.checksum);
 }
 
-[[nodiscard]] auto checksum(const Result &result) -> std::uint32_t
+struct Phases {
+    std::chrono::steady_clock::time_point started =
+            std::chrono::steady_clock::now();
+    std::optional<std::uint64_t> read_ns;
+};
+
+[[nodiscard]] auto engine_name(Engine engine) -> std::string_view
 {
-    auto value = checksum_offset;
-    value = mix_u64(value, result.total);
-    value = mix_u64(value, static_cast<std::uint64_t>(result.unique));
-    for (const auto &entry : result.top) {
-        for (const auto byte : entry.word) {
-            value = mix_byte(value, static_cast<unsigned char>(byte));
-        }
-        value = mix_u64(value, entry.count);
+    if (engine == Engine::compact) {
+        return "compact";
     }
-    return value;
+    if (engine == Engine::transparent) {
+        return "transparent";
+    }
+    return "standard";
 }
 
-void render_bench(const std::vector<unsigned char> &bytes,
-                  const Options &options)
+void render_stats(const Result &result,
+                  const Options &options,
+                  const Phases &phases,
+                  std::uint64_t count_ns,
+                  std::uint64_t output_ns)
 {
-    for (std::size_t index = 0; index < options.bench_warmups; ++index) {
-        (void)checksum(count_words(bytes, options.top, options.max_word));
+    const auto &stats = result.stats;
+    const auto rank = std::min(stats.rank_ns, count_ns);
+    const auto lookups = stats.inserts + stats.hits;
+
+    std::print(stderr,
+               "{{\"engine\":\"cpp-{}\",\"tokens\":{},\"unique\":{},",
+               engine_name(options.engine),
+               result.total,
+               result.unique);
+    if constexpr (record_stats) {
+        std::print(stderr,
+                   "\"inserts\":{},\"hits\":{},",
+                   stats.inserts,
+                   stats.hits);
+    } else {
+        std::print(stderr, "\"inserts\":null,\"hits\":null,");
+    }
+    if (stats.max_probe > 0) {
+        std::print(stderr,
+                   "\"probe_mean\":{:.3f},\"probe_max\":{},",
+                   static_cast<double>(stats.probes) /
+                           static_cast<double>(lookups),
+                   stats.max_probe);
+    } else {
+        std::print(stderr, "\"probe_mean\":null,\"probe_max\":null,");
+    }
+    std::print(stderr,
+               "\"resizes\":{},\"capacity\":{},\"load_factor\":{:.3f},",
+               stats.resizes,
+               stats.capacity,
+               stats.capacity == 0 ? 0.0
+                                   : static_cast<double>(result.unique) /
+                                             static_cast<double>(
+                                                     stats.capacity));
+    if (options.engine == Engine::compact) {
+        std::print(stderr, "\"max_bucket\":null,");
+    } else {
+        std::print(stderr, "\"max_bucket\":{},", stats.max_bucket);
     }
+    std::print(stderr, "\"table_bytes\":{},", stats.table_bytes);
+    if (options.numa) {
+        std::print(stderr, "\"nodes\":[");
+        for (const auto &node : stats.nodes) {
+            std::print(stderr,
+                       "{}{{\"node\":{},\"workers\":{},\"bytes\":{},"
+                       "\"count_ns\":{},\"bytes_per_s\":{:.0f}}}",
+                       &node == stats.nodes.data() ? "" : ",",
+                       node.node,
+                       node.workers,
+                       node.bytes,
+                       node.count_ns,
+                       node.count_ns == 0
+                               ? 0.0
+                               : static_cast<double>(node.bytes) * 1e9 /
+                                         static_cast<double>(node.count_ns));
+        }
+        std::print(stderr, "],");
+    }
+    std::print(stderr, "\"phases_ns\":{{");
+    if (phases.read_ns) {
+        std::print(stderr, "\"read\":{},", *phases.read_ns);
+    } else {
+        std::print(stderr, "\"read\":null,");
+    }
+    std::println(stderr,
+                 "\"count\":{},\"rank\":{},\"output\":{}}}}}",
+                 count_ns - rank,
+                 rank,
+                 output_ns);
+}
 
-    auto checksum_value = checksum_offset;
+void render(Result result, const Options &options, const Phases &phases)
+{
+    const auto count_ns = elapsed_ns(phases.started);
     const auto started = std::chrono::steady_clock::now();
-    for (std::size_t index = 0; index < options.bench_runs; ++index) {
-        checksum_value = mix_u32(
-                checksum_value,
-                checksum(count_words(bytes, options.top, options.max_word)));
+    if (!options.dump.empty()) {
+        write_dump(options.dump, result);
+        result.top.resize(std::min(result.top.size(), options.top));
+    }
+    render_result(result, options.format);
+    if (options.stats) {
+        render_stats(
+                result, options, phases, count_ns, elapsed_ns(started));
     }
-    const auto elapsed = std::chrono::duration<double, std::milli>(
-            std::chrono::steady_clock::now() - started);
-
-    std::println("{{\"mean_ms\":{:.6f},\"checksum\":{}}}",
-                 elapsed.count() / static_cast<double>(options.bench_runs),
-                 checksum_value);
 }
 
 }  // namespace
@@ -315,14 +669,72 @@ auto main(int argc, char **argv) -> int
 {
     try {
         const auto options = parse_args(argc, argv);
-        const auto bytes = read_file(options.path);
+        Phases phases;
+        const auto paths = expand_paths(options.paths);
+        auto counting = options;
+        if (!options.dump.empty()) {
+            counting.top = std::numeric_limits<std::size_t>::max();
+        }
+
+        if (!options.serve.empty()) {
+            serve(paths, options);
+            return 0;
+        }
+        if (options.approx > 0) {
+            render_approx(approximate(paths, options), options.format);
+            return 0;
+        }
+        if (options.merge) {
+            render(merge_dumps(paths, counting), options, phases);
+            return 0;
+        }
+        if (!options.index.empty()) {
+            if (paths.size() != 1 || paths.front() == "-") {
+                throw std::invalid_argument{ usage };
+            }
+            render(count_indexed(paths.front(), counting), options, phases);
+            return 0;
+        }
+        if (paths.size() != 1) {
+            if (options.bench_reuse) {
+                throw std::invalid_argument{ usage };
+            }
+            if (options.bench_runs > 0) {
+                render_bench(options,
+                             [&] { return count_files(paths, options); });
+                return 0;
+            }
+            render(count_files(paths, counting), options, phases);
+            return 0;
+        }
+
+        const auto &path = paths.front();
+        if (options.bench_reuse) {
+            render_reuse_bench(path, options);
+            return 0;
+        }
+        if ((options.input == InputMode::stream || is_sequential(path)) &&
+            options.bench_runs == 0) {
+            render(stream_file(path, counting), options, phases);
+            return 0;
+        }
+
+        const Input input{ path,
+                           options.input,
+                           options.numa ? options.threads : 0,
+                           options.encoding };
+        phases.read_ns = elapsed_ns(phases.started);
+        phases.started = std::chrono::steady_clock::now();
         if (options.bench_runs > 0) {
-            render_bench(bytes, options);
+            render_bench(options, [&] {
+                return count_bytes(input.bytes(), options, input.bounds());
+            });
             return 0;
         }
 
-        const auto result = count_words(bytes, options.top, options.max_word);
-        options.json ? render_json(result) : render_text(result);
+        render(count_bytes(input.bytes(), counting, input.bounds()),
+               options,
+               phases);
         return 0;
     } catch (const std::exception &error) {
         (void)std::fprintf(stderr, "wordcount_cpp: %s\n", error.what());
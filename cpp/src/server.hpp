@@ -0,0 +1,451 @@
+#ifndef WORDCOUNT_SERVER_HPP
+#define WORDCOUNT_SERVER_HPP
+
+#include "wordcount.hpp"
+
+#include <csignal>
+
+#if !defined(_WIN32)
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#endif
+
+namespace wordcount
+{
+
+constexpr auto serve_buffer = std::size_t{ 64 } * 1024U;
+constexpr auto max_command = std::size_t{ 4096 };
+
+#if defined(_WIN32)
+inline void serve(const std::vector<std::string> & /*paths*/,
+                  const Options & /*options*/)
+{
+    throw std::runtime_error{ "--serve needs Unix domain sockets" };
+}
+#else
+inline volatile std::sig_atomic_t serve_stopped = 0;
+
+extern "C" inline void stop_serving(int /*signal*/)
+{
+    serve_stopped = 1;
+}
+
+[[nodiscard]] inline auto socket_address(const std::string &path)
+        -> sockaddr_un
+{
+    sockaddr_un address{};
+    if (path.size() >= sizeof(address.sun_path)) {
+        throw std::runtime_error{ "socket path is too long" };
+    }
+    address.sun_family = AF_UNIX;
+    std::ranges::copy(path, address.sun_path);
+    return address;
+}
+
+[[nodiscard]] inline auto socket_in_use(const sockaddr_un &address) -> bool
+{
+    const auto probe = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (probe < 0) {
+        return false;
+    }
+    const auto connected =
+            ::connect(probe,
+                      reinterpret_cast<const sockaddr *>(&address),
+                      sizeof(address)) == 0;
+    (void)::close(probe);
+    return connected;
+}
+
+[[nodiscard]] inline auto listen_on(const std::string &path) -> int
+{
+    const auto address = socket_address(path);
+    struct stat info {};
+    if (::lstat(path.c_str(), &info) == 0) {
+        if (!S_ISSOCK(info.st_mode) || socket_in_use(address)) {
+            throw std::runtime_error{ "socket path is in use" };
+        }
+        (void)::unlink(path.c_str());
+    }
+
+    const auto fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        throw std::runtime_error{ "cannot create socket" };
+    }
+    if (::bind(fd,
+               reinterpret_cast<const sockaddr *>(&address),
+               sizeof(address)) != 0 ||
+        ::listen(fd, SOMAXCONN) != 0 ||
+        ::fcntl(fd, F_SETFL, O_NONBLOCK) != 0) {
+        (void)::close(fd);
+        throw std::runtime_error{ "cannot listen on socket" };
+    }
+    return fd;
+}
+
+template <typename Map>
+class Server
+{
+public:
+    Server(const std::string &path, const Options &options)
+        : path_{ path },
+          listener_{ listen_on(path) },
+          counter_{ options.max_word, 0, classifier(options.scan) },
+          leaders_{ options.top },
+          max_word_{ normalize_max_word(options.max_word) },
+          top_{ options.top }
+    {
+        counter_.track(leaders_);
+    }
+
+    Server(const Server &) = delete;
+    Server(Server &&) = delete;
+    auto operator=(const Server &) -> Server & = delete;
+    auto operator=(Server &&) -> Server & = delete;
+
+    ~Server()
+    {
+        for (const auto &client : clients_) {
+            (void)::close(client.fd);
+        }
+        (void)::close(listener_);
+        (void)::unlink(path_.c_str());
+    }
+
+    void preload(const std::vector<std::string> &paths, const Options &options)
+    {
+        for (const auto &path : paths) {
+            count_file(counter_, path, options);
+        }
+    }
+
+    void run()
+    {
+        std::vector<unsigned char> buffer(serve_buffer);
+        std::vector<pollfd> watched;
+        while (!(stopping_ && clients_.empty()) && serve_stopped == 0) {
+            watched.assign(1,
+                           { .fd = listener_,
+                             .events = static_cast<short>(
+                                     stopping_ ? 0 : POLLIN),
+                             .revents = 0 });
+            for (const auto &client : clients_) {
+                const auto reading = client.closing ? 0 : POLLIN;
+                const auto writing = client.out.empty() ? 0 : POLLOUT;
+                watched.push_back(
+                        { .fd = client.fd,
+                          .events = static_cast<short>(reading | writing),
+                          .revents = 0 });
+            }
+
+            if (::poll(watched.data(), watched.size(), -1) < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                throw std::runtime_error{ "cannot poll sockets" };
+            }
+
+            for (std::size_t index = 0; index < clients_.size(); ++index) {
+                serve_client(clients_[index], watched[index + 1], buffer);
+            }
+            if (stopping_) {
+                for (auto &client : clients_) {
+                    client.closing = true;
+                }
+            }
+            std::erase_if(clients_, [](const Client &client) {
+                if (client.failed || (client.closing && client.out.empty())) {
+                    (void)::close(client.fd);
+                    return true;
+                }
+                return false;
+            });
+            if (!stopping_ && (watched.front().revents & POLLIN) != 0) {
+                accept_clients();
+            }
+        }
+    }
+
+private:
+    struct Client {
+        int fd = -1;
+        std::string in;
+        std::string out;
+        std::string pending;
+        std::uint64_t remaining = 0;
+        std::uint64_t ingested = 0;
+        bool ingesting = false;
+        bool until_eof = false;
+        bool closing = false;
+        bool failed = false;
+    };
+
+    void accept_clients()
+    {
+        for (;;) {
+            const auto fd = ::accept(listener_, nullptr, nullptr);
+            if (fd < 0) {
+                return;
+            }
+            if (::fcntl(fd, F_SETFL, O_NONBLOCK) != 0) {
+                (void)::close(fd);
+                continue;
+            }
+            clients_.emplace_back().fd = fd;
+        }
+    }
+
+    void serve_client(Client &client,
+                      const pollfd &watched,
+                      std::vector<unsigned char> &buffer)
+    {
+        if ((watched.revents & (POLLIN | POLLHUP | POLLERR)) != 0 &&
+            !client.closing) {
+            const auto got = ::read(client.fd, buffer.data(), buffer.size());
+            if (got > 0) {
+                receive(client,
+                        std::span{ buffer }.first(
+                                static_cast<std::size_t>(got)));
+            } else if (got == 0) {
+                if (client.ingesting) {
+                    finish_document(client);
+                }
+                client.closing = true;
+            } else if (errno != EAGAIN && errno != EWOULDBLOCK &&
+                       errno != EINTR) {
+                client.failed = true;
+            }
+        }
+
+        if (!client.out.empty() && !client.failed) {
+            const auto sent =
+                    ::write(client.fd, client.out.data(), client.out.size());
+            if (sent > 0) {
+                client.out.erase(0, static_cast<std::size_t>(sent));
+            } else if (sent < 0 && errno != EAGAIN && errno != EWOULDBLOCK &&
+                       errno != EINTR) {
+                client.failed = true;
+            }
+        }
+    }
+
+    void receive(Client &client, std::span<const unsigned char> bytes)
+    {
+        while (!bytes.empty() && !client.closing) {
+            if (client.ingesting) {
+                if (client.until_eof) {
+                    ingest(client, bytes);
+                    return;
+                }
+                const auto take = static_cast<std::size_t>(
+                        std::min<std::uint64_t>(client.remaining,
+                                                bytes.size()));
+                ingest(client, bytes.first(take));
+                bytes = bytes.subspan(take);
+                client.remaining -= take;
+                if (client.remaining == 0) {
+                    finish_document(client);
+                }
+                continue;
+            }
+
+            const auto newline = std::ranges::find(bytes, '\n');
+            const auto line = static_cast<std::size_t>(newline - bytes.begin());
+            client.in.append(reinterpret_cast<const char *>(bytes.data()),
+                             line);
+            if (newline == bytes.end()) {
+                if (client.in.size() > max_command) {
+                    reply(client, R"({"error":"command too long"})");
+                    client.closing = true;
+                }
+                return;
+            }
+            bytes = bytes.subspan(line + 1);
+
+            if (client.in.ends_with('\r')) {
+                client.in.pop_back();
+            }
+            const auto command = std::move(client.in);
+            client.in.clear();
+            execute(client, command);
+        }
+    }
+
+    void execute(Client &client, std::string_view line)
+    {
+        const auto space = line.find(' ');
+        const auto command = line.substr(0, space);
+        const auto argument =
+                space == std::string_view::npos ? "" : line.substr(space + 1);
+
+        if (command == "ingest") {
+            client.ingesting = true;
+            client.until_eof = argument.empty();
+            client.ingested = 0;
+            if (!argument.empty() &&
+                !parse_argument(client, argument, client.remaining)) {
+                client.ingesting = false;
+            } else if (!client.until_eof && client.remaining == 0) {
+                finish_document(client);
+            }
+        } else if (command == "top") {
+            auto top = top_;
+            if (argument.empty() || parse_argument(client, argument, top)) {
+                if (top > leaders_.capacity()) {
+                    leaders_.reset(top);
+                    counter_.track(leaders_);
+                }
+                reply_top(client,
+                          { .total = counter_.total(),
+                            .unique = counter_.unique(),
+                            .top = leaders_.top(top) });
+            }
+        } else if (command == "count") {
+            reply_count(client, argument);
+        } else if (command == "stats") {
+            reply(client,
+                  "{\"total\":" + std::to_string(counter_.total()) +
+                          ",\"unique\":" + std::to_string(counter_.unique()) +
+                          ",\"documents\":" + std::to_string(documents_) +
+                          ",\"bytes\":" + std::to_string(bytes_) +
+                          ",\"clients\":" + std::to_string(clients_.size()) +
+                          "}");
+        } else if (command == "quit") {
+            client.closing = true;
+        } else if (command == "shutdown") {
+            client.closing = true;
+            stopping_ = true;
+        } else if (!command.empty()) {
+            reply(client, R"({"error":"unknown command"})");
+        }
+    }
+
+    [[nodiscard]] static auto
+    parse_argument(Client &client, std::string_view text, auto &out) -> bool
+    {
+        const auto *end = text.data() + text.size();
+        const auto parsed = std::from_chars(text.data(), end, out);
+        if (parsed.ec != std::errc{} || parsed.ptr != end) {
+            reply(client, R"({"error":"invalid number"})");
+            return false;
+        }
+        return true;
+    }
+
+    void ingest(Client &client, std::span<const unsigned char> bytes)
+    {
+        client.ingested += bytes.size();
+        bytes_ += bytes.size();
+
+        const auto last = std::ranges::find_if_not(
+                bytes.rbegin(), bytes.rend(), is_letter);
+        const auto cut = static_cast<std::size_t>(bytes.rend() - last);
+        if (cut > 0) {
+            counter_.feed({ reinterpret_cast<const unsigned char *>(
+                                    client.pending.data()),
+                            client.pending.size() });
+            counter_.feed(bytes.first(cut));
+            client.pending.clear();
+        }
+
+        const auto word = bytes.subspan(cut);
+        client.pending.append(
+                reinterpret_cast<const char *>(word.data()),
+                std::min(word.size(), max_word_ - client.pending.size()));
+    }
+
+    void finish_document(Client &client)
+    {
+        counter_.feed({ reinterpret_cast<const unsigned char *>(
+                                client.pending.data()),
+                        client.pending.size() });
+        counter_.end_word();
+        client.pending.clear();
+        client.ingesting = false;
+        ++documents_;
+        reply(client,
+              "{\"bytes\":" + std::to_string(client.ingested) +
+                      ",\"total\":" + std::to_string(counter_.total()) +
+                      ",\"unique\":" + std::to_string(counter_.unique()) +
+                      "}");
+    }
+
+    void reply_count(Client &client, std::string_view word)
+    {
+        if (word.empty() || !std::ranges::all_of(word, [](char byte) {
+                return is_letter(static_cast<unsigned char>(byte));
+            })) {
+            reply(client, R"({"error":"invalid word"})");
+            return;
+        }
+
+        std::string folded;
+        for (const auto byte : word.substr(0, max_word_)) {
+            folded.push_back(lower_ascii(static_cast<unsigned char>(byte)));
+        }
+        const auto count = counter_.count(folded);
+        reply(client,
+              "{\"word\":\"" + folded +
+                      "\",\"count\":" + std::to_string(count) + "}");
+    }
+
+    static void reply_top(Client &client, const Result &result)
+    {
+        auto &out = client.out;
+        out += "{\"total\":" + std::to_string(result.total) +
+               ",\"unique\":" + std::to_string(result.unique) + ",\"top\":[";
+        for (std::size_t index = 0; index < result.top.size(); ++index) {
+            const auto &entry = result.top[index];
+            out += index > 0 ? ",{\"word\":\"" : "{\"word\":\"";
+            out += entry.word;
+            out += "\",\"count\":" + std::to_string(entry.count) + "}";
+        }
+        out += "]}\n";
+    }
+
+    static void reply(Client &client, std::string_view line)
+    {
+        client.out += line;
+        client.out += '\n';
+    }
+
+    std::string path_;
+    int listener_;
+    Counter<Map> counter_;
+    Leaders leaders_;
+    std::size_t max_word_;
+    std::size_t top_;
+    std::vector<Client> clients_;
+    std::uint64_t documents_ = 0;
+    std::uint64_t bytes_ = 0;
+    bool stopping_ = false;
+};
+
+template <typename Map>
+void serve_with(const std::vector<std::string> &paths, const Options &options)
+{
+    (void)std::signal(SIGPIPE, SIG_IGN);
+    (void)std::signal(SIGINT, stop_serving);
+    (void)std::signal(SIGTERM, stop_serving);
+
+    Server<Map> server{ options.serve, options };
+    server.preload(paths, options);
+    server.run();
+}
+
+inline void serve(const std::vector<std::string> &paths,
+                  const Options &options)
+{
+    if (options.engine == Engine::compact) {
+        serve_with<CompactTable>(paths, options);
+    } else if (options.engine == Engine::transparent) {
+        serve_with<TransparentMap>(paths, options);
+    } else {
+        serve_with<StandardMap>(paths, options);
+    }
+}
+#endif
+
+}  // namespace wordcount
+
+#endif
@@ -0,0 +1,3961 @@
+#ifndef WORDCOUNT_HPP
+#define WORDCOUNT_HPP
+
+#include "unicode.hpp"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <concepts>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#if defined(_WIN32)
+#include <fcntl.h>
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#if defined(__linux__)
+#include <sched.h>
+#endif
+
+#if defined(WFC_ZLIB)
+#include <zlib.h>
+#endif
+#if defined(WFC_ZSTD)
+#include <zstd.h>
+#endif
+
+#if defined(__x86_64__) || defined(_M_X64)
+#include <emmintrin.h>
+#define SCAN_SSE2 1
+#if defined(__GNUC__)
+#include <immintrin.h>
+#define SCAN_AVX2 1
+#endif
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#include <arm_neon.h>
+#define SCAN_NEON 1
+#endif
+
+namespace wordcount
+{
+
+constexpr auto default_chunk_size = std::size_t{ 1 } << 20U;
+constexpr auto default_max_word = std::size_t{ 64 };
+constexpr auto estimated_bytes_per_unique_word = std::size_t{ 32 };
+constexpr auto max_word_limit = std::size_t{ 1024 };
+constexpr auto min_word = std::size_t{ 4 };
+constexpr auto min_sort_run = std::size_t{ 16 } * 1024U;
+constexpr auto min_thread_slice = std::size_t{ 64 } * 1024U;
+constexpr auto sample_chunk = std::size_t{ 16 } * 1024U;
+constexpr auto sample_chunks = std::size_t{ 16 };
+constexpr auto sample_register_bits = std::size_t{ 12 };
+constexpr auto scan_block = std::size_t{ 64 };
+constexpr auto source_buffer = std::size_t{ 1 } << 16U;
+constexpr auto checksum_offset = std::uint32_t{ 2'166'136'261U };
+constexpr auto checksum_prime = std::uint32_t{ 16'777'619U };
+constexpr std::string_view dump_magic{ "WFD1" };
+constexpr std::string_view index_magic{ "WFX1" };
+constexpr auto index_fields = std::size_t{ 6 };
+constexpr auto index_header = index_magic.size() + index_fields * 8U;
+struct Entry {
+    std::string word;
+    std::uint64_t count;
+};
+
+#if defined(WFC_STATS)
+constexpr auto record_stats = true;
+#else
+constexpr auto record_stats = false;
+#endif
+
+struct NodeStats {
+    std::size_t node;
+    std::size_t workers;
+    std::uint64_t bytes;
+    std::uint64_t count_ns;
+};
+
+struct Stats {
+    std::uint64_t inserts = 0;
+    std::uint64_t hits = 0;
+    std::uint64_t probes = 0;
+    std::uint64_t max_probe = 0;
+    std::size_t resizes = 0;
+    std::size_t capacity = 0;
+    std::size_t max_bucket = 0;
+    std::size_t table_bytes = 0;
+    std::uint64_t rank_ns = 0;
+    std::vector<NodeStats> nodes;
+};
+
+struct Result {
+    std::uint64_t total;
+    std::size_t unique;
+    std::vector<Entry> top;
+    Stats stats{};
+};
+
+struct FileIdentity {
+    std::uint64_t device;
+    std::uint64_t inode;
+    std::uint64_t mtime;
+    std::uint64_t size;
+};
+
+struct ApproxEntry {
+    std::string word;
+    std::uint64_t count;
+    std::uint64_t error;
+};
+
+struct ApproxResult {
+    std::uint64_t total;
+    std::uint64_t unique;
+    std::vector<ApproxEntry> top;
+    std::size_t counters;
+    std::uint64_t max_error;
+    double unique_error;
+};
+
+enum class InputMode : std::uint8_t { read, mmap, stream };
+
+enum class Engine : std::uint8_t { standard, transparent, compact };
+
+enum class Scan : std::uint8_t { scalar, simd };
+
+enum class Format : std::uint8_t { text, json, ndjson, tsv };
+
+enum class Encoding : std::uint8_t { ascii, utf8 };
+
+enum class Codec : std::uint8_t { raw, gzip, zstd };
+
+struct Options {
+    std::vector<std::string> paths;
+    std::size_t top = 10;
+    std::size_t max_word = 1024;
+    std::size_t bench_runs = 0;
+    std::size_t bench_warmups = 0;
+    std::size_t chunk_size = default_chunk_size;
+    std::size_t threads = 1;
+    std::size_t approx = 0;
+    InputMode input = InputMode::read;
+    Engine engine = Engine::standard;
+    Scan scan = Scan::scalar;
+    Format format = Format::text;
+    Encoding encoding = Encoding::ascii;
+    std::string dump;
+    std::string index;
+    std::string serve;
+    bool select = false;
+    bool merge = false;
+    bool stats = false;
+    bool numa = false;
+    bool bench_reuse = false;
+};
+
+[[nodiscard]] inline auto is_letter(unsigned char byte) -> bool
+{
+    return (byte >= static_cast<unsigned char>('A') &&
+            byte <= static_cast<unsigned char>('Z')) ||
+           (byte >= static_cast<unsigned char>('a') &&
+            byte <= static_cast<unsigned char>('z'));
+}
+
+[[nodiscard]] inline auto lower_ascii(unsigned char byte) -> char
+{
+    if (byte >= static_cast<unsigned char>('A') &&
+        byte <= static_cast<unsigned char>('Z')) {
+        return static_cast<char>(byte + 32U);
+    }
+    return static_cast<char>(byte);
+}
+
+[[nodiscard]] inline auto parse_size(std::string_view text) -> std::size_t
+{
+    if (text.empty()) {
+        throw std::invalid_argument{ "expected numeric option value" };
+    }
+
+    auto parsed = std::size_t{};
+    const auto *begin = text.data();
+    const auto *end = begin + text.size();
+    const auto [cursor, error] = std::from_chars(begin, end, parsed);
+
+    if (error != std::errc{} || cursor != end) {
+        throw std::invalid_argument{ "expected numeric option value" };
+    }
+
+    return parsed;
+}
+
+[[nodiscard]] inline auto normalize_max_word(std::size_t value) -> std::size_t
+{
+    if (value == 0) {
+        return default_max_word;
+    }
+    return std::clamp(value, min_word, max_word_limit);
+}
+
+[[nodiscard]] inline auto is_pipe(const std::string &path) -> bool
+{
+    if (path == "-") {
+        return true;
+    }
+
+    std::error_code error;
+    const auto status = std::filesystem::status(path, error);
+    return !error && !std::filesystem::is_regular_file(status) &&
+           !std::filesystem::is_directory(status);
+}
+
+class InputStream
+{
+public:
+    explicit InputStream(const std::string &path)
+    {
+        if (path != "-") {
+            file_.open(path, std::ios::binary);
+            stream_ = &file_;
+            return;
+        }
+#if defined(_WIN32)
+        (void)::_setmode(::_fileno(stdin), _O_BINARY);
+#endif
+    }
+
+    [[nodiscard]] auto stream() -> std::istream &
+    {
+        return *stream_;
+    }
+
+    [[nodiscard]] auto read(std::span<unsigned char> buffer) -> std::size_t
+    {
+        stream_->read(reinterpret_cast<char *>(buffer.data()),
+                      static_cast<std::streamsize>(buffer.size()));
+        return static_cast<std::size_t>(stream_->gcount());
+    }
+
+private:
+    std::ifstream file_;
+    std::istream *stream_ = &std::cin;
+};
+
+[[nodiscard]] inline auto detect_codec(std::span<const unsigned char> magic)
+        -> Codec
+{
+    if (magic.size() >= 2 && magic[0] == 0x1fU && magic[1] == 0x8bU) {
+        return Codec::gzip;
+    }
+    if (magic.size() >= 4 && magic[0] == 0x28U && magic[1] == 0xb5U &&
+        magic[2] == 0x2fU && magic[3] == 0xfdU) {
+        return Codec::zstd;
+    }
+    return Codec::raw;
+}
+
+[[nodiscard]] inline auto is_compressed(const std::string &path) -> bool
+{
+    std::ifstream file{ path, std::ios::binary };
+    std::array<unsigned char, 4> magic{};
+    file.read(reinterpret_cast<char *>(magic.data()), magic.size());
+    return detect_codec(std::span{ magic }.first(
+                   static_cast<std::size_t>(file.gcount()))) != Codec::raw;
+}
+
+[[nodiscard]] inline auto is_sequential(const std::string &path) -> bool
+{
+    return is_pipe(path) || is_compressed(path);
+}
+
+class Source
+{
+public:
+    explicit Source(const std::string &path)
+        : input_{ path }, in_(source_buffer)
+    {
+        if (!input_.stream()) {
+            throw std::runtime_error{ "cannot open input file" };
+        }
+        in_len_ = input_.read(std::span{ in_ }.first(4));
+        check_input();
+
+        codec_ = detect_codec(std::span{ in_ }.first(in_len_));
+        if (codec_ == Codec::gzip) {
+#if defined(WFC_ZLIB)
+            if (::inflateInit2(&gzip_, 15 + 16) != Z_OK) {
+                throw std::bad_alloc{};
+            }
+#else
+            throw std::runtime_error{ "compression format not supported" };
+#endif
+        } else if (codec_ == Codec::zstd) {
+#if defined(WFC_ZSTD)
+            zstd_ = ::ZSTD_createDCtx();
+            if (zstd_ == nullptr) {
+                throw std::bad_alloc{};
+            }
+#else
+            throw std::runtime_error{ "compression format not supported" };
+#endif
+        }
+    }
+
+    Source(const Source &) = delete;
+    Source(Source &&) = delete;
+    auto operator=(const Source &) -> Source & = delete;
+    auto operator=(Source &&) -> Source & = delete;
+
+    ~Source()
+    {
+#if defined(WFC_ZLIB)
+        if (codec_ == Codec::gzip) {
+            (void)::inflateEnd(&gzip_);
+        }
+#endif
+#if defined(WFC_ZSTD)
+        (void)::ZSTD_freeDCtx(zstd_);
+#endif
+    }
+
+    [[nodiscard]] auto read(std::span<unsigned char> out) -> std::size_t
+    {
+        switch (codec_) {
+#if defined(WFC_ZLIB)
+        case Codec::gzip:
+            return inflate_into(out);
+#endif
+#if defined(WFC_ZSTD)
+        case Codec::zstd:
+            return zstd_into(out);
+#endif
+        default:
+            return copy_raw(out);
+        }
+    }
+
+private:
+    void check_input()
+    {
+        if (input_.stream().bad()) {
+            throw std::runtime_error{ "cannot read input file" };
+        }
+        drained_ = !input_.stream();
+    }
+
+    [[nodiscard]] auto fill() -> bool
+    {
+        if (in_pos_ < in_len_) {
+            return true;
+        }
+        if (drained_) {
+            return false;
+        }
+
+        in_pos_ = 0;
+        in_len_ = input_.read(in_);
+        check_input();
+        return in_len_ > 0;
+    }
+
+    [[nodiscard]] auto copy_raw(std::span<unsigned char> out) -> std::size_t
+    {
+        const auto buffered = std::min(in_len_ - in_pos_, out.size());
+        std::memcpy(out.data(), in_.data() + in_pos_, buffered);
+        in_pos_ += buffered;
+        if (buffered == out.size() || drained_) {
+            return buffered;
+        }
+
+        const auto got = input_.read(out.subspan(buffered));
+        check_input();
+        return buffered + got;
+    }
+
+#if defined(WFC_ZLIB)
+    [[nodiscard]] auto inflate_into(std::span<unsigned char> out)
+            -> std::size_t
+    {
+        gzip_.next_out = out.data();
+        gzip_.avail_out = static_cast<uInt>(
+                std::min<std::size_t>(out.size(), ~uInt{}));
+
+        while (gzip_.avail_out > 0) {
+            const auto more = fill();
+            if (!more && finished_) {
+                break;
+            }
+            if (more && finished_) {
+                if (::inflateReset(&gzip_) != Z_OK) {
+                    throw std::runtime_error{ "corrupt compressed data" };
+                }
+                finished_ = false;
+            }
+
+            gzip_.next_in = in_.data() + in_pos_;
+            gzip_.avail_in = static_cast<uInt>(in_len_ - in_pos_);
+            const auto status = ::inflate(&gzip_, Z_NO_FLUSH);
+            in_pos_ = in_len_ - gzip_.avail_in;
+            if (status == Z_STREAM_END) {
+                finished_ = true;
+            } else if (status != Z_OK) {
+                throw std::runtime_error{ "corrupt compressed data" };
+            }
+        }
+        return static_cast<std::size_t>(gzip_.next_out - out.data());
+    }
+
+    z_stream gzip_{};
+#endif
+
+#if defined(WFC_ZSTD)
+    [[nodiscard]] auto zstd_into(std::span<unsigned char> out) -> std::size_t
+    {
+        ZSTD_outBuffer output{ .dst = out.data(),
+                               .size = out.size(),
+                               .pos = 0 };
+        while (output.pos < output.size) {
+            const auto more = fill();
+            if (!more && finished_) {
+                break;
+            }
+
+            ZSTD_inBuffer input{ .src = in_.data(),
+                                 .size = in_len_,
+                                 .pos = in_pos_ };
+            const auto before = output.pos;
+            const auto status =
+                    ::ZSTD_decompressStream(zstd_, &output, &input);
+            in_pos_ = input.pos;
+            if (::ZSTD_isError(status) != 0U ||
+                (!more && status != 0 && output.pos == before)) {
+                throw std::runtime_error{ "corrupt compressed data" };
+            }
+            finished_ = status == 0;
+        }
+        return output.pos;
+    }
+
+    ZSTD_DCtx *zstd_ = nullptr;
+#endif
+
+    InputStream input_;
+    std::vector<unsigned char> in_;
+    std::size_t in_len_ = 0;
+    std::size_t in_pos_ = 0;
+    Codec codec_ = Codec::raw;
+    bool drained_ = false;
+    bool finished_ = false;
+};
+
+[[nodiscard]] inline auto read_source(const std::string &path)
+        -> std::vector<unsigned char>
+{
+    Source source{ path };
+    std::vector<unsigned char> bytes;
+    for (auto got = std::size_t{ 1 }; got > 0;) {
+        const auto used = bytes.size();
+        bytes.resize(used + default_chunk_size);
+        got = source.read(std::span{ bytes }.subspan(used));
+        bytes.resize(used + got);
+    }
+    return bytes;
+}
+
+[[nodiscard]] inline auto read_file(const std::string &path)
+        -> std::vector<unsigned char>
+{
+    if (is_sequential(path)) {
+        return read_source(path);
+    }
+
+    std::ifstream file{ path, std::ios::binary | std::ios::ate };
+    if (!file) {
+        throw std::runtime_error{ "cannot open input file" };
+    }
+
+    const auto size = file.tellg();
+    if (size < 0) {
+        throw std::runtime_error{ "cannot read input file" };
+    }
+
+    std::vector<unsigned char> bytes(static_cast<std::size_t>(size));
+    file.seekg(0);
+    if (!bytes.empty()) {
+        file.read(reinterpret_cast<char *>(bytes.data()),
+                  static_cast<std::streamsize>(bytes.size()));
+        if (!file) {
+            throw std::runtime_error{ "cannot read input file" };
+        }
+    }
+
+    return bytes;
+}
+
+void run_workers(std::size_t count, const auto &work)
+{
+    std::vector<std::exception_ptr> errors(count);
+    {
+        std::vector<std::jthread> workers;
+        workers.reserve(count);
+        for (std::size_t index = 0; index < count; ++index) {
+            workers.emplace_back([&work, &errors, index] {
+                try {
+                    work(index);
+                } catch (...) {
+                    errors[index] = std::current_exception();
+                }
+            });
+        }
+    }
+
+    for (const auto &error : errors) {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+}
+
+[[nodiscard]] inline auto slice_count(std::size_t size, std::size_t threads)
+        -> std::size_t
+{
+    return std::clamp(size / min_thread_slice, std::size_t{ 1 }, threads);
+}
+
+[[nodiscard]] inline auto in_word(unsigned char byte, Encoding encoding)
+        -> bool
+{
+    return is_letter(byte) || (encoding == Encoding::utf8 && byte >= 0x80U);
+}
+
+[[nodiscard]] auto
+slice_bounds(std::size_t size, std::size_t parts, const auto &word_end)
+        -> std::vector<std::size_t>
+{
+    std::vector<std::size_t> bounds{ 0 };
+    for (std::size_t part = 1; part <= parts && bounds.back() < size; ++part) {
+        const auto cut = std::max(bounds.back(), size / parts * part);
+        bounds.push_back(part == parts ? size : word_end(cut));
+    }
+    return bounds;
+}
+
+[[nodiscard]] inline auto parse_cpu_list(std::string_view text)
+        -> std::vector<std::size_t>
+{
+    std::vector<std::size_t> values;
+    while (!text.empty()) {
+        const auto comma = std::min(text.find(','), text.size());
+        const auto range = text.substr(0, comma);
+        const auto dash = std::min(range.find('-'), range.size());
+        std::size_t first = 0;
+        std::size_t last = 0;
+        const auto *begin = range.data();
+        if (std::from_chars(begin, begin + dash, first).ec != std::errc{}) {
+            return {};
+        }
+        last = first;
+        if (dash < range.size() &&
+            std::from_chars(begin + dash + 1, begin + range.size(), last).ec !=
+                    std::errc{}) {
+            return {};
+        }
+        for (auto value = first; value <= last; ++value) {
+            values.push_back(value);
+        }
+        text.remove_prefix(std::min(comma + 1, text.size()));
+    }
+    return values;
+}
+
+class Topology
+{
+public:
+    Topology()
+    {
+#if defined(__linux__)
+        cpu_set_t allowed;
+        CPU_ZERO(&allowed);
+        if (::sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+            return;
+        }
+
+        const std::filesystem::path root{ "/sys/devices/system/node" };
+        for (const auto id : parse_cpu_list(first_line(root / "online"))) {
+            const auto path =
+                    root / ("node" + std::to_string(id)) / "cpulist";
+            std::vector<std::size_t> cpus;
+            for (const auto cpu : parse_cpu_list(first_line(path))) {
+                if (cpu < CPU_SETSIZE && CPU_ISSET(cpu, &allowed)) {
+                    cpus.push_back(cpu);
+                }
+            }
+            if (!cpus.empty()) {
+                nodes_.push_back({ id, std::move(cpus) });
+            }
+        }
+#endif
+    }
+
+    [[nodiscard]] auto nodes() const -> std::size_t
+    {
+        return std::max(nodes_.size(), std::size_t{ 1 });
+    }
+
+    [[nodiscard]] auto node_of(std::size_t worker, std::size_t workers) const
+            -> std::size_t
+    {
+        return worker * nodes() / std::max(workers, std::size_t{ 1 });
+    }
+
+    [[nodiscard]] auto id(std::size_t node) const -> std::size_t
+    {
+        return node < nodes_.size() ? nodes_[node].id : 0;
+    }
+
+    void pin(std::size_t node) const
+    {
+#if defined(__linux__)
+        if (node >= nodes_.size()) {
+            return;
+        }
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        for (const auto cpu : nodes_[node].cpus) {
+            CPU_SET(cpu, &cpus);
+        }
+        (void)::sched_setaffinity(0, sizeof(cpus), &cpus);
+#else
+        (void)node;
+#endif
+    }
+
+private:
+    struct Node {
+        std::size_t id;
+        std::vector<std::size_t> cpus;
+    };
+
+    [[nodiscard]] static auto first_line(const std::filesystem::path &path)
+            -> std::string
+    {
+        std::ifstream file{ path };
+        std::string line;
+        std::getline(file, line);
+        return line;
+    }
+
+    std::vector<Node> nodes_;
+};
+
+[[nodiscard]] inline auto numa_topology() -> const Topology &
+{
+    static const Topology topology;
+    return topology;
+}
+
+[[nodiscard]] inline auto evict_file(const std::string &path) -> bool
+{
+#if defined(POSIX_FADV_DONTNEED)
+    const auto fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    (void)::fdatasync(fd);
+    const auto evicted = ::posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED) == 0;
+    (void)::close(fd);
+    return evicted;
+#else
+    (void)path;
+    return false;
+#endif
+}
+
+class Input
+{
+public:
+    Input(const std::string &path,
+          InputMode mode,
+          std::size_t threads = 0,
+          Encoding encoding = Encoding::ascii)
+    {
+        if (threads > 1 && mode == InputMode::read && !is_compressed(path) &&
+            place(path, threads, encoding)) {
+            return;
+        }
+        if (mode != InputMode::mmap || is_compressed(path) || !map(path)) {
+            owned_ = read_file(path);
+            bytes_ = owned_;
+        }
+    }
+
+    Input(const Input &) = delete;
+    Input(Input &&) = delete;
+    auto operator=(const Input &) -> Input & = delete;
+    auto operator=(Input &&) -> Input & = delete;
+
+    ~Input()
+    {
+#if !defined(_WIN32)
+        if (mapping_ != nullptr) {
+            (void)::munmap(mapping_, bytes_.size());
+        }
+#endif
+    }
+
+    [[nodiscard]] auto bytes() const -> std::span<const unsigned char>
+    {
+        return bytes_;
+    }
+
+    [[nodiscard]] auto bounds() const -> std::span<const std::size_t>
+    {
+        return bounds_;
+    }
+
+private:
+#if defined(_WIN32)
+    [[nodiscard]] auto map(const std::string & /*path*/) -> bool
+    {
+        return false;
+    }
+
+    [[nodiscard]] auto place(const std::string & /*path*/,
+                             std::size_t /*threads*/,
+                             Encoding /*encoding*/) -> bool
+    {
+        return false;
+    }
+#else
+    [[nodiscard]] static auto
+    word_end(int fd, std::size_t end, std::size_t size, Encoding encoding)
+            -> std::size_t
+    {
+        std::array<unsigned char, 256> window{};
+        while (end < size) {
+            const auto got = ::pread(fd,
+                                     window.data(),
+                                     std::min(window.size(), size - end),
+                                     static_cast<off_t>(end));
+            if (got <= 0) {
+                throw std::runtime_error{ "cannot read input file" };
+            }
+            const auto read =
+                    std::span{ window }.first(static_cast<std::size_t>(got));
+            const auto stop =
+                    std::ranges::find_if(read, [encoding](unsigned char byte) {
+                        return !in_word(byte, encoding);
+                    });
+            end += static_cast<std::size_t>(stop - read.begin());
+            if (stop != read.end()) {
+                break;
+            }
+        }
+        return end;
+    }
+
+    [[nodiscard]] auto
+    place(const std::string &path, std::size_t threads, Encoding encoding)
+            -> bool
+    {
+        const auto fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            return false;
+        }
+
+        struct stat info {};
+        if (::fstat(fd, &info) != 0 || !S_ISREG(info.st_mode) ||
+            info.st_size <= 0) {
+            (void)::close(fd);
+            return false;
+        }
+
+        const auto size = static_cast<std::size_t>(info.st_size);
+        const auto &topology = numa_topology();
+        try {
+            bounds_ = slice_bounds(
+                    size, slice_count(size, threads), [&](std::size_t cut) {
+                        return word_end(fd, cut, size, encoding);
+                    });
+            placed_ = std::make_unique_for_overwrite<unsigned char[]>(size);
+            const auto parts = bounds_.size() - 1;
+            run_workers(parts, [&](std::size_t part) {
+                topology.pin(topology.node_of(part, parts));
+                const auto end = bounds_[part + 1];
+                for (auto offset = bounds_[part]; offset < end;) {
+                    const auto got = ::pread(fd,
+                                             placed_.get() + offset,
+                                             end - offset,
+                                             static_cast<off_t>(offset));
+                    if (got <= 0) {
+                        throw std::runtime_error{ "cannot read input file" };
+                    }
+                    offset += static_cast<std::size_t>(got);
+                }
+            });
+        } catch (...) {
+            (void)::close(fd);
+            throw;
+        }
+        (void)::close(fd);
+
+        bytes_ = { placed_.get(), size };
+        return true;
+    }
+
+    [[nodiscard]] auto map(const std::string &path) -> bool
+    {
+        const auto fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            return false;
+        }
+
+        struct stat info {};
+        if (::fstat(fd, &info) != 0 || !S_ISREG(info.st_mode) ||
+            info.st_size <= 0) {
+            (void)::close(fd);
+            return false;
+        }
+
+        const auto size = static_cast<std::size_t>(info.st_size);
+        auto *data = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        (void)::close(fd);
+        if (data == MAP_FAILED) {
+            return false;
+        }
+
+        (void)::posix_madvise(data, size, POSIX_MADV_SEQUENTIAL);
+        (void)::posix_madvise(data, size, POSIX_MADV_WILLNEED);
+        mapping_ = data;
+        bytes_ = { static_cast<const unsigned char *>(data), size };
+        return true;
+    }
+
+    void *mapping_ = nullptr;
+#endif
+    std::unique_ptr<unsigned char[]> placed_;
+    std::vector<std::size_t> bounds_;
+    std::vector<unsigned char> owned_;
+    std::span<const unsigned char> bytes_;
+};
+
+class Readahead
+{
+public:
+    Readahead(const std::string &path, std::size_t chunk_size)
+        : source_{ path },
+          buffers_{ std::vector<unsigned char>(chunk_size),
+                    std::vector<unsigned char>(chunk_size) }
+    {
+        reader_ = std::jthread{ [this] { read(); } };
+    }
+
+    Readahead(const Readahead &) = delete;
+    Readahead(Readahead &&) = delete;
+    auto operator=(const Readahead &) -> Readahead & = delete;
+    auto operator=(Readahead &&) -> Readahead & = delete;
+
+    ~Readahead()
+    {
+        {
+            const std::scoped_lock hold{ lock_ };
+            stop_ = true;
+        }
+        changed_.notify_all();
+    }
+
+    [[nodiscard]] auto next() -> std::span<const unsigned char>
+    {
+        std::unique_lock hold{ lock_ };
+        if (holding_) {
+            full_[next_ ^ 1U] = false;
+            changed_.notify_all();
+        }
+        changed_.wait(hold, [this] { return full_[next_] || done_; });
+        if (!full_[next_]) {
+            if (failure_) {
+                std::rethrow_exception(failure_);
+            }
+            return {};
+        }
+
+        const auto index = next_;
+        next_ ^= 1U;
+        holding_ = true;
+        return std::span{ buffers_[index] }.first(sizes_[index]);
+    }
+
+private:
+    void read()
+    {
+        for (std::size_t index = 0;; index ^= 1U) {
+            {
+                std::unique_lock hold{ lock_ };
+                changed_.wait(hold, [&] { return !full_[index] || stop_; });
+                if (stop_) {
+                    return;
+                }
+            }
+
+            auto got = std::size_t{};
+            std::exception_ptr failure;
+            try {
+                got = source_.read(buffers_[index]);
+            } catch (...) {
+                failure = std::current_exception();
+            }
+
+            const std::scoped_lock hold{ lock_ };
+            sizes_[index] = got;
+            full_[index] = got > 0;
+            failure_ = failure;
+            done_ = got == 0 || failure != nullptr;
+            changed_.notify_all();
+            if (done_) {
+                return;
+            }
+        }
+    }
+
+    Source source_;
+    std::array<std::vector<unsigned char>, 2> buffers_;
+    std::array<std::size_t, 2> sizes_{};
+    std::array<bool, 2> full_{};
+    std::size_t next_ = 0;
+    bool holding_ = false;
+    bool done_ = false;
+    bool stop_ = false;
+    std::exception_ptr failure_;
+    std::mutex lock_;
+    std::condition_variable changed_;
+    std::jthread reader_;
+};
+
+[[nodiscard]] inline auto estimated_unique_words(std::size_t bytes)
+        -> std::size_t
+{
+    return bytes / estimated_bytes_per_unique_word;
+}
+
+[[nodiscard]] inline auto count_tokens(std::span<const unsigned char> bytes)
+        -> std::uint64_t
+{
+    auto tokens = std::uint64_t{};
+    auto in_word = false;
+    for (const auto byte : bytes) {
+        const auto letter = is_letter(byte);
+        tokens += letter && !in_word ? 1U : 0U;
+        in_word = letter;
+    }
+    return tokens;
+}
+
+using ClassifyFn = std::uint64_t (*)(const unsigned char *block);
+
+[[nodiscard]] inline auto classify_tail(std::span<const unsigned char> block)
+        -> std::uint64_t
+{
+    auto letters = std::uint64_t{};
+    for (std::size_t index = 0; index < block.size(); ++index) {
+        if (is_letter(block[index])) {
+            letters |= std::uint64_t{ 1 } << index;
+        }
+    }
+    return letters;
+}
+
+#if defined(SCAN_SSE2)
+[[nodiscard]] inline auto classify_sse2(const unsigned char *block)
+        -> std::uint64_t
+{
+    const auto fold = _mm_set1_epi8(0x20);
+    const auto shift = _mm_set1_epi8(static_cast<char>(0x80 - 'a'));
+    const auto limit = _mm_set1_epi8(static_cast<char>(-128 + 26));
+    auto letters = std::uint64_t{};
+    for (std::size_t lane = 0; lane < scan_block / 16; ++lane) {
+        const auto bytes = _mm_loadu_si128(
+                reinterpret_cast<const __m128i *>(block) + lane);
+        const auto folded = _mm_add_epi8(_mm_or_si128(bytes, fold), shift);
+        const auto mask = static_cast<std::uint32_t>(
+                _mm_movemask_epi8(_mm_cmplt_epi8(folded, limit)));
+        letters |= std::uint64_t{ mask } << (16 * lane);
+    }
+    return letters;
+}
+#endif
+
+#if defined(SCAN_AVX2)
+[[nodiscard, gnu::target("avx2")]] inline auto
+classify_avx2(const unsigned char *block) -> std::uint64_t
+{
+    const auto fold = _mm256_set1_epi8(0x20);
+    const auto shift = _mm256_set1_epi8(static_cast<char>(0x80 - 'a'));
+    const auto limit = _mm256_set1_epi8(static_cast<char>(-128 + 26));
+    auto letters = std::uint64_t{};
+    for (std::size_t lane = 0; lane < scan_block / 32; ++lane) {
+        const auto bytes = _mm256_loadu_si256(
+                reinterpret_cast<const __m256i *>(block) + lane);
+        const auto folded =
+                _mm256_add_epi8(_mm256_or_si256(bytes, fold), shift);
+        const auto mask = static_cast<std::uint32_t>(
+                _mm256_movemask_epi8(_mm256_cmpgt_epi8(limit, folded)));
+        letters |= std::uint64_t{ mask } << (32 * lane);
+    }
+    return letters;
+}
+#endif
+
+#if defined(SCAN_NEON)
+[[nodiscard]] inline auto classify_neon(const unsigned char *block)
+        -> std::uint64_t
+{
+    constexpr std::array<std::uint8_t, 16> weights{
+        1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128
+    };
+    const auto bit = vld1q_u8(weights.data());
+    auto letters = std::uint64_t{};
+    for (std::size_t lane = 0; lane < scan_block / 16; ++lane) {
+        const auto bytes = vld1q_u8(block + 16 * lane);
+        const auto folded =
+                vsubq_u8(vorrq_u8(bytes, vdupq_n_u8(0x20)), vdupq_n_u8('a'));
+        const auto bits = vandq_u8(vcltq_u8(folded, vdupq_n_u8(26)), bit);
+        const auto mask =
+                std::uint64_t{ vaddv_u8(vget_low_u8(bits)) } |
+                (std::uint64_t{ vaddv_u8(vget_high_u8(bits)) } << 8U);
+        letters |= mask << (16 * lane);
+    }
+    return letters;
+}
+#endif
+
+[[nodiscard]] inline auto classifier(Scan scan) -> ClassifyFn
+{
+    if (scan == Scan::scalar) {
+        return nullptr;
+    }
+#if defined(SCAN_AVX2)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return classify_avx2;
+    }
+#endif
+#if defined(SCAN_SSE2)
+    return classify_sse2;
+#elif defined(SCAN_NEON)
+    return classify_neon;
+#else
+    return nullptr;
+#endif
+}
+
+inline void fold_letters(char *out, std::span<const unsigned char> letters)
+{
+    std::size_t index = 0;
+#if defined(SCAN_SSE2)
+    const auto fold = _mm_set1_epi8(0x20);
+    for (; index + 16 <= letters.size(); index += 16) {
+        const auto bytes = _mm_loadu_si128(
+                reinterpret_cast<const __m128i *>(letters.data() + index));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out + index),
+                         _mm_or_si128(bytes, fold));
+    }
+#elif defined(SCAN_NEON)
+    const auto fold = vdupq_n_u8(0x20);
+    for (; index + 16 <= letters.size(); index += 16) {
+        vst1q_u8(reinterpret_cast<std::uint8_t *>(out + index),
+                 vorrq_u8(vld1q_u8(letters.data() + index), fold));
+    }
+#endif
+    for (; index < letters.size(); ++index) {
+        out[index] = static_cast<char>(letters[index] | 0x20U);
+    }
+}
+
+class Scanner
+{
+public:
+    Scanner(std::span<const unsigned char> bytes, ClassifyFn classify)
+        : bytes_{ bytes }, classify_{ classify }
+    {
+        if (!bytes_.empty()) {
+            load(0);
+        }
+    }
+
+    [[nodiscard]] auto skip(std::size_t cursor, bool letters) -> std::size_t
+    {
+        while (cursor < bytes_.size()) {
+            if (cursor - base_ >= scan_block) {
+                load(cursor);
+            }
+
+            auto stops = letters ? ~letters_ : letters_;
+            stops &= ~std::uint64_t{} << (cursor - base_);
+            if (stops != 0) {
+                const auto stop = base_ + static_cast<std::size_t>(
+                                                  std::countr_zero(stops));
+                return std::min(stop, bytes_.size());
+            }
+            cursor = base_ + scan_block;
+        }
+        return bytes_.size();
+    }
+
+private:
+    void load(std::size_t base)
+    {
+        base_ = base;
+        letters_ = bytes_.size() - base >= scan_block
+                           ? classify_(bytes_.data() + base)
+                           : classify_tail(bytes_.subspan(base));
+    }
+
+    std::span<const unsigned char> bytes_;
+    ClassifyFn classify_;
+    std::size_t base_ = 0;
+    std::uint64_t letters_ = 0;
+};
+
+[[nodiscard]] inline auto ranks_before(std::uint64_t left_count,
+                                       std::string_view left_word,
+                                       std::uint64_t right_count,
+                                       std::string_view right_word) -> bool
+{
+    if (left_count != right_count) {
+        return left_count > right_count;
+    }
+    return left_word < right_word;
+}
+
+struct RankKey {
+    std::uint64_t count;
+    std::uint64_t prefix;
+    std::string_view word;
+};
+
+[[nodiscard]] inline auto word_prefix(std::string_view word) -> std::uint64_t
+{
+    std::uint64_t prefix = 0;
+    for (std::size_t index = 0; index < sizeof(prefix); ++index) {
+        prefix <<= 8U;
+        if (index < word.size()) {
+            prefix |= static_cast<unsigned char>(word[index]);
+        }
+    }
+    return prefix;
+}
+
+[[nodiscard]] inline auto rank_key(std::string_view word, std::uint64_t count)
+        -> RankKey
+{
+    return { .count = count, .prefix = word_prefix(word), .word = word };
+}
+
+[[nodiscard]] inline auto key_before(const RankKey &left, const RankKey &right)
+        -> bool
+{
+    if (left.count != right.count) {
+        return left.count > right.count;
+    }
+    if (left.prefix != right.prefix) {
+        return left.prefix < right.prefix;
+    }
+    return left.word < right.word;
+}
+
+template <typename Item>
+void sort_ranked(std::vector<Item> &items,
+                 std::size_t threads,
+                 const auto &before)
+{
+    const auto runs = std::clamp(
+            items.size() / min_sort_run, std::size_t{ 1 }, threads);
+    if (runs == 1) {
+        std::ranges::sort(items, before);
+        return;
+    }
+
+    std::vector<std::size_t> bounds(runs + 1);
+    for (std::size_t run = 0; run < runs; ++run) {
+        bounds[run] = items.size() / runs * run;
+    }
+    bounds[runs] = items.size();
+    const auto at = [&items, &bounds](std::size_t run) {
+        return items.begin() + static_cast<std::ptrdiff_t>(bounds[run]);
+    };
+
+    run_workers(runs, [&](std::size_t run) {
+        std::sort(at(run), at(run + 1), before);
+    });
+    for (std::size_t stride = 1; stride < runs; stride *= 2) {
+        const auto pairs = (runs + stride - 1) / (2 * stride);
+        run_workers(pairs, [&](std::size_t pair) {
+            const auto left = pair * 2 * stride;
+            const auto middle = std::min(left + stride, runs);
+            const auto right = std::min(left + 2 * stride, runs);
+            std::inplace_merge(at(left), at(middle), at(right), before);
+        });
+    }
+}
+
+inline void sort_entries(std::vector<Entry> &entries, std::size_t threads)
+{
+    if (entries.size() < min_sort_run) {
+        std::ranges::sort(entries, [](const Entry &left, const Entry &right) {
+            return ranks_before(
+                    left.count, left.word, right.count, right.word);
+        });
+        return;
+    }
+
+    std::vector<std::pair<RankKey, Entry *>> ranked;
+    ranked.reserve(entries.size());
+    for (auto &entry : entries) {
+        ranked.emplace_back(rank_key(entry.word, entry.count), &entry);
+    }
+    sort_ranked(ranked, threads, [](const auto &left, const auto &right) {
+        return key_before(left.first, right.first);
+    });
+
+    std::vector<Entry> sorted;
+    sorted.reserve(entries.size());
+    for (const auto &[key, entry] : ranked) {
+        sorted.push_back(std::move(*entry));
+    }
+    entries = std::move(sorted);
+}
+
+inline void rank_entries(std::vector<Entry> &entries,
+                         std::size_t top,
+                         bool select,
+                         std::size_t threads)
+{
+    const auto keep = std::min(top, entries.size());
+    if (select) {
+        std::ranges::partial_sort(
+                entries,
+                entries.begin() + static_cast<std::ptrdiff_t>(keep),
+                [](const Entry &left, const Entry &right) {
+                    return ranks_before(
+                            left.count, left.word, right.count, right.word);
+                });
+    } else {
+        sort_entries(entries, threads);
+    }
+    entries.resize(keep);
+}
+
+struct WordHash {
+    using is_transparent = void;
+
+    [[nodiscard]] auto operator()(std::string_view word) const noexcept
+            -> std::size_t
+    {
+        return std::hash<std::string_view>{}(word);
+    }
+};
+
+using StandardMap = std::unordered_map<std::string, std::uint64_t>;
+using TransparentMap = std::unordered_map<std::string,
+                                          std::uint64_t,
+                                          WordHash,
+                                          std::equal_to<>>;
+
+class CompactTable
+{
+public:
+    using key_equal = std::equal_to<>;
+
+    void reserve(std::size_t count)
+    {
+        auto capacity = initial_capacity;
+        while (capacity * 7 < count * 10) {
+            capacity *= 2;
+        }
+        if (capacity > index_.size()) {
+            rehash(capacity);
+        }
+    }
+
+    auto add(std::string_view word, std::uint64_t count = 1) -> std::size_t
+    {
+        return add(word, count, WordHash{}(word));
+    }
+
+    auto
+    add(std::string_view word, std::uint64_t count, std::size_t word_hash)
+            -> std::size_t
+    {
+        if ((slots_.size() + 1) * 10 >= index_.size() * 7) {
+            resizes_ += index_.empty() ? 0 : 1;
+            rehash(index_.empty() ? initial_capacity : index_.size() * 2);
+        }
+
+        const auto hash = static_cast<std::uint32_t>(word_hash);
+        const auto mask = index_.size() - 1;
+        std::size_t probes = 1;
+        for (auto position = hash & mask;;
+             position = (position + 1) & mask, ++probes) {
+            const auto held = index_[position];
+            if (held == 0) {
+                if (slots_.size() >= max_slots) {
+                    throw std::length_error{ "compact table is full" };
+                }
+                index_[position] =
+                        static_cast<std::uint32_t>(slots_.size() + 1);
+                store(slots_.emplace_back(), hash, word);
+                bump(slots_.back(), word, count);
+                return probes;
+            }
+
+            auto &slot = slots_[held - 1];
+            if (slot.hash == hash && this->word(slot) == word) {
+                bump(slot, word, count);
+                return probes;
+            }
+        }
+    }
+
+    void absorb(const CompactTable &other)
+    {
+        for (const auto &slot : other.slots_) {
+            const auto word = other.word(slot);
+            (void)add(word, other.count(slot, word), slot.hash);
+        }
+    }
+
+    void for_each(const auto &visit) const
+    {
+        for (const auto &slot : slots_) {
+            const auto word = this->word(slot);
+            visit(word, count(slot, word));
+        }
+    }
+
+    [[nodiscard]] auto find(std::string_view word) const -> std::uint64_t
+    {
+        if (index_.empty()) {
+            return 0;
+        }
+
+        const auto hash = static_cast<std::uint32_t>(WordHash{}(word));
+        const auto mask = index_.size() - 1;
+        for (auto position = hash & mask;; position = (position + 1) & mask) {
+            const auto held = index_[position];
+            if (held == 0) {
+                return 0;
+            }
+
+            const auto &slot = slots_[held - 1];
+            if (slot.hash == hash && this->word(slot) == word) {
+                return count(slot, word);
+            }
+        }
+    }
+
+    void clear()
+    {
+        std::ranges::fill(index_, 0U);
+        slots_.clear();
+        pool_.clear();
+        overflow_.clear();
+        resizes_ = 0;
+    }
+
+    [[nodiscard]] auto size() const -> std::size_t
+    {
+        return slots_.size();
+    }
+
+    [[nodiscard]] auto resizes() const -> std::size_t
+    {
+        return resizes_;
+    }
+
+    [[nodiscard]] auto capacity() const -> std::size_t
+    {
+        return index_.size();
+    }
+
+    [[nodiscard]] auto bytes() const -> std::size_t
+    {
+        return index_.capacity() * sizeof(std::uint32_t) +
+               slots_.capacity() * sizeof(Slot) + pool_.capacity();
+    }
+
+private:
+    static constexpr auto initial_capacity = std::size_t{ 16 };
+    static constexpr auto inline_bytes = std::size_t{ 15 };
+    static constexpr auto pooled = std::uint8_t{ 0xff };
+    static constexpr auto promoted = std::numeric_limits<std::uint32_t>::max();
+    static constexpr auto max_slots = std::size_t{ promoted } - 1;
+
+    struct Slot {
+        std::uint32_t hash = 0;
+        std::uint32_t count = 0;
+        std::uint8_t length = 0;
+        std::array<char, inline_bytes> bytes{};
+    };
+    static_assert(sizeof(Slot) == 24);
+
+    void store(Slot &slot, std::uint32_t hash, std::string_view word)
+    {
+        slot.hash = hash;
+        if (word.size() <= inline_bytes) {
+            slot.length = static_cast<std::uint8_t>(word.size());
+            std::ranges::copy(word, slot.bytes.begin());
+            return;
+        }
+
+        const auto offset = static_cast<std::uint64_t>(pool_.size());
+        const auto size = static_cast<std::uint16_t>(word.size());
+        pool_.resize(pool_.size() + sizeof(size) + word.size());
+        std::memcpy(pool_.data() + offset, &size, sizeof(size));
+        std::memcpy(pool_.data() + offset + sizeof(size),
+                    word.data(),
+                    word.size());
+        slot.length = pooled;
+        std::memcpy(slot.bytes.data(), &offset, sizeof(offset));
+    }
+
+    [[nodiscard]] auto word(const Slot &slot) const -> std::string_view
+    {
+        if (slot.length != pooled) {
+            return { slot.bytes.data(), slot.length };
+        }
+
+        std::uint64_t offset = 0;
+        std::uint16_t size = 0;
+        std::memcpy(&offset, slot.bytes.data(), sizeof(offset));
+        std::memcpy(&size, pool_.data() + offset, sizeof(size));
+        return { pool_.data() + offset + sizeof(size), size };
+    }
+
+    [[nodiscard]] auto count(const Slot &slot, std::string_view word) const
+            -> std::uint64_t
+    {
+        if (slot.count == promoted) {
+            return overflow_.find(word)->second;
+        }
+        return slot.count;
+    }
+
+    void bump(Slot &slot, std::string_view word, std::uint64_t count)
+    {
+        if (slot.count == promoted) {
+            overflow_.find(word)->second += count;
+            return;
+        }
+
+        const auto next = std::uint64_t{ slot.count } + count;
+        if (next >= promoted) {
+            overflow_.emplace(word, next);
+            slot.count = promoted;
+            return;
+        }
+        slot.count = static_cast<std::uint32_t>(next);
+    }
+
+    void rehash(std::size_t capacity)
+    {
+        std::vector<std::uint32_t> next(capacity);
+        const auto mask = capacity - 1;
+        for (std::size_t index = 0; index < slots_.size(); ++index) {
+            auto position = slots_[index].hash & mask;
+            while (next[position] != 0) {
+                position = (position + 1) & mask;
+            }
+            next[position] = static_cast<std::uint32_t>(index + 1);
+        }
+        index_ = std::move(next);
+    }
+
+    std::vector<std::uint32_t> index_;
+    std::vector<Slot> slots_;
+    std::vector<char> pool_;
+    TransparentMap overflow_;
+    std::size_t resizes_ = 0;
+};
+
+[[nodiscard]] inline auto mix_hash(std::string_view word) -> std::uint64_t
+{
+    auto hash = std::uint64_t{ 14'695'981'039'346'656'037U };
+    for (const auto byte : word) {
+        hash ^= static_cast<unsigned char>(byte);
+        hash *= 1'099'511'628'211U;
+    }
+
+    hash ^= hash >> 33U;
+    hash *= 0xff51'afd7'ed55'8ccdU;
+    hash ^= hash >> 33U;
+    hash *= 0xc4ce'b9fe'1a85'ec53U;
+    hash ^= hash >> 33U;
+    return hash;
+}
+
+class Sketch
+{
+public:
+    explicit Sketch(std::size_t bits)
+        : bits_{ bits }, registers_(std::size_t{ 1 } << bits)
+    {
+    }
+
+    void observe(std::uint64_t hash)
+    {
+        const auto index = static_cast<std::size_t>(hash >> (64 - bits_));
+        const auto rest =
+                (hash << bits_) | (std::uint64_t{ 1 } << (bits_ - 1));
+        const auto rank = static_cast<std::uint8_t>(std::countl_zero(rest) + 1);
+        registers_[index] = std::max(registers_[index], rank);
+    }
+
+    void merge(const Sketch &other)
+    {
+        for (std::size_t index = 0; index < registers_.size(); ++index) {
+            registers_[index] =
+                    std::max(registers_[index], other.registers_[index]);
+        }
+    }
+
+    [[nodiscard]] auto estimate() const -> double
+    {
+        auto sum = 0.0;
+        std::size_t zeros = 0;
+        for (const auto rank : registers_) {
+            sum += std::ldexp(1.0, -static_cast<int>(rank));
+            zeros += rank == 0 ? 1 : 0;
+        }
+
+        const auto m = static_cast<double>(registers_.size());
+        const auto size = registers_.size();
+        const auto alpha = size == 16   ? 0.673
+                           : size == 32 ? 0.697
+                           : size == 64 ? 0.709
+                                        : 0.7213 / (1.0 + 1.079 / m);
+        auto estimate = alpha * m * m / sum;
+        if (estimate <= 2.5 * m && zeros > 0) {
+            estimate = m * std::log(m / static_cast<double>(zeros));
+        }
+        return estimate;
+    }
+
+    [[nodiscard]] auto size() const -> std::size_t
+    {
+        return registers_.size();
+    }
+
+private:
+    std::size_t bits_;
+    std::vector<std::uint8_t> registers_;
+};
+
+[[nodiscard]] inline auto sample_words(std::span<const unsigned char> bytes,
+                                       std::size_t start,
+                                       std::size_t max_word,
+                                       Sketch &sketch) -> std::uint64_t
+{
+    const auto end = start + sample_chunk;
+    auto cursor = start;
+    while (cursor > 0 && cursor < end && is_letter(bytes[cursor - 1])) {
+        ++cursor;
+    }
+
+    std::array<char, max_word_limit> folded{};
+    auto words = std::uint64_t{};
+    for (;;) {
+        while (cursor < end && !is_letter(bytes[cursor])) {
+            ++cursor;
+        }
+        const auto word = cursor;
+        while (cursor < end && is_letter(bytes[cursor])) {
+            ++cursor;
+        }
+        if (cursor == end) {
+            return words;
+        }
+
+        const auto size = std::min(cursor - word, max_word);
+        fold_letters(folded.data(), bytes.subspan(word, size));
+        sketch.observe(mix_hash({ folded.data(), size }));
+        ++words;
+    }
+}
+
+[[nodiscard]] inline auto sampled_unique_words(
+        std::span<const unsigned char> bytes, std::size_t max_word)
+        -> std::size_t
+{
+    constexpr auto sampled = sample_chunks * sample_chunk;
+    if (bytes.size() <= sampled * 2) {
+        return estimated_unique_words(bytes.size());
+    }
+
+    std::array sketches{ Sketch{ sample_register_bits },
+                         Sketch{ sample_register_bits } };
+    std::array<std::uint64_t, 2> words{};
+    const auto stride = (bytes.size() - sample_chunk) / (sample_chunks - 1);
+    max_word = normalize_max_word(max_word);
+    for (std::size_t chunk = 0; chunk < sample_chunks; ++chunk) {
+        words[chunk % 2] += sample_words(
+                bytes, stride * chunk, max_word, sketches[chunk % 2]);
+    }
+    if (words[0] == 0 || words[1] == 0) {
+        return 0;
+    }
+
+    const auto half = sketches[0].estimate();
+    sketches[1].merge(sketches[0]);
+    const auto whole = sketches[1].estimate();
+    const auto tokens = static_cast<double>(words[0] + words[1]);
+    auto growth = std::log(whole / half) /
+                  std::log(tokens / static_cast<double>(words[0]));
+    growth = growth > 0.0 ? std::min(growth, 1.0) : 0.0;
+
+    const auto scale =
+            static_cast<double>(bytes.size()) / static_cast<double>(sampled);
+    return static_cast<std::size_t>(
+            std::min(whole * std::pow(scale, growth), tokens * scale) * 1.25);
+}
+
+class ApproxTable
+{
+public:
+    using key_equal = std::equal_to<>;
+
+    ApproxTable(std::size_t max_word, std::size_t budget)
+        : max_word_{ normalize_max_word(max_word) },
+          sketch_{ register_bits(budget) }
+    {
+        const auto registers = sketch_.size();
+        constexpr auto word_bytes = word_header + average_word;
+        constexpr auto counter_bytes =
+                sizeof(Slot) + sizeof(std::size_t) + word_bytes;
+        const auto pool_floor = 2 * (word_header + max_word_);
+        const auto room = budget > registers + pool_floor
+                                  ? budget - registers - pool_floor
+                                  : 0;
+        const auto estimate =
+                room / (counter_bytes + sizeof(std::size_t) * 10 / 7);
+
+        auto index_size = initial_capacity;
+        while (index_size * 7 < estimate * 10) {
+            index_size *= 2;
+        }
+        const auto index_bytes = index_size * sizeof(std::size_t);
+        const auto capacity =
+                room > index_bytes ? (room - index_bytes) / counter_bytes : 0;
+        if (capacity == 0) {
+            throw std::invalid_argument{ "--approx budget is too small" };
+        }
+        capacity_ = std::min({ capacity,
+                               index_size * 7 / 10,
+                               std::size_t{ dead } - 1 });
+        slots_.resize(capacity_);
+        heap_.resize(capacity_);
+        index_.resize(index_size);
+        words_.resize(pool_floor + capacity_ * word_bytes);
+    }
+
+    void add(std::string_view word)
+    {
+        const auto hash = mix_hash(word);
+        sketch_.observe(hash);
+
+        auto &cell = probe(hash, word);
+        if (cell != 0) {
+            const auto slot = cell - 1;
+            ++slots_[slot].count;
+            sift_down(slots_[slot].heap);
+            return;
+        }
+
+        const auto need = word_header + word.size();
+        if (size_ == capacity_) {
+            const auto victim = heap_.front();
+            const auto reuse = word.size() <= slots_[victim].room;
+            if (reuse || used_ + need <= words_.size()) {
+                const auto floor = slots_[victim].count;
+                evicted_ = true;
+                unlink(victim);
+                if (reuse) {
+                    fill(victim, hash, word, floor);
+                } else {
+                    release(victim);
+                    store(victim, hash, word, floor);
+                }
+                probe(hash, word) = victim + 1;
+                sift_down(0);
+                return;
+            }
+            drop();
+        }
+        if (used_ + need > words_.size()) {
+            reclaim(need);
+        }
+        const auto slot = size_++;
+        store(slot, hash, word, dropped_);
+        probe(hash, word) = slot + 1;
+        heap_[slot] = slot;
+        slots_[slot].heap = slot;
+        sift_up(slot);
+    }
+
+    [[nodiscard]] auto size() const -> std::size_t
+    {
+        return size_;
+    }
+
+    [[nodiscard]] auto result(std::uint64_t total, std::size_t top) const
+            -> ApproxResult
+    {
+        ApproxResult result{ .total = total,
+                             .unique = size_,
+                             .top = {},
+                             .counters = capacity_,
+                             .max_error = 0,
+                             .unique_error = 0.0 };
+        if (evicted_) {
+            const auto registers = static_cast<double>(sketch_.size());
+            result.unique =
+                    static_cast<std::uint64_t>(sketch_.estimate() + 0.5);
+            result.unique_error = 1.04 / std::sqrt(registers);
+            result.max_error = slots_[heap_.front()].count;
+        }
+
+        const auto keep = std::min(top, size_);
+        const auto before = [this](std::size_t left, std::size_t right) {
+            return below(right, left);
+        };
+        std::vector<std::size_t> best;
+        best.reserve(keep);
+        for (std::size_t slot = 0; slot < size_; ++slot) {
+            if (best.size() < keep) {
+                best.push_back(slot);
+                std::ranges::push_heap(best, before);
+            } else if (keep > 0 && before(slot, best.front())) {
+                std::ranges::pop_heap(best, before);
+                best.back() = slot;
+                std::ranges::push_heap(best, before);
+            }
+        }
+        std::ranges::sort_heap(best, before);
+
+        result.top.reserve(keep);
+        for (const auto slot : best) {
+            result.top.push_back({ std::string{ word(slot) },
+                                   slots_[slot].count,
+                                   slots_[slot].error });
+        }
+        return result;
+    }
+
+private:
+    static constexpr auto average_word = std::size_t{ 8 };
+    static constexpr auto word_header = sizeof(std::uint32_t);
+    static constexpr auto dead = std::uint32_t{ 1 } << 31U;
+    static constexpr auto initial_capacity = std::size_t{ 16 };
+    static constexpr auto max_register_bits = std::size_t{ 16 };
+    static constexpr auto min_register_bits = std::size_t{ 4 };
+
+    struct Slot {
+        std::uint64_t count = 0;
+        std::uint64_t error = 0;
+        std::uint64_t hash = 0;
+        std::size_t offset = 0;
+        std::size_t room = 0;
+        std::size_t length = 0;
+        std::size_t heap = 0;
+    };
+
+    [[nodiscard]] static auto register_bits(std::size_t budget) -> std::size_t
+    {
+        auto bits = min_register_bits;
+        while (bits < max_register_bits &&
+               (std::size_t{ 2 } << bits) <= budget / 16) {
+            ++bits;
+        }
+        return bits;
+    }
+
+    [[nodiscard]] auto word(std::size_t slot) const -> std::string_view
+    {
+        return { words_.data() + slots_[slot].offset, slots_[slot].length };
+    }
+
+    [[nodiscard]] auto below(std::size_t left, std::size_t right) const -> bool
+    {
+        if (slots_[left].count != slots_[right].count) {
+            return slots_[left].count < slots_[right].count;
+        }
+        return word(left) > word(right);
+    }
+
+    void swap(std::size_t left, std::size_t right)
+    {
+        std::swap(heap_[left], heap_[right]);
+        slots_[heap_[left]].heap = left;
+        slots_[heap_[right]].heap = right;
+    }
+
+    void sift_up(std::size_t position)
+    {
+        while (position > 0) {
+            const auto parent = (position - 1) / 2;
+            if (!below(heap_[position], heap_[parent])) {
+                return;
+            }
+            swap(position, parent);
+            position = parent;
+        }
+    }
+
+    void sift_down(std::size_t position)
+    {
+        for (;;) {
+            auto least = position;
+            const auto left = 2 * position + 1;
+            const auto right = left + 1;
+            if (left < size_ && below(heap_[left], heap_[least])) {
+                least = left;
+            }
+            if (right < size_ && below(heap_[right], heap_[least])) {
+                least = right;
+            }
+            if (least == position) {
+                return;
+            }
+            swap(position, least);
+            position = least;
+        }
+    }
+
+    [[nodiscard]] auto probe(std::uint64_t hash, std::string_view word)
+            -> std::size_t &
+    {
+        const auto mask = index_.size() - 1;
+        for (auto position = static_cast<std::size_t>(hash) & mask;;
+             position = (position + 1) & mask) {
+            const auto held = index_[position];
+            if (held == 0) {
+                return index_[position];
+            }
+            if (slots_[held - 1].hash == hash && this->word(held - 1) == word) {
+                return index_[position];
+            }
+        }
+    }
+
+    void unlink(std::size_t slot)
+    {
+        const auto mask = index_.size() - 1;
+        auto hole = static_cast<std::size_t>(slots_[slot].hash) & mask;
+        while (index_[hole] != slot + 1) {
+            hole = (hole + 1) & mask;
+        }
+        for (auto next = (hole + 1) & mask; index_[next] != 0;
+             next = (next + 1) & mask) {
+            const auto home =
+                    static_cast<std::size_t>(slots_[index_[next] - 1].hash) &
+                    mask;
+            if (((next - home) & mask) >= ((next - hole) & mask)) {
+                index_[hole] = index_[next];
+                hole = next;
+            }
+        }
+        index_[hole] = 0;
+    }
+
+    void set_header(std::size_t slot, std::uint32_t header)
+    {
+        std::memcpy(words_.data() + slots_[slot].offset - word_header,
+                    &header,
+                    sizeof(header));
+    }
+
+    void release(std::size_t slot)
+    {
+        const auto room = slots_[slot].room;
+        set_header(slot, dead | static_cast<std::uint32_t>(room));
+        live_ -= word_header + room;
+    }
+
+    void compact()
+    {
+        std::size_t to = 0;
+        for (std::size_t from = 0; from < used_;) {
+            std::uint32_t header = 0;
+            std::memcpy(&header, words_.data() + from, sizeof(header));
+            if ((header & dead) != 0) {
+                from += word_header + std::size_t{ header & ~dead };
+                continue;
+            }
+
+            auto &slot = slots_[header];
+            std::memmove(words_.data() + to,
+                         words_.data() + from,
+                         word_header + slot.length);
+            from += word_header + slot.room;
+            live_ -= slot.room - slot.length;
+            slot.offset = to + word_header;
+            slot.room = slot.length;
+            to += word_header + slot.length;
+        }
+        used_ = to;
+    }
+
+    void drop()
+    {
+        const auto slot = heap_.front();
+        const auto last = size_ - 1;
+        evicted_ = true;
+        dropped_ = slots_[slot].count;
+        unlink(slot);
+        release(slot);
+        swap(0, last);
+        size_ = last;
+        sift_down(0);
+        if (slot == last) {
+            return;
+        }
+
+        const auto mask = index_.size() - 1;
+        auto position = static_cast<std::size_t>(slots_[last].hash) & mask;
+        while (index_[position] != last + 1) {
+            position = (position + 1) & mask;
+        }
+        index_[position] = slot + 1;
+        slots_[slot] = slots_[last];
+        heap_[slots_[slot].heap] = slot;
+        set_header(slot, static_cast<std::uint32_t>(slot));
+    }
+
+    void reclaim(std::size_t need)
+    {
+        const auto slack = words_.size() / 8;
+        while (size_ > 0 && live_ + need + slack > words_.size()) {
+            drop();
+        }
+        compact();
+    }
+
+    void fill(std::size_t slot,
+              std::uint64_t hash,
+              std::string_view word,
+              std::uint64_t floor)
+    {
+        std::memcpy(words_.data() + slots_[slot].offset,
+                    word.data(),
+                    word.size());
+        slots_[slot].hash = hash;
+        slots_[slot].length = word.size();
+        slots_[slot].count = floor + 1;
+        slots_[slot].error = floor;
+    }
+
+    void store(std::size_t slot,
+               std::uint64_t hash,
+               std::string_view word,
+               std::uint64_t floor)
+    {
+        slots_[slot].offset = used_ + word_header;
+        slots_[slot].room = word.size();
+        set_header(slot, static_cast<std::uint32_t>(slot));
+        used_ += word_header + word.size();
+        live_ += word_header + word.size();
+        fill(slot, hash, word, floor);
+    }
+
+    std::size_t max_word_;
+    std::size_t capacity_ = 0;
+    std::size_t size_ = 0;
+    std::size_t used_ = 0;
+    std::size_t live_ = 0;
+    std::uint64_t dropped_ = 0;
+    bool evicted_ = false;
+    std::vector<Slot> slots_;
+    std::vector<std::size_t> heap_;
+    std::vector<std::size_t> index_;
+    std::vector<char> words_;
+    Sketch sketch_;
+};
+
+template <typename Table>
+concept WordTable = requires(Table &table, std::string_view word) {
+    table.add(word);
+};
+
+template <std::size_t Capacity>
+class StackWord
+{
+public:
+    void push_back(char byte)
+    {
+        bytes_[size_++] = byte;
+    }
+
+    void clear()
+    {
+        size_ = 0;
+    }
+
+    void resize(std::size_t size)
+    {
+        size_ = size;
+    }
+
+    [[nodiscard]] auto data() -> char *
+    {
+        return bytes_.data();
+    }
+
+    [[nodiscard]] auto size() const -> std::size_t
+    {
+        return size_;
+    }
+
+    [[nodiscard]] auto empty() const -> bool
+    {
+        return size_ == 0;
+    }
+
+    [[nodiscard]] auto view() const -> std::string_view
+    {
+        return { bytes_.data(), size_ };
+    }
+
+private:
+    std::array<char, Capacity> bytes_{};
+    std::size_t size_ = 0;
+};
+
+[[nodiscard]] inline auto partition_of(std::uint64_t hash, std::size_t parts)
+        -> std::size_t
+{
+    return static_cast<std::size_t>(((hash >> 32U) * parts) >> 32U);
+}
+
+template <typename Map>
+class ShardedTable
+{
+public:
+    using key_equal = std::equal_to<>;
+
+    explicit ShardedTable(std::size_t parts = 1)
+        : shards_(std::max(parts, std::size_t{ 1 })),
+          buckets_(shards_.size())
+    {
+    }
+
+    void reserve(std::size_t count)
+    {
+        for (std::size_t part = 0; part < shards_.size(); ++part) {
+            shards_[part].reserve(count / shards_.size());
+            if constexpr (!probed) {
+                buckets_[part] = shards_[part].bucket_count();
+            }
+        }
+    }
+
+    auto add(std::string_view word, std::uint64_t count = 1) -> std::size_t
+    {
+        const auto hash = WordHash{}(word);
+        const auto part = partition_of(hash, shards_.size());
+        auto &shard = shards_[part];
+        const auto before = shard.size();
+        std::size_t probes = 0;
+        if constexpr (probed) {
+            probes = shard.add(word, count, hash);
+        } else if constexpr (std::same_as<typename Map::key_equal,
+                                          std::equal_to<>>) {
+            if (const auto found = shard.find(word); found != shard.end()) {
+                found->second += count;
+            } else {
+                shard.emplace(word, count);
+            }
+        } else {
+            key_.assign(word);
+            shard[key_] += count;
+        }
+        if constexpr (!probed) {
+            if (const auto buckets = shard.bucket_count();
+                buckets != buckets_[part]) {
+                resizes_ += buckets_[part] > 1 ? 1 : 0;
+                buckets_[part] = buckets;
+            }
+        }
+        size_ += shard.size() - before;
+        return probes;
+    }
+
+    [[nodiscard]] auto shard(std::size_t part) -> Map &
+    {
+        return shards_[part];
+    }
+
+    [[nodiscard]] auto size() const -> std::size_t
+    {
+        return size_;
+    }
+
+    [[nodiscard]] auto resizes() const -> std::size_t
+    {
+        auto resizes = resizes_;
+        if constexpr (probed) {
+            for (const auto &shard : shards_) {
+                resizes += shard.resizes();
+            }
+        }
+        return resizes;
+    }
+
+    [[nodiscard]] auto capacity() const -> std::size_t
+    {
+        std::size_t capacity = 0;
+        for (const auto &shard : shards_) {
+            if constexpr (probed) {
+                capacity += shard.capacity();
+            } else {
+                capacity += shard.bucket_count();
+            }
+        }
+        return capacity;
+    }
+
+    [[nodiscard]] auto bytes() const -> std::size_t
+    {
+        std::size_t bytes = 0;
+        for (const auto &shard : shards_) {
+            if constexpr (probed) {
+                bytes += shard.bytes();
+            } else {
+                bytes += shard.bucket_count() * sizeof(void *) +
+                         shard.size() * (sizeof(void *) +
+                                         sizeof(typename Map::value_type) +
+                                         sizeof(std::size_t));
+            }
+        }
+        return bytes;
+    }
+
+private:
+    static constexpr auto probed = std::same_as<Map, CompactTable>;
+
+    std::vector<Map> shards_;
+    std::vector<std::size_t> buckets_;
+    std::string key_;
+    std::size_t size_ = 0;
+    std::size_t resizes_ = 0;
+};
+
+class Leaders
+{
+public:
+    explicit Leaders(std::size_t capacity) : capacity_{ capacity } {}
+
+    [[nodiscard]] auto capacity() const -> std::size_t
+    {
+        return capacity_;
+    }
+
+    void reset(std::size_t capacity)
+    {
+        capacity_ = capacity;
+        heap_.clear();
+        positions_.clear();
+    }
+
+    void raise(std::string_view word, std::uint64_t count)
+    {
+        if (capacity_ == 0 ||
+            (heap_.size() == capacity_ && count < heap_.front().count)) {
+            return;
+        }
+
+        if (const auto found = positions_.find(word);
+            found != positions_.end()) {
+            heap_[found->second].count = count;
+            sift_down(found->second);
+            return;
+        }
+
+        if (heap_.size() < capacity_) {
+            positions_.emplace(word, heap_.size());
+            heap_.push_back({ std::string{ word }, count });
+            sift_up(heap_.size() - 1);
+            return;
+        }
+
+        auto &weakest = heap_.front();
+        if (!ranks_before(count, word, weakest.count, weakest.word)) {
+            return;
+        }
+        positions_.erase(positions_.find(weakest.word));
+        weakest = { std::string{ word }, count };
+        positions_.emplace(word, 0);
+        sift_down(0);
+    }
+
+    [[nodiscard]] auto top(std::size_t keep) const -> std::vector<Entry>
+    {
+        auto entries = heap_;
+        std::ranges::sort(entries, [](const Entry &left, const Entry &right) {
+            return ranks_before(left.count, left.word, right.count, right.word);
+        });
+        entries.resize(std::min(keep, entries.size()));
+        return entries;
+    }
+
+private:
+    [[nodiscard]] auto weaker(std::size_t left, std::size_t right) const
+            -> bool
+    {
+        return ranks_before(heap_[right].count,
+                            heap_[right].word,
+                            heap_[left].count,
+                            heap_[left].word);
+    }
+
+    void swap(std::size_t left, std::size_t right)
+    {
+        std::swap(heap_[left], heap_[right]);
+        positions_.find(heap_[left].word)->second = left;
+        positions_.find(heap_[right].word)->second = right;
+    }
+
+    void sift_up(std::size_t position)
+    {
+        while (position > 0) {
+            const auto parent = (position - 1) / 2;
+            if (!weaker(position, parent)) {
+                return;
+            }
+            swap(position, parent);
+            position = parent;
+        }
+    }
+
+    void sift_down(std::size_t position)
+    {
+        for (;;) {
+            auto weakest = position;
+            for (const auto child : { 2 * position + 1, 2 * position + 2 }) {
+                if (child < heap_.size() && weaker(child, weakest)) {
+                    weakest = child;
+                }
+            }
+            if (weakest == position) {
+                return;
+            }
+            swap(position, weakest);
+            position = weakest;
+        }
+    }
+
+    std::size_t capacity_;
+    std::vector<Entry> heap_;
+    std::unordered_map<std::string, std::size_t, WordHash, std::equal_to<>>
+            positions_;
+};
+
+template <typename Map, std::size_t Limit = 0>
+class Counter
+{
+public:
+    explicit Counter(std::size_t max_word,
+                     std::size_t size_hint = 0,
+                     ClassifyFn classify = nullptr,
+                     Encoding encoding = Encoding::ascii)
+        : max_word_{ normalize_max_word(max_word) },
+          classify_{ classify },
+          utf8_{ encoding == Encoding::utf8 }
+    {
+        reserve(estimated_unique_words(size_hint));
+        if constexpr (!transparent) {
+            word_.reserve(std::min(max_word_, default_max_word));
+        }
+    }
+
+    Counter(Map counts,
+            std::size_t max_word,
+            ClassifyFn classify,
+            Encoding encoding = Encoding::ascii)
+        : counts_{ std::move(counts) },
+          max_word_{ normalize_max_word(max_word) },
+          classify_{ classify },
+          utf8_{ encoding == Encoding::utf8 }
+    {
+    }
+
+    void reserve(std::size_t words)
+    {
+        counts_.reserve(words);
+        if constexpr (!compact) {
+            buckets_ = counts_.bucket_count();
+        }
+    }
+
+    void feed(std::span<const unsigned char> bytes)
+    {
+        if (utf8_) {
+            feed_utf8(bytes);
+            return;
+        }
+        feed_ascii(bytes);
+    }
+
+    void merge(Counter &&other)
+    {
+        flush();
+        other.flush();
+        total_ += other.total_;
+        if constexpr (std::same_as<Map, CompactTable>) {
+            counts_.absorb(other.counts_);
+            other.counts_ = Map{};
+        } else if constexpr (compact) {
+            other.counts_.for_each(
+                    [this](std::string_view word, std::uint64_t count) {
+                        counts_.add(word, count);
+                    });
+            other.counts_ = Map{};
+        } else {
+            while (!other.counts_.empty()) {
+                auto node = other.counts_.extract(other.counts_.begin());
+                const auto count = node.mapped();
+                const auto inserted = counts_.insert(std::move(node));
+                if (!inserted.inserted) {
+                    inserted.position->second += count;
+                }
+            }
+            track_buckets();
+        }
+        const auto lookups = stats_.inserts + stats_.hits +
+                             other.stats_.inserts + other.stats_.hits;
+        stats_.inserts = record_stats ? counts_.size() : 0;
+        stats_.hits = lookups - stats_.inserts;
+        stats_.probes += other.stats_.probes;
+        stats_.max_probe = std::max(stats_.max_probe, other.stats_.max_probe);
+        stats_.resizes += other.resizes();
+    }
+
+    [[nodiscard]] auto
+    finish(std::size_t top, bool select, std::size_t threads) && -> Result
+    {
+        flush();
+        const auto unique = counts_.size();
+        if constexpr (compact) {
+            return { .total = total_,
+                     .unique = unique,
+                     .top = rank_table(top, select, threads) };
+        } else {
+            return { .total = total_,
+                     .unique = unique,
+                     .top = rank_nodes(top, select, threads) };
+        }
+    }
+
+    [[nodiscard]] auto entries() -> std::vector<Entry>
+    {
+        flush();
+
+        std::vector<Entry> entries;
+        entries.reserve(counts_.size());
+        if constexpr (compact) {
+            counts_.for_each(
+                    [&entries](std::string_view word, std::uint64_t count) {
+                        entries.push_back({ std::string{ word }, count });
+                    });
+        } else {
+            for (const auto &[entry_word, count] : counts_) {
+                entries.push_back({ entry_word, count });
+            }
+        }
+        return entries;
+    }
+
+    void end_word()
+    {
+        partial_size_ = 0;
+        flush();
+    }
+
+    void clear()
+    {
+        end_word();
+        counts_.clear();
+        total_ = 0;
+        stats_ = {};
+        if constexpr (!compact) {
+            buckets_ = counts_.bucket_count();
+        }
+    }
+
+    [[nodiscard]] auto total() const -> std::uint64_t
+    {
+        return total_;
+    }
+
+    [[nodiscard]] auto unique() const -> std::size_t
+    {
+        return counts_.size();
+    }
+
+    [[nodiscard]] auto resizes() const -> std::size_t
+    {
+        if constexpr (compact) {
+            return counts_.resizes() + stats_.resizes;
+        } else {
+            return stats_.resizes;
+        }
+    }
+
+    [[nodiscard]] auto stats() const -> Stats
+    {
+        auto stats = stats_;
+        stats.resizes = resizes();
+        if constexpr (compact) {
+            stats.capacity = counts_.capacity();
+            stats.table_bytes = counts_.bytes();
+        } else {
+            stats.capacity = counts_.bucket_count();
+            for (std::size_t bucket = 0; bucket < stats.capacity; ++bucket) {
+                stats.max_bucket =
+                        std::max(stats.max_bucket, counts_.bucket_size(bucket));
+            }
+
+            const auto inline_capacity = std::string{}.capacity();
+            stats.table_bytes = stats.capacity * sizeof(void *);
+            for (const auto &[word, count] : counts_) {
+                stats.table_bytes += sizeof(void *) +
+                                     sizeof(typename Map::value_type) +
+                                     sizeof(std::size_t);
+                if (word.capacity() > inline_capacity) {
+                    stats.table_bytes += word.capacity() + 1;
+                }
+            }
+        }
+        return stats;
+    }
+
+    [[nodiscard]] auto count(std::string_view word) const -> std::uint64_t
+    {
+        if constexpr (compact) {
+            return counts_.find(word);
+        } else {
+            const auto found = [this, word] {
+                if constexpr (transparent) {
+                    return counts_.find(word);
+                } else {
+                    return counts_.find(std::string{ word });
+                }
+            }();
+            return found == counts_.end() ? 0 : found->second;
+        }
+    }
+
+    [[nodiscard]] auto peek(std::size_t top,
+                            bool select = true,
+                            std::size_t threads = 1) const -> Result
+    {
+        auto ranked = keys();
+        const auto keep = std::min(top, ranked.size());
+        rank(ranked, keep, select, threads, key_before);
+
+        std::vector<Entry> entries;
+        entries.reserve(keep);
+        for (const auto &key : std::span{ ranked }.first(keep)) {
+            entries.push_back({ std::string{ key.word }, key.count });
+        }
+        return { .total = total_,
+                 .unique = counts_.size(),
+                 .top = std::move(entries) };
+    }
+
+    void track(Leaders &leaders)
+    {
+        leaders_ = &leaders;
+        if constexpr (compact) {
+            counts_.for_each(
+                    [&leaders](std::string_view word, std::uint64_t count) {
+                        leaders.raise(word, count);
+                    });
+        } else {
+            for (const auto &[word, count] : counts_) {
+                leaders.raise(word, count);
+            }
+        }
+    }
+
+    [[nodiscard]] auto table() && -> Map
+    {
+        flush();
+        return std::move(counts_);
+    }
+
+    void release(std::span<Entry> entries) &&
+    {
+        flush();
+        auto next = entries.begin();
+        if constexpr (compact) {
+            counts_.for_each([&next](std::string_view word,
+                                     std::uint64_t count) {
+                *next++ = { std::string{ word }, count };
+            });
+        } else {
+            while (!counts_.empty()) {
+                auto node = counts_.extract(counts_.begin());
+                *next++ = { std::move(node.key()), node.mapped() };
+            }
+        }
+        counts_ = Map{};
+    }
+
+private:
+    static constexpr auto transparent =
+            std::same_as<typename Map::key_equal, std::equal_to<>>;
+    static constexpr auto compact = WordTable<Map>;
+    static constexpr auto probed =
+            std::same_as<Map, CompactTable> ||
+            std::same_as<Map, ShardedTable<CompactTable>>;
+    static constexpr auto trackable =
+            !compact || std::same_as<Map, CompactTable>;
+
+    [[nodiscard]] auto limit() const -> std::size_t
+    {
+        if constexpr (Limit > 0) {
+            return Limit;
+        } else {
+            return max_word_;
+        }
+    }
+
+    struct NodeKey {
+        std::uint64_t count;
+        std::uint64_t prefix;
+        typename Map::iterator node;
+    };
+
+    static void rank(auto &ranked,
+                     std::size_t keep,
+                     bool select,
+                     std::size_t threads,
+                     const auto &before)
+    {
+        if (select) {
+            std::ranges::partial_sort(
+                    ranked,
+                    ranked.begin() + static_cast<std::ptrdiff_t>(keep),
+                    before);
+        } else {
+            sort_ranked(ranked, threads, before);
+        }
+    }
+
+    [[nodiscard]] auto keys() const -> std::vector<RankKey>
+    {
+        std::vector<RankKey> ranked;
+        ranked.reserve(counts_.size());
+        if constexpr (compact) {
+            counts_.for_each(
+                    [&ranked](std::string_view word, std::uint64_t count) {
+                        ranked.push_back(rank_key(word, count));
+                    });
+        } else {
+            for (const auto &[word, count] : counts_) {
+                ranked.push_back(rank_key(word, count));
+            }
+        }
+        return ranked;
+    }
+
+    [[nodiscard]] auto
+    rank_table(std::size_t top, bool select, std::size_t threads)
+            -> std::vector<Entry>
+    {
+        auto ranked = keys();
+        const auto keep = std::min(top, ranked.size());
+        rank(ranked, keep, select, threads, key_before);
+
+        std::vector<Entry> entries;
+        entries.reserve(keep);
+        for (const auto &key : std::span{ ranked }.first(keep)) {
+            entries.push_back({ std::string{ key.word }, key.count });
+        }
+        return entries;
+    }
+
+    [[nodiscard]] auto
+    rank_nodes(std::size_t top, bool select, std::size_t threads)
+            -> std::vector<Entry>
+    {
+        std::vector<NodeKey> ranked;
+        ranked.reserve(counts_.size());
+        for (auto node = counts_.begin(); node != counts_.end(); ++node) {
+            ranked.push_back({ .count = node->second,
+                               .prefix = word_prefix(node->first),
+                               .node = node });
+        }
+
+        const auto keep = std::min(top, ranked.size());
+        rank(ranked,
+             keep,
+             select,
+             threads,
+             [](const NodeKey &left, const NodeKey &right) {
+                 if (left.count != right.count) {
+                     return left.count > right.count;
+                 }
+                 if (left.prefix != right.prefix) {
+                     return left.prefix < right.prefix;
+                 }
+                 return left.node->first < right.node->first;
+             });
+
+        std::vector<Entry> entries;
+        entries.reserve(keep);
+        for (const auto &key : std::span{ ranked }.first(keep)) {
+            auto node = counts_.extract(key.node);
+            entries.push_back({ std::move(node.key()), key.count });
+        }
+        counts_ = Map{};
+        return entries;
+    }
+
+    void feed_ascii(std::span<const unsigned char> bytes)
+    {
+        if (classify_ != nullptr) {
+            feed_runs(bytes);
+            return;
+        }
+
+        for (const auto byte : bytes) {
+            if (is_letter(byte)) {
+                if (word_.size() < limit()) {
+                    word_.push_back(lower_ascii(byte));
+                }
+                continue;
+            }
+
+            flush();
+        }
+    }
+
+    void feed_utf8(std::span<const unsigned char> bytes)
+    {
+        auto cursor = resume(bytes);
+        while (cursor < bytes.size()) {
+            const auto ascii = ascii_end(bytes, cursor);
+            while (clamped_ && cursor < ascii && is_letter(bytes[cursor])) {
+                ++cursor;
+            }
+            feed_ascii(bytes.subspan(cursor, ascii - cursor));
+
+            cursor = ascii;
+            while (cursor < bytes.size() && bytes[cursor] >= 0x80U) {
+                const auto decoded = decode_utf8(bytes.subspan(cursor));
+                if (decoded.size == 0) {
+                    const auto rest = bytes.subspan(cursor);
+                    partial_size_ = std::min(rest.size(), partial_.size());
+                    std::memcpy(partial_.data(), rest.data(), partial_size_);
+                    return;
+                }
+                append_point(decoded.point);
+                cursor += decoded.size;
+            }
+        }
+    }
+
+    [[nodiscard]] auto resume(std::span<const unsigned char> bytes)
+            -> std::size_t
+    {
+        std::size_t cursor = 0;
+        while (partial_size_ > 0) {
+            const auto decoded =
+                    decode_utf8(std::span{ partial_ }.first(partial_size_));
+            if (decoded.size > 0) {
+                partial_size_ = 0;
+                append_point(decoded.point);
+            } else if (cursor == bytes.size()) {
+                return cursor;
+            } else if ((bytes[cursor] & 0xc0U) != 0x80U) {
+                partial_size_ = 0;
+                flush();
+            } else {
+                partial_[partial_size_++] = bytes[cursor++];
+            }
+        }
+        return cursor;
+    }
+
+    [[nodiscard]] static auto ascii_end(std::span<const unsigned char> bytes,
+                                        std::size_t cursor) -> std::size_t
+    {
+        constexpr auto high = std::uint64_t{ 0x8080808080808080U };
+        for (; cursor + 16 <= bytes.size(); cursor += 16) {
+            std::array<std::uint64_t, 2> words{};
+            std::memcpy(words.data(), bytes.data() + cursor, sizeof(words));
+            if (((words[0] | words[1]) & high) != 0) {
+                break;
+            }
+        }
+        while (cursor < bytes.size() && bytes[cursor] < 0x80U) {
+            ++cursor;
+        }
+        return cursor;
+    }
+
+    void append_point(std::uint32_t point)
+    {
+        if (!is_word_point(point)) {
+            flush();
+            return;
+        }
+        if (clamped_) {
+            return;
+        }
+
+        std::array<char, 4> encoded{};
+        const auto size = encode_utf8(fold_point(point), encoded.data());
+        const auto used = word_.size();
+        if (used + size > limit()) {
+            clamped_ = true;
+            return;
+        }
+        word_.resize(used + size);
+        std::copy_n(encoded.begin(), size, word_.data() + used);
+    }
+
+    void feed_runs(std::span<const unsigned char> bytes)
+    {
+        Scanner scanner{ bytes, classify_ };
+        std::size_t cursor = 0;
+        while (cursor < bytes.size()) {
+            const auto end = scanner.skip(cursor, true);
+            append(bytes.subspan(cursor, end - cursor));
+            if (end == bytes.size()) {
+                return;
+            }
+            flush();
+            cursor = scanner.skip(end, false);
+        }
+    }
+
+    void append(std::span<const unsigned char> letters)
+    {
+        const auto used = word_.size();
+        const auto stored = std::min(letters.size(), limit() - used);
+        word_.resize(used + stored);
+        fold_letters(word_.data() + used, letters.first(stored));
+    }
+
+    void flush()
+    {
+        if (word_.empty()) {
+            return;
+        }
+
+        [[maybe_unused]] const auto before = counts_.size();
+        [[maybe_unused]] std::size_t probes = 0;
+        if constexpr (probed) {
+            probes = counts_.add(word_.view());
+        } else if constexpr (compact) {
+            counts_.add(word_.view());
+        } else if constexpr (transparent) {
+            const auto word = word_.view();
+            if (const auto found = counts_.find(word);
+                found != counts_.end()) {
+                ++found->second;
+            } else {
+                counts_.emplace(word, 1);
+            }
+        } else {
+            ++counts_[word_];
+        }
+        if constexpr (!compact) {
+            track_buckets();
+        }
+        if constexpr (record_stats) {
+            note(probes, counts_.size() != before);
+        }
+        if constexpr (trackable) {
+            if (leaders_ != nullptr) {
+                const std::string_view word{ word_.data(), word_.size() };
+                leaders_->raise(word, count(word));
+            }
+        }
+        ++total_;
+        word_.clear();
+        clamped_ = false;
+    }
+
+    void track_buckets()
+    {
+        if (const auto buckets = counts_.bucket_count(); buckets != buckets_) {
+            stats_.resizes += buckets_ > 1 ? 1 : 0;
+            buckets_ = buckets;
+        }
+    }
+
+    void note(std::size_t probes, bool inserted)
+    {
+        stats_.inserts += inserted ? 1 : 0;
+        stats_.hits += inserted ? 0 : 1;
+        stats_.probes += probes;
+        stats_.max_probe = std::max<std::uint64_t>(stats_.max_probe, probes);
+    }
+
+    Map counts_;
+    std::conditional_t<transparent,
+                       StackWord<Limit == 0 ? max_word_limit : Limit>,
+                       std::string>
+            word_;
+    std::uint64_t total_ = 0;
+    std::size_t buckets_ = 0;
+    Stats stats_;
+    Leaders *leaders_ = nullptr;
+    std::size_t max_word_;
+    ClassifyFn classify_;
+    bool utf8_;
+    bool clamped_ = false;
+    std::array<unsigned char, 4> partial_{};
+    std::size_t partial_size_ = 0;
+};
+
+[[nodiscard]] inline auto
+elapsed_ns(std::chrono::steady_clock::time_point started) -> std::uint64_t
+{
+    return static_cast<std::uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now() - started)
+                    .count());
+}
+
+template <typename Map, std::size_t Limit>
+[[nodiscard]] auto finish_counter(Counter<Map, Limit> &&counter,
+                                  const Options &options) -> Result
+{
+    counter.end_word();
+    const auto stats = options.stats ? counter.stats() : Stats{};
+    const auto started = std::chrono::steady_clock::now();
+    auto result = std::move(counter).finish(
+            options.top, options.select, options.threads);
+    result.stats = stats;
+    result.stats.rank_ns = elapsed_ns(started);
+    return result;
+}
+
+template <typename Map, std::size_t Limit>
+[[nodiscard]] auto count_words(std::span<const unsigned char> bytes,
+                               const Options &options) -> Result
+{
+    Counter<Map, Limit> counter{
+        options.max_word, 0, classifier(options.scan), options.encoding
+    };
+    counter.reserve(sampled_unique_words(bytes, options.max_word));
+    counter.feed(bytes);
+    return finish_counter(std::move(counter), options);
+}
+
+template <typename Map, std::size_t Limit>
+[[nodiscard]] auto count_chunked(std::span<const unsigned char> bytes,
+                                 const Options &options) -> Result
+{
+    Counter<Map, Limit> counter{
+        options.max_word, 0, classifier(options.scan), options.encoding
+    };
+    for (std::size_t offset = 0; offset < bytes.size();
+         offset += options.chunk_size) {
+        counter.feed(bytes.subspan(
+                offset, std::min(options.chunk_size, bytes.size() - offset)));
+    }
+    return finish_counter(std::move(counter), options);
+}
+
+[[nodiscard]] inline auto slices_at(std::span<const unsigned char> bytes,
+                                    std::span<const std::size_t> bounds)
+        -> std::vector<std::span<const unsigned char>>
+{
+    std::vector<std::span<const unsigned char>> slices;
+    for (std::size_t part = 1; part < bounds.size(); ++part) {
+        slices.push_back(bytes.subspan(bounds[part - 1],
+                                       bounds[part] - bounds[part - 1]));
+    }
+    return slices;
+}
+
+[[nodiscard]] inline auto
+split_at_separators(std::span<const unsigned char> bytes,
+                    std::size_t parts,
+                    Encoding encoding)
+        -> std::vector<std::span<const unsigned char>>
+{
+    return slices_at(
+            bytes, slice_bounds(bytes.size(), parts, [&](std::size_t end) {
+                while (end < bytes.size() && in_word(bytes[end], encoding)) {
+                    ++end;
+                }
+                return end;
+            }));
+}
+
+template <typename Map, std::size_t Limit>
+[[nodiscard]] auto merge_finish(std::vector<Counter<Map, Limit>> &counters,
+                                const Options &options) -> Result
+{
+    for (std::size_t stride = 1; stride < counters.size(); stride *= 2) {
+        const auto pairs = (counters.size() + stride - 1) / (2 * stride);
+        run_workers(pairs, [&](std::size_t pair) {
+            const auto left = pair * 2 * stride;
+            counters[left].merge(std::move(counters[left + stride]));
+        });
+    }
+
+    if (counters.empty()) {
+        return finish_counter(Counter<Map, Limit>{ options.max_word },
+                              options);
+    }
+    return finish_counter(std::move(counters.front()), options);
+}
+
+inline void combine_stats(Stats &into, const Stats &from)
+{
+    into.inserts += from.inserts;
+    into.hits += from.hits;
+    into.probes += from.probes;
+    into.max_probe = std::max(into.max_probe, from.max_probe);
+    into.resizes += from.resizes;
+    into.capacity += from.capacity;
+    into.max_bucket = std::max(into.max_bucket, from.max_bucket);
+    into.table_bytes += from.table_bytes;
+}
+
+template <typename Map, std::size_t Limit>
+[[nodiscard]] auto
+merge_partitioned(std::vector<Counter<ShardedTable<Map>, Limit>> &counters,
+                  const Options &options) -> Result
+{
+    const auto parts = counters.size();
+    const auto &topology = numa_topology();
+    std::uint64_t total = 0;
+    Stats lookups;
+    std::vector<ShardedTable<Map>> tables;
+    tables.reserve(parts);
+    for (auto &counter : counters) {
+        counter.end_word();
+        total += counter.total();
+        if (options.stats) {
+            combine_stats(lookups, counter.stats());
+        }
+        tables.push_back(std::move(counter).table());
+    }
+
+    std::vector<Counter<Map, Limit>> merged;
+    merged.reserve(parts);
+    for (std::size_t part = 0; part < parts; ++part) {
+        merged.emplace_back(std::move(tables[part].shard(part)),
+                            options.max_word,
+                            nullptr,
+                            options.encoding);
+    }
+    std::vector<Stats> shapes(parts);
+    run_workers(parts, [&](std::size_t part) {
+        const auto home = topology.node_of(part, parts);
+        topology.pin(home);
+        auto words = merged[part].unique();
+        for (auto &table : tables) {
+            words = std::max(words, table.shard(part).size());
+        }
+        merged[part].reserve(words);
+        for (const auto local : { true, false }) {
+            for (std::size_t worker = 0; worker < parts; ++worker) {
+                if (worker == part ||
+                    (topology.node_of(worker, parts) == home) != local) {
+                    continue;
+                }
+                merged[part].merge(Counter<Map, Limit>{
+                        std::move(tables[worker].shard(part)),
+                        options.max_word,
+                        nullptr,
+                        options.encoding });
+            }
+        }
+        if (options.stats) {
+            shapes[part] = merged[part].stats();
+        }
+    });
+
+    const auto started = std::chrono::steady_clock::now();
+    std::vector<std::size_t> offsets(parts + 1);
+    for (std::size_t part = 0; part < parts; ++part) {
+        offsets[part + 1] = offsets[part] + merged[part].unique();
+    }
+    const auto unique = offsets[parts];
+    std::vector<Entry> entries(unique);
+    run_workers(parts, [&](std::size_t part) {
+        topology.pin(topology.node_of(part, parts));
+        std::move(merged[part]).release(std::span{ entries }.subspan(
+                offsets[part], offsets[part + 1] - offsets[part]));
+    });
+    rank_entries(entries, options.top, options.select, options.threads);
+
+    Stats stats;
+    if (options.stats) {
+        for (const auto &shape : shapes) {
+            stats.capacity += shape.capacity;
+            stats.max_bucket = std::max(stats.max_bucket, shape.max_bucket);
+            stats.table_bytes += shape.table_bytes;
+        }
+        stats.inserts = record_stats ? unique : 0;
+        stats.hits = lookups.inserts + lookups.hits - stats.inserts;
+        stats.probes = lookups.probes;
+        stats.max_probe = lookups.max_probe;
+        stats.resizes = lookups.resizes;
+    }
+    stats.rank_ns = elapsed_ns(started);
+    return { .total = total,
+             .unique = unique,
+             .top = std::move(entries),
+             .stats = std::move(stats) };
+}
+
+[[nodiscard]] inline auto node_stats(std::span<const std::uint64_t> bytes,
+                                     std::span<const std::uint64_t> elapsed)
+        -> std::vector<NodeStats>
+{
+    const auto &topology = numa_topology();
+    std::vector<NodeStats> nodes;
+    for (std::size_t worker = 0; worker < bytes.size(); ++worker) {
+        const auto id = topology.id(topology.node_of(worker, bytes.size()));
+        if (nodes.empty() || nodes.back().node != id) {
+            nodes.push_back(
+                    { .node = id, .workers = 0, .bytes = 0, .count_ns = 0 });
+        }
+        auto &node = nodes.back();
+        ++node.workers;
+        node.bytes += bytes[worker];
+        node.count_ns = std::max(node.count_ns, elapsed[worker]);
+    }
+    return nodes;
+}
+
+template <typename Table, std::size_t Limit>
+[[nodiscard]] auto
+feed_slices(std::vector<Counter<Table, Limit>> &counters,
+            std::span<const std::span<const unsigned char>> slices,
+            const Options &options) -> std::vector<std::uint64_t>
+{
+    const auto &topology = numa_topology();
+    std::vector<std::uint64_t> elapsed(slices.size());
+    run_workers(slices.size(), [&](std::size_t index) {
+        if (options.numa) {
+            topology.pin(topology.node_of(index, slices.size()));
+        }
+        const auto started = std::chrono::steady_clock::now();
+        counters[index].reserve(
+                sampled_unique_words(slices[index], options.max_word));
+        counters[index].feed(slices[index]);
+        elapsed[index] = elapsed_ns(started);
+    });
+    return elapsed;
+}
+
+template <typename Map, std::size_t Limit>
+[[nodiscard]] auto count_parallel(std::span<const unsigned char> bytes,
+                                  const Options &options,
+                                  std::span<const std::size_t> bounds)
+        -> Result
+{
+    const auto slices =
+            bounds.empty()
+                    ? split_at_separators(
+                              bytes,
+                              slice_count(bytes.size(), options.threads),
+                              options.encoding)
+                    : slices_at(bytes, bounds);
+
+    const auto classify = classifier(options.scan);
+    if (!options.numa) {
+        std::vector<Counter<Map, Limit>> counters;
+        counters.reserve(slices.size());
+        for (std::size_t index = 0; index < slices.size(); ++index) {
+            counters.emplace_back(
+                    options.max_word, 0, classify, options.encoding);
+        }
+        (void)feed_slices(counters, slices, options);
+        return merge_finish(counters, options);
+    }
+
+    std::vector<Counter<ShardedTable<Map>, Limit>> counters;
+    counters.reserve(slices.size());
+    for (std::size_t index = 0; index < slices.size(); ++index) {
+        counters.emplace_back(ShardedTable<Map>{ slices.size() },
+                              options.max_word,
+                              classify,
+                              options.encoding);
+    }
+    const auto elapsed = feed_slices(counters, slices, options);
+    auto result = merge_partitioned(counters, options);
+    if (options.stats) {
+        std::vector<std::uint64_t> sizes;
+        sizes.reserve(slices.size());
+        for (const auto slice : slices) {
+            sizes.push_back(slice.size());
+        }
+        result.stats.nodes = node_stats(sizes, elapsed);
+    }
+    return result;
+}
+
+template <typename Map>
+[[nodiscard]] auto with_word_limit(std::size_t max_word, const auto &count)
+        -> Result
+{
+    if constexpr (!std::same_as<Map, StandardMap>) {
+        if (max_word == 16) {
+            return count(std::integral_constant<std::size_t, 16>{});
+        }
+        if (max_word == 32) {
+            return count(std::integral_constant<std::size_t, 32>{});
+        }
+        if (max_word == 64) {
+            return count(std::integral_constant<std::size_t, 64>{});
+        }
+        if (max_word == max_word_limit) {
+            return count(
+                    std::integral_constant<std::size_t, max_word_limit>{});
+        }
+    }
+    return count(std::integral_constant<std::size_t, 0>{});
+}
+
+template <typename Map>
+[[nodiscard]] auto count_with(std::span<const unsigned char> bytes,
+                              const Options &options,
+                              std::span<const std::size_t> bounds) -> Result
+{
+    return with_word_limit<Map>(options.max_word, [&](auto limit) {
+        constexpr auto fixed = decltype(limit)::value;
+        if (options.input == InputMode::stream) {
+            return count_chunked<Map, fixed>(bytes, options);
+        }
+        if (options.threads > 1) {
+            return count_parallel<Map, fixed>(bytes, options, bounds);
+        }
+        return count_words<Map, fixed>(bytes, options);
+    });
+}
+
+[[nodiscard]] inline auto
+count_bytes(std::span<const unsigned char> bytes,
+            const Options &options,
+            std::span<const std::size_t> bounds = {}) -> Result
+{
+    if (options.engine == Engine::compact) {
+        return count_with<CompactTable>(bytes, options, bounds);
+    }
+    if (options.engine == Engine::transparent) {
+        return count_with<TransparentMap>(bytes, options, bounds);
+    }
+    return count_with<StandardMap>(bytes, options, bounds);
+}
+
+template <typename Map>
+[[nodiscard]] auto recount_with(std::span<const unsigned char> bytes,
+                                const Options &options,
+                                std::size_t runs,
+                                const auto &observe) -> Result
+{
+    return with_word_limit<Map>(options.max_word, [&](auto limit) {
+        Counter<Map, decltype(limit)::value> counter{
+            options.max_word, 0, classifier(options.scan), options.encoding
+        };
+        counter.reserve(sampled_unique_words(bytes, options.max_word));
+        Result result{};
+        for (std::size_t run = 0; run < runs; ++run) {
+            counter.clear();
+            if (options.input == InputMode::stream) {
+                for (std::size_t offset = 0; offset < bytes.size();
+                     offset += options.chunk_size) {
+                    counter.feed(bytes.subspan(
+                            offset,
+                            std::min(options.chunk_size,
+                                     bytes.size() - offset)));
+                }
+            } else {
+                counter.feed(bytes);
+            }
+            counter.end_word();
+            result = counter.peek(
+                    options.top, options.select, options.threads);
+            observe(run, result);
+        }
+        return result;
+    });
+}
+
+[[nodiscard]] auto recount(std::span<const unsigned char> bytes,
+                           const Options &options,
+                           std::size_t runs,
+                           const auto &observe) -> Result
+{
+    if (options.engine == Engine::compact) {
+        return recount_with<CompactTable>(bytes, options, runs, observe);
+    }
+    if (options.engine == Engine::transparent) {
+        return recount_with<TransparentMap>(bytes, options, runs, observe);
+    }
+    return recount_with<StandardMap>(bytes, options, runs, observe);
+}
+
+template <typename Map, std::size_t Limit>
+void stream_into(Counter<Map, Limit> &counter,
+                 const std::string &path,
+                 std::size_t chunk_size)
+{
+    if (is_sequential(path)) {
+        Readahead ahead{ path, chunk_size };
+        for (auto bytes = ahead.next(); !bytes.empty(); bytes = ahead.next()) {
+            counter.feed(bytes);
+        }
+        return;
+    }
+
+    std::ifstream file{ path, std::ios::binary };
+    if (!file) {
+        throw std::runtime_error{ "cannot open input file" };
+    }
+
+    std::vector<unsigned char> chunk(chunk_size);
+    while (file) {
+        file.read(reinterpret_cast<char *>(chunk.data()),
+                  static_cast<std::streamsize>(chunk.size()));
+        const auto got = static_cast<std::size_t>(file.gcount());
+        counter.feed(std::span{ chunk }.first(got));
+    }
+    if (file.bad()) {
+        throw std::runtime_error{ "cannot read input file" };
+    }
+}
+
+template <typename Map>
+[[nodiscard]] auto stream_with(const std::string &path, const Options &options)
+        -> Result
+{
+    return with_word_limit<Map>(options.max_word, [&](auto limit) {
+        Counter<Map, decltype(limit)::value> counter{
+            options.max_word, 0, classifier(options.scan), options.encoding
+        };
+        stream_into(counter, path, options.chunk_size);
+        return finish_counter(std::move(counter), options);
+    });
+}
+
+[[nodiscard]] inline auto stream_file(const std::string &path,
+                                      const Options &options) -> Result
+{
+    if (options.engine == Engine::compact) {
+        return stream_with<CompactTable>(path, options);
+    }
+    if (options.engine == Engine::transparent) {
+        return stream_with<TransparentMap>(path, options);
+    }
+    return stream_with<StandardMap>(path, options);
+}
+
+inline void append_path(std::vector<std::string> &paths,
+                        const std::string &path)
+{
+    if (!std::filesystem::is_directory(path)) {
+        paths.push_back(path);
+        return;
+    }
+
+    std::vector<std::string> found;
+    for (const auto &entry :
+         std::filesystem::recursive_directory_iterator{ path }) {
+        if (entry.is_regular_file()) {
+            found.push_back(entry.path().string());
+        }
+    }
+    std::ranges::sort(found);
+    paths.insert(paths.end(), found.begin(), found.end());
+}
+
+[[nodiscard]] inline auto expand_paths(const std::vector<std::string> &args)
+        -> std::vector<std::string>
+{
+    std::vector<std::string> paths;
+    for (const auto &arg : args) {
+        if (!arg.starts_with('@')) {
+            append_path(paths, arg);
+            continue;
+        }
+
+        InputStream list{ arg.substr(1) };
+        if (!list.stream()) {
+            throw std::runtime_error{ "cannot open file list" };
+        }
+        for (std::string line; std::getline(list.stream(), line);) {
+            if (!line.empty() && line.back() == '\r') {
+                line.pop_back();
+            }
+            if (!line.empty()) {
+                append_path(paths, line);
+            }
+        }
+    }
+    return paths;
+}
+
+class FileQueues
+{
+public:
+    FileQueues(const std::vector<std::string> &paths, std::size_t workers)
+        : queues_(workers)
+    {
+        std::vector<std::pair<std::uintmax_t, std::size_t>> sized;
+        sized.reserve(paths.size());
+        for (std::size_t index = 0; index < paths.size(); ++index) {
+            std::error_code error;
+            const auto size = std::filesystem::file_size(paths[index], error);
+            sized.emplace_back(error ? 0 : size, index);
+        }
+        std::ranges::sort(sized, std::greater{});
+
+        for (std::size_t rank = 0; rank < sized.size(); ++rank) {
+            queues_[rank % workers].items.push_back(sized[rank].second);
+        }
+    }
+
+    [[nodiscard]] auto next(std::size_t worker) -> std::optional<std::size_t>
+    {
+        for (std::size_t offset = 0; offset < queues_.size(); ++offset) {
+            auto &queue = queues_[(worker + offset) % queues_.size()];
+            const std::scoped_lock lock{ queue.lock };
+            if (queue.items.empty()) {
+                continue;
+            }
+            std::size_t index = 0;
+            if (offset == 0) {
+                index = queue.items.front();
+                queue.items.pop_front();
+            } else {
+                index = queue.items.back();
+                queue.items.pop_back();
+            }
+            return index;
+        }
+        return std::nullopt;
+    }
+
+private:
+    struct Queue {
+        std::mutex lock;
+        std::deque<std::size_t> items;
+    };
+
+    std::vector<Queue> queues_;
+};
+
+template <typename Map, std::size_t Limit>
+void count_file(Counter<Map, Limit> &counter,
+                const std::string &path,
+                const Options &options)
+{
+    if (options.input == InputMode::stream || is_sequential(path)) {
+        stream_into(counter, path, options.chunk_size);
+    } else {
+        const Input input{ path, options.input };
+        counter.feed(input.bytes());
+    }
+    counter.end_word();
+}
+
+template <typename Map>
+[[nodiscard]] auto count_files_with(const std::vector<std::string> &paths,
+                                    const Options &options) -> Result
+{
+    const auto workers =
+            std::clamp(paths.size(), std::size_t{ 1 }, options.threads);
+    FileQueues queues{ paths, workers };
+
+    const auto classify = classifier(options.scan);
+    return with_word_limit<Map>(options.max_word, [&](auto limit) {
+        constexpr auto fixed = decltype(limit)::value;
+        const auto &topology = numa_topology();
+        std::vector<std::uint64_t> bytes(workers);
+        std::vector<std::uint64_t> elapsed(workers);
+        const auto feed = [&](auto &counters) {
+            run_workers(workers, [&](std::size_t worker) {
+                if (options.numa) {
+                    topology.pin(topology.node_of(worker, workers));
+                }
+                const auto started = std::chrono::steady_clock::now();
+                while (const auto index = queues.next(worker)) {
+                    count_file(counters[worker], paths[*index], options);
+                    std::error_code error;
+                    const auto size =
+                            std::filesystem::file_size(paths[*index], error);
+                    bytes[worker] += error ? 0 : size;
+                }
+                elapsed[worker] = elapsed_ns(started);
+            });
+        };
+
+        if (!options.numa) {
+            std::vector<Counter<Map, fixed>> counters;
+            counters.reserve(workers);
+            for (std::size_t index = 0; index < workers; ++index) {
+                counters.emplace_back(
+                        options.max_word, 0, classify, options.encoding);
+            }
+            feed(counters);
+            return merge_finish(counters, options);
+        }
+
+        std::vector<Counter<ShardedTable<Map>, fixed>> counters;
+        counters.reserve(workers);
+        for (std::size_t index = 0; index < workers; ++index) {
+            counters.emplace_back(ShardedTable<Map>{ workers },
+                                  options.max_word,
+                                  classify,
+                                  options.encoding);
+        }
+        feed(counters);
+        auto result = merge_partitioned(counters, options);
+        if (options.stats) {
+            result.stats.nodes = node_stats(bytes, elapsed);
+        }
+        return result;
+    });
+}
+
+[[nodiscard]] inline auto count_files(const std::vector<std::string> &paths,
+                                      const Options &options) -> Result
+{
+    if (options.engine == Engine::compact) {
+        return count_files_with<CompactTable>(paths, options);
+    }
+    if (options.engine == Engine::transparent) {
+        return count_files_with<TransparentMap>(paths, options);
+    }
+    return count_files_with<StandardMap>(paths, options);
+}
+
+[[nodiscard]] inline auto approximate(const std::vector<std::string> &paths,
+                                      const Options &options) -> ApproxResult
+{
+    Counter<ApproxTable> counter{ ApproxTable{ options.max_word,
+                                               options.approx },
+                                  options.max_word,
+                                  classifier(options.scan),
+                                  options.encoding };
+    for (const auto &path : paths) {
+        stream_into(counter, path, options.chunk_size);
+        counter.end_word();
+    }
+
+    const auto total = counter.total();
+    return std::move(counter).table().result(total, options.top);
+}
+
+inline void put_varint(std::string &out, std::uint64_t value)
+{
+    while (value >= 0x80U) {
+        out.push_back(static_cast<char>((value & 0x7fU) | 0x80U));
+        value >>= 7U;
+    }
+    out.push_back(static_cast<char>(value));
+}
+
+[[nodiscard]] inline auto encode_dump(const Result &result) -> std::string
+{
+    std::vector<const Entry *> sorted;
+    sorted.reserve(result.top.size());
+    for (const auto &entry : result.top) {
+        sorted.push_back(&entry);
+    }
+    std::ranges::sort(sorted, {}, &Entry::word);
+
+    std::string out{ dump_magic };
+    put_varint(out, result.total);
+    put_varint(out, sorted.size());
+    for (const auto *entry : sorted) {
+        put_varint(out, entry->word.size());
+        out += entry->word;
+        put_varint(out, entry->count);
+    }
+    return out;
+}
+
+inline void write_dump(const std::string &path, const Result &result)
+{
+    const auto bytes = encode_dump(result);
+    std::ofstream file{ path, std::ios::binary | std::ios::trunc };
+    file.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+    if (!file) {
+        throw std::runtime_error{ "cannot write dump file" };
+    }
+}
+
+class DumpReader
+{
+public:
+    explicit DumpReader(std::span<const unsigned char> bytes,
+                        Encoding encoding = Encoding::ascii)
+        : bytes_{ bytes }, encoding_{ encoding }
+    {
+        if (!std::ranges::equal(bytes_.first(std::min(bytes_.size(),
+                                                      dump_magic.size())),
+                                dump_magic)) {
+            throw std::runtime_error{ "not a word-count dump" };
+        }
+        cursor_ = dump_magic.size();
+        total_ = varint();
+        remaining_ = varint();
+        if (remaining_ > (bytes_.size() - cursor_) / 3U) {
+            throw std::runtime_error{ "truncated dump" };
+        }
+    }
+
+    [[nodiscard]] auto next() -> bool
+    {
+        if (remaining_ == 0) {
+            if (cursor_ != bytes_.size() || sum_ != total_) {
+                throw std::runtime_error{ "corrupt dump" };
+            }
+            return false;
+        }
+
+        const auto size = varint();
+        if (size == 0 || size > max_word_limit ||
+            size > bytes_.size() - cursor_) {
+            throw std::runtime_error{ "corrupt dump" };
+        }
+        const std::string_view word{
+            reinterpret_cast<const char *>(bytes_.data() + cursor_),
+            static_cast<std::size_t>(size)
+        };
+        cursor_ += word.size();
+        const auto count = varint();
+        if (count == 0 || !folded(word)) {
+            throw std::runtime_error{ "corrupt dump" };
+        }
+        if (!word_.empty() && word <= word_) {
+            throw std::runtime_error{ "dump is not sorted by word" };
+        }
+
+        word_ = word;
+        count_ = count;
+        sum_ += count;
+        --remaining_;
+        return true;
+    }
+
+    [[nodiscard]] auto word() const -> std::string_view
+    {
+        return word_;
+    }
+
+    [[nodiscard]] auto count() const -> std::uint64_t
+    {
+        return count_;
+    }
+
+    [[nodiscard]] auto total() const -> std::uint64_t
+    {
+        return total_;
+    }
+
+    [[nodiscard]] auto remaining() const -> std::uint64_t
+    {
+        return remaining_;
+    }
+
+private:
+    [[nodiscard]] auto folded(std::string_view word) const -> bool
+    {
+        const std::span letters{
+            reinterpret_cast<const unsigned char *>(word.data()), word.size()
+        };
+        for (std::size_t cursor = 0; cursor < letters.size();) {
+            const auto byte = letters[cursor];
+            if (byte >= 'a' && byte <= 'z') {
+                ++cursor;
+                continue;
+            }
+            if (encoding_ == Encoding::ascii || byte < 0x80U) {
+                return false;
+            }
+            const auto decoded = decode_utf8(letters.subspan(cursor));
+            if (decoded.size == 0 || !is_word_point(decoded.point) ||
+                fold_point(decoded.point) != decoded.point) {
+                return false;
+            }
+            cursor += decoded.size;
+        }
+        return true;
+    }
+
+    [[nodiscard]] auto varint() -> std::uint64_t
+    {
+        std::uint64_t value = 0;
+        for (unsigned shift = 0; shift < 64U && cursor_ < bytes_.size();
+             shift += 7U) {
+            const auto byte = bytes_[cursor_++];
+            value |= static_cast<std::uint64_t>(byte & 0x7fU) << shift;
+            if ((byte & 0x80U) == 0) {
+                return value;
+            }
+        }
+        throw std::runtime_error{ "truncated dump" };
+    }
+
+    std::span<const unsigned char> bytes_;
+    Encoding encoding_;
+    std::size_t cursor_ = 0;
+    std::uint64_t total_ = 0;
+    std::uint64_t remaining_ = 0;
+    std::uint64_t sum_ = 0;
+    std::string_view word_;
+    std::uint64_t count_ = 0;
+};
+
+[[nodiscard]] inline auto
+merge_parts(std::span<const std::span<const unsigned char>> parts,
+            const Options &options) -> Result
+{
+    std::vector<DumpReader> readers;
+    readers.reserve(parts.size());
+    std::uint64_t total = 0;
+    std::size_t capacity = 0;
+    std::vector<std::size_t> heap;
+    for (const auto part : parts) {
+        auto &reader = readers.emplace_back(part, options.encoding);
+        total += reader.total();
+        capacity += static_cast<std::size_t>(reader.remaining());
+        if (reader.next()) {
+            heap.push_back(readers.size() - 1);
+        }
+    }
+
+    const auto after = [&readers](std::size_t left, std::size_t right) {
+        return readers[left].word() > readers[right].word();
+    };
+    std::ranges::make_heap(heap, after);
+
+    std::vector<Entry> entries;
+    entries.reserve(capacity);
+    while (!heap.empty()) {
+        const auto word = readers[heap.front()].word();
+        std::uint64_t count = 0;
+        while (!heap.empty() && readers[heap.front()].word() == word) {
+            std::ranges::pop_heap(heap, after);
+            auto &reader = readers[heap.back()];
+            count += reader.count();
+            if (reader.next()) {
+                std::ranges::push_heap(heap, after);
+            } else {
+                heap.pop_back();
+            }
+        }
+        entries.push_back({ std::string{ word }, count });
+    }
+
+    const auto unique = entries.size();
+    rank_entries(entries, options.top, options.select, options.threads);
+    return { .total = total, .unique = unique, .top = std::move(entries) };
+}
+
+[[nodiscard]] inline auto merge_dumps(const std::vector<std::string> &paths,
+                                      const Options &options) -> Result
+{
+    std::vector<std::vector<unsigned char>> files;
+    files.reserve(paths.size());
+    for (const auto &path : paths) {
+        files.push_back(read_file(path));
+    }
+
+    const std::vector<std::span<const unsigned char>> parts{ files.begin(),
+                                                             files.end() };
+    return merge_parts(parts, options);
+}
+
+[[nodiscard]] inline auto dump_bytes(const std::string &dump)
+        -> std::span<const unsigned char>
+{
+    return { reinterpret_cast<const unsigned char *>(dump.data()),
+             dump.size() };
+}
+
+#if defined(_WIN32)
+[[nodiscard]] inline auto file_identity(const std::string &path)
+        -> FileIdentity
+{
+    if (!std::filesystem::is_regular_file(path)) {
+        throw std::runtime_error{ "cannot index " + path };
+    }
+    return { .device = 0,
+             .inode = 0,
+             .mtime = static_cast<std::uint64_t>(
+                     std::filesystem::last_write_time(path)
+                             .time_since_epoch()
+                             .count()),
+             .size = std::filesystem::file_size(path) };
+}
+#else
+[[nodiscard]] inline auto file_identity(const std::string &path)
+        -> FileIdentity
+{
+    struct stat info {};
+    if (::stat(path.c_str(), &info) != 0 || !S_ISREG(info.st_mode)) {
+        throw std::runtime_error{ "cannot index " + path };
+    }
+#if defined(__APPLE__)
+    const auto mtime = info.st_mtimespec;
+#else
+    const auto mtime = info.st_mtim;
+#endif
+    return { .device = static_cast<std::uint64_t>(info.st_dev),
+             .inode = static_cast<std::uint64_t>(info.st_ino),
+             .mtime = static_cast<std::uint64_t>(mtime.tv_sec) *
+                              1'000'000'000U +
+                      static_cast<std::uint64_t>(mtime.tv_nsec),
+             .size = static_cast<std::uint64_t>(info.st_size) };
+}
+#endif
+
+[[nodiscard]] inline auto index_field(std::span<const unsigned char> index,
+                                      std::size_t field) -> std::uint64_t
+{
+    std::uint64_t value = 0;
+    for (unsigned shift = 0;
+         const auto byte : index.subspan(index_magic.size() + field * 8U, 8U)) {
+        value |= static_cast<std::uint64_t>(byte) << shift;
+        shift += 8U;
+    }
+    return value;
+}
+
+[[nodiscard]] inline auto index_offset(std::span<const unsigned char> index,
+                                       const FileIdentity &file,
+                                       std::size_t max_word)
+        -> std::optional<std::uint64_t>
+{
+    if (index.size() < index_header ||
+        !std::ranges::equal(index.first(index_magic.size()), index_magic)) {
+        return std::nullopt;
+    }
+
+    const auto size = index_field(index, 4);
+    const auto offset = index_field(index, 5);
+    if (index_field(index, 0) != max_word ||
+        index_field(index, 1) != file.device ||
+        index_field(index, 2) != file.inode || offset > size ||
+        size > file.size ||
+        (size == file.size && index_field(index, 3) != file.mtime)) {
+        return std::nullopt;
+    }
+    return offset;
+}
+
+[[nodiscard]] inline auto read_tail(const std::string &path,
+                                    std::uint64_t offset,
+                                    std::uint64_t size)
+        -> std::vector<unsigned char>
+{
+    std::ifstream file{ path, std::ios::binary };
+    if (!file) {
+        throw std::runtime_error{ "cannot open input file" };
+    }
+
+    std::vector<unsigned char> bytes(static_cast<std::size_t>(size - offset));
+    file.seekg(static_cast<std::streamoff>(offset));
+    file.read(reinterpret_cast<char *>(bytes.data()),
+              static_cast<std::streamsize>(bytes.size()));
+    if (file.bad() || (!file && !file.eof())) {
+        throw std::runtime_error{ "cannot read input file" };
+    }
+    bytes.resize(static_cast<std::size_t>(file.gcount()));
+    return bytes;
+}
+
+inline void write_index(const std::string &path,
+                        const FileIdentity &file,
+                        std::size_t max_word,
+                        std::uint64_t offset,
+                        std::span<const unsigned char> counts)
+{
+    std::string header{ index_magic };
+    for (const auto value : { std::uint64_t{ max_word },
+                              file.device,
+                              file.inode,
+                              file.mtime,
+                              file.size,
+                              offset }) {
+        for (unsigned shift = 0; shift < 64U; shift += 8U) {
+            header.push_back(static_cast<char>((value >> shift) & 0xffU));
+        }
+    }
+
+    const auto temp = path + ".tmp";
+    std::ofstream out{ temp, std::ios::binary | std::ios::trunc };
+    out.write(header.data(), static_cast<std::streamsize>(header.size()));
+    out.write(reinterpret_cast<const char *>(counts.data()),
+              static_cast<std::streamsize>(counts.size()));
+    out.close();
+
+    std::error_code error;
+    if (out) {
+        std::filesystem::rename(temp, path, error);
+    }
+    if (!out || error) {
+        std::filesystem::remove(temp, error);
+        throw std::runtime_error{ "cannot write index file" };
+    }
+}
+
+[[nodiscard]] inline auto update_index(const std::string &path,
+                                       FileIdentity file,
+                                       std::span<const unsigned char> cached,
+                                       std::uint64_t offset,
+                                       const Options &options) -> Result
+{
+    const auto tail = read_tail(path, offset, file.size);
+    auto keep = tail.size();
+    while (keep > 0 && is_letter(tail[keep - 1])) {
+        --keep;
+    }
+
+    auto complete = options;
+    complete.top = std::numeric_limits<std::size_t>::max();
+    auto counts = cached.empty() ? cached : cached.subspan(index_header);
+    std::string fresh;
+    if (cached.empty() || keep > 0) {
+        fresh = encode_dump(
+                count_bytes(std::span{ tail }.first(keep), complete));
+        if (!cached.empty()) {
+            const std::array parts{ counts, dump_bytes(fresh) };
+            fresh = encode_dump(merge_parts(parts, complete));
+        }
+        counts = dump_bytes(fresh);
+    }
+
+    const auto seen = offset + tail.size();
+    if (cached.empty() || keep > 0 || index_field(cached, 3) != file.mtime ||
+        index_field(cached, 4) != seen) {
+        file.size = seen;
+        write_index(
+                options.index, file, options.max_word, offset + keep, counts);
+    }
+
+    if (keep == tail.size()) {
+        const std::array parts{ counts };
+        return merge_parts(parts, options);
+    }
+    const auto partial = encode_dump(
+            count_bytes(std::span{ tail }.subspan(keep), complete));
+    const std::array parts{ counts, dump_bytes(partial) };
+    return merge_parts(parts, options);
+}
+
+[[nodiscard]] inline auto count_indexed(const std::string &path,
+                                        const Options &options) -> Result
+{
+    const auto file = file_identity(path);
+    if (is_compressed(path)) {
+        throw std::runtime_error{ "cannot index compressed input" };
+    }
+
+    std::error_code error;
+    if (std::filesystem::is_regular_file(options.index, error)) {
+        try {
+            const Input index{ options.index, InputMode::mmap };
+            if (const auto offset =
+                        index_offset(index.bytes(), file, options.max_word)) {
+                return update_index(
+                        path, file, index.bytes(), *offset, options);
+            }
+        } catch (const std::runtime_error &) {
+        }
+    }
+    return update_index(path, file, {}, 0, options);
+}
+
+[[nodiscard]] inline auto mix_byte(std::uint32_t checksum, unsigned char byte)
+        -> std::uint32_t
+{
+    return (checksum ^ static_cast<std::uint32_t>(byte)) * checksum_prime;
+}
+
+[[nodiscard]] inline auto mix_u32(std::uint32_t checksum, std::uint32_t value)
+        -> std::uint32_t
+{
+    for (auto index = 0; index < 4; ++index) {
+        checksum =
+                mix_byte(checksum, static_cast<unsigned char>(value & 0xffU));
+        value >>= 8U;
+    }
+    return checksum;
+}
+
+[[nodiscard]] inline auto mix_u64(std::uint32_t checksum, std::uint64_t value)
+        -> std::uint32_t
+{
+    for (auto index = 0; index < 8; ++index) {
+        checksum =
+                mix_byte(checksum, static_cast<unsigned char>(value & 0xffU));
+        value >>= 8U;
+    }
+    return checksum;
+}
+
+[[nodiscard]] inline auto checksum(const Result &result) -> std::uint32_t
+{
+    auto value = checksum_offset;
+    value = mix_u64(value, result.total);
+    value = mix_u64(value, static_cast<std::uint64_t>(result.unique));
+    for (const auto &entry : result.top) {
+        for (const auto byte : entry.word) {
+            value = mix_byte(value, static_cast<unsigned char>(byte));
+        }
+        value = mix_u64(value, entry.count);
+    }
+    return value;
+}
+
+}  // namespace wordcount
+
+#endif
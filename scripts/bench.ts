@@ -6,6 +6,13 @@ import { spawn } from "node:child_process";
 
 type JsonEntry = { word: string; count: number };
 type JsonResult = { total: number; unique: number; top: JsonEntry[] };
+type ApproxJsonEntry = JsonEntry & { error: number };
+type ApproxJsonResult = {
+  total: number;
+  unique: number;
+  top: ApproxJsonEntry[];
+  approximate: { counters: number; max_error: number; unique_error: number };
+};
 
 type Command = {
   cwd?: string;
@@ -18,6 +25,10 @@ type Implementation = {
   name: string;
   build?: Command[];
   run: (fixture: string, top: number, maxWord: number) => Command;
+  variants?: string[][];
+  mergeable?: boolean;
+  approximate?: boolean;
+  reusable?: boolean;
 };
 
 type BenchOptions = {
@@ -68,6 +79,8 @@ type BenchmarkState = {
   startupCommand: Command;
   warmTaskCommand: Command;
   warmTaskSamples: number[];
+  allocSamples: number[];
+  coldSamples: number[];
   totalSamples: number[];
   startupSamples: number[];
   adjustedSamples: number[];
@@ -75,13 +88,40 @@ type BenchmarkState = {
 
 type BenchmarkResult = {
   warmTaskMeanMs: number;
+  allocMeanMs?: number;
+  coldMeanMs?: number;
   totalMeanMs: number;
   startupMeanMs: number;
   adjustedMeanMs: number;
   adjustedP95Ms: number;
 };
 
-type WarmTaskResult = { mean_ms: number; checksum: number | string };
+type WarmTaskResult = {
+  mean_ms: number;
+  reuse_ms?: number;
+  cold_ms?: number | null;
+  checksum: number | string;
+};
+
+type PhaseTiming = { p50_ms: number; p99_ms: number };
+
+type PhaseEngine = {
+  engine: string;
+  checksum: number;
+  tokens: number;
+  unique: number;
+  resizes: number;
+  allocations: number | null;
+  bytes_per_unique: number | null;
+  phases: Record<string, PhaseTiming>;
+  bytes_per_s: number;
+  tokens_per_s: number;
+};
+
+type PhaseReport = {
+  runs: number;
+  fixtures: { fixture: string; bytes: number; engines: PhaseEngine[] }[];
+};
 
 type SummaryRow = {
   name: string;
@@ -95,6 +135,12 @@ const csharpBin = join(
   "csharp/src/WordFrequencyCounter/bin/Release/net10.0/WordFrequencyCounter" +
     (process.platform === "win32" ? ".exe" : ""),
 );
+const phaseBench = join(root, "build/c/release/wordcount_bench");
+const phaseNames = ["read", "scan", "insert", "materialize", "sort"];
+const approxBudget = 64 * 1024;
+const approxRssBudget = 32 * 1024 * 1024;
+const approxRssFloor = 16 * 1024 * 1024;
+const maxRssUnit = process.platform === "darwin" ? 1 : 1024;
 const validationFixtures = join(root, "build", "fixtures");
 const legacyBenchmarkFixture = join(validationFixtures, "benchmark.txt");
 const startupFixture = join(validationFixtures, "startup-empty.txt");
@@ -221,6 +267,24 @@ const implementations: Implementation[] = [
         fixture,
       ],
     }),
+    variants: [
+      ["--input", "mmap"],
+      ["--input", "stream"],
+      ["--input", "stream", "--chunk-size", "7"],
+      ["--threads", "4"],
+      ["--scan", "simd"],
+      ["--scan", "simd", "--input", "stream", "--chunk-size", "7"],
+      ["--select"],
+      ["--select", "--threads", "4"],
+      ["--stats"],
+      ["--stats", "--threads", "4"],
+      [startupFixture],
+      ["--threads", "4", startupFixture],
+      ["--input", "stream", "--chunk-size", "7", startupFixture],
+    ],
+    mergeable: true,
+    approximate: true,
+    reusable: true,
   },
   {
     name: "cpp",
@@ -235,6 +299,31 @@ const implementations: Implementation[] = [
         fixture,
       ],
     }),
+    variants: [
+      ["--input", "mmap"],
+      ["--input", "stream"],
+      ["--input", "stream", "--chunk-size", "7"],
+      ["--threads", "4"],
+      ["--engine", "transparent"],
+      ["--engine", "transparent", "--threads", "4"],
+      ["--engine", "compact"],
+      ["--engine", "compact", "--threads", "4"],
+      ["--engine", "compact", "--select"],
+      ["--scan", "simd"],
+      ["--scan", "simd", "--input", "stream", "--chunk-size", "7"],
+      ["--select"],
+      ["--select", "--threads", "4"],
+      ["--stats"],
+      ["--engine", "compact", "--stats"],
+      ["--numa", "--threads", "4"],
+      ["--engine", "compact", "--numa", "--threads", "4"],
+      [startupFixture],
+      ["--threads", "4", startupFixture],
+      ["--input", "stream", "--chunk-size", "7", startupFixture],
+    ],
+    mergeable: true,
+    approximate: true,
+    reusable: true,
   },
   {
     name: "rust",
@@ -565,15 +654,88 @@ if (!options.buildOnly) {
   }
 
   for (const implementation of implementations) {
-    for (const { testCase, oracle } of expectedCases) {
-      const result = await runJson(
-        implementation,
-        testCase.fixture,
-        testCase.top,
-        testCase.maxWord,
-        testCase.argStyle,
-      );
-      assertSame(`${implementation.name} (${testCase.name})`, oracle, result);
+    for (const variant of [[], ...(implementation.variants ?? [])]) {
+      const name = [implementation.name, ...variant].join(" ");
+      for (const { testCase, oracle } of expectedCases) {
+        const result = await runJson(
+          implementation,
+          testCase.fixture,
+          testCase.top,
+          testCase.maxWord,
+          testCase.argStyle,
+          variant,
+        );
+        assertSame(`${name} (${testCase.name})`, oracle, result);
+      }
+    }
+    if (implementation.mergeable) {
+      const partial = join(validationFixtures, `${implementation.name}.wfd`);
+      for (const { testCase, oracle } of expectedCases) {
+        const dumped = await runJson(
+          implementation,
+          testCase.fixture,
+          testCase.top,
+          testCase.maxWord,
+          testCase.argStyle,
+          ["--dump", partial],
+        );
+        assertSame(
+          `${implementation.name} --dump (${testCase.name})`,
+          oracle,
+          dumped,
+        );
+        const merged = await runJson(
+          implementation,
+          partial,
+          testCase.top,
+          testCase.maxWord,
+          testCase.argStyle,
+          ["--merge"],
+        );
+        assertSame(
+          `${implementation.name} --merge (${testCase.name})`,
+          oracle,
+          merged,
+        );
+      }
+    }
+    if (implementation.approximate) {
+      for (const { testCase, oracle } of expectedCases) {
+        const result = (await runJson(
+          implementation,
+          testCase.fixture,
+          testCase.top,
+          testCase.maxWord,
+          testCase.argStyle,
+          ["--approx", String(approxBudget)],
+        )) as unknown as ApproxJsonResult;
+        assertWithinError(
+          `${implementation.name} --approx ${approxBudget} (${testCase.name})`,
+          oracle,
+          result,
+          testCase.top,
+        );
+      }
+      const largest = expectedCases
+        .map(({ testCase }) => testCase.fixture)
+        .reduce((left, right) =>
+          statSync(right).size > statSync(left).size ? right : left,
+        );
+      const command = implementation.run(largest, 10, 1024);
+      const peak = await peakRss({
+        ...command,
+        args: [
+          ...command.args.slice(0, -1),
+          "--approx",
+          String(approxRssBudget),
+          ...command.args.slice(-1),
+        ],
+      });
+      if (peak > approxRssBudget + approxRssFloor) {
+        throw new Error(
+          `${implementation.name} --approx ${approxRssBudget} peaked at ${peak} bytes, over its budget plus ${approxRssFloor}`,
+        );
+      }
     }
     rows.push({ name: implementation.name, timings: new Map() });
   }
@@ -608,6 +770,13 @@ if (!options.buildOnly) {
   }
 
   printSummary(rows, benchmarkFixtures);
+
+  if (!options.validateOnly) {
+    printPhaseSummary(
+      await phaseBreakdown(benchmarkFixtures, options, expectedByName),
+      benchmarkFixtures,
+    );
+  }
 }
 
 function parseArgs(args: string[]): BenchOptions {
@@ -993,11 +1162,17 @@ async function runJson(
   top: number,
   maxWord: number,
   argStyle: ValidationArgStyle = "separated",
+  variant: string[] = [],
 ): Promise<JsonResult> {
   const command = implementation.run(fixture, top, maxWord);
   const output = await run({
     ...command,
-    args: validationArgs(command.args, top, maxWord, argStyle),
+    args: validationArgs(
+      [...command.args.slice(0, -1), ...variant, ...command.args.slice(-1)],
+      top,
+      maxWord,
+      argStyle,
+    ),
   });
   return JSON.parse(output) as JsonResult;
 }
@@ -1057,8 +1232,11 @@ async function benchmarkAll(
       implementation.run(fixture, top, maxWord),
       warmTaskRuns,
       warmTaskWarmups,
+      implementation.reusable,
     ),
     warmTaskSamples: [],
+    allocSamples: [],
+    coldSamples: [],
     totalSamples: [],
     startupSamples: [],
     adjustedSamples: [],
@@ -1074,13 +1252,18 @@ async function benchmarkAll(
 
   for (let index = 0; index < warmTaskSamples; index += 1) {
     for (const state of rotated(states, index)) {
-      state.warmTaskSamples.push(
-        await runWarmTask(
-          state.implementation.name,
-          state.warmTaskCommand,
-          expectedSampleChecksum,
-        ),
+      const result = await runWarmTask(
+        state.implementation.name,
+        state.warmTaskCommand,
+        expectedSampleChecksum,
       );
+      state.warmTaskSamples.push(result.mean_ms);
+      if (result.reuse_ms !== undefined) {
+        state.allocSamples.push(result.mean_ms - result.reuse_ms);
+      }
+      if (typeof result.cold_ms === "number") {
+        state.coldSamples.push(result.cold_ms);
+      }
     }
   }
 
@@ -1106,6 +1289,8 @@ async function benchmarkAll(
       state.implementation.name,
       {
         warmTaskMeanMs: mean(state.warmTaskSamples),
+        allocMeanMs: meanMaybe(state.allocSamples),
+        coldMeanMs: meanMaybe(state.coldSamples),
         totalMeanMs: mean(state.totalSamples),
         startupMeanMs: mean(state.startupSamples),
         adjustedMeanMs: mean(state.adjustedSamples),
@@ -1115,7 +1300,12 @@ async function benchmarkAll(
   );
 }
 
-function warmTaskCommand(command: Command, runs: number, warmups: number) {
+function warmTaskCommand(
+  command: Command,
+  runs: number,
+  warmups: number,
+  reusable = false,
+) {
   const fixture = command.args.at(-1);
   if (fixture === undefined) {
     throw new Error(`${command.cmd} has no fixture argument`);
@@ -1129,6 +1319,7 @@ function warmTaskCommand(command: Command, runs: number, warmups: number) {
       String(runs),
       "--bench-warmups",
       String(warmups),
+      ...(reusable ? ["--bench-reuse"] : []),
       fixture,
     ],
   };
@@ -1138,7 +1329,7 @@ async function runWarmTask(
   name: string,
   command: Command,
   expectedChecksum: bigint,
-): Promise<number> {
+): Promise<WarmTaskResult> {
   const output = await run(command);
   const result = JSON.parse(output) as WarmTaskResult;
   if (!Number.isFinite(result.mean_ms) || result.mean_ms < 0) {
@@ -1147,7 +1338,7 @@ async function runWarmTask(
     );
   }
   assertWarmTaskChecksum(name, result, expectedChecksum);
-  return result.mean_ms;
+  return result;
 }
 
 async function validateWarmTask(
@@ -1240,6 +1431,10 @@ function mean(samples: number[]) {
   return samples.reduce((sum, sample) => sum + sample, 0) / samples.length;
 }
 
+function meanMaybe(samples: number[]) {
+  return samples.length === 0 ? undefined : mean(samples);
+}
+
 function percentile(samples: number[], quantile: number) {
   const sorted = [...samples].sort((left, right) => left - right);
   return sorted[
@@ -1263,6 +1458,50 @@ function assertSame(name: string, expected: JsonResult, actual: JsonResult) {
   }
 }
 
+function assertWithinError(
+  name: string,
+  expected: JsonResult,
+  actual: ApproxJsonResult,
+  top: number,
+) {
+  const fail = (reason: string) => {
+    throw new Error(
+      `${name} ${reason}\nexpected ${JSON.stringify(expected)}\nactual   ${JSON.stringify(actual)}`,
+    );
+  };
+  if (actual.total !== expected.total) {
+    fail("reported the wrong total");
+  }
+
+  const complete = expected.top.length < top;
+  const trueCounts = new Map(
+    expected.top.map((entry) => [entry.word, entry.count]),
+  );
+  const floor = expected.top.at(-1)?.count ?? 0;
+  for (const entry of actual.top) {
+    const trueCount = trueCounts.get(entry.word) ?? (complete ? 0 : undefined);
+    const lower = entry.count - entry.error;
+    if (trueCount === undefined ? lower > floor : lower > trueCount) {
+      fail(`overcounted ${entry.word} by more than its error`);
+    }
+    if (trueCount !== undefined && trueCount > entry.count) {
+      fail(`undercounted ${entry.word} below its true count`);
+    }
+  }
+
+  const reported = new Set(actual.top.map((entry) => entry.word));
+  const smallest =
+    actual.top.length < top ? 0 : (actual.top.at(-1)?.count ?? 0);
+  for (const entry of expected.top) {
+    if (
+      !reported.has(entry.word) &&
+      entry.count > Math.max(actual.approximate.max_error, smallest)
+    ) {
+      fail(`missed ${entry.word} above max_error`);
+    }
+  }
+}
+
 function printSummary(
   rows: SummaryRow[],
   benchmarkFixtures: BenchmarkFixture[],
@@ -1319,9 +1558,9 @@ function printCorpusSummary(
   const alignmentColumns = benchmarkFixtures.map(() => "---:").join("|");
 
   console.log(
-    `| implementation |${timingColumns}| ${primaryFixture.name} MB/s | ${primaryFixture.name} adjusted CLI ms |`,
+    `| implementation |${timingColumns}| ${primaryFixture.name} MB/s | ${primaryFixture.name} alloc ms | ${primaryFixture.name} cold ms | ${primaryFixture.name} adjusted CLI ms |`,
   );
-  console.log(`|---|${alignmentColumns}|---:|---:|`);
+  console.log(`|---|${alignmentColumns}|---:|---:|---:|---:|`);
   for (const row of displayRows) {
     const timingCells = benchmarkFixtures
       .map((benchmarkFixture) =>
@@ -1334,7 +1573,9 @@ function printCorpusSummary(
         primaryTiming === undefined
           ? ""
           : throughputMiBPerSecond(primaryFixture.bytes, primaryTiming)
-      } | ${formatMaybe(primaryTiming?.adjustedMeanMs)} |`,
+      } | ${formatMaybe(primaryTiming?.allocMeanMs)} | ${formatMaybe(
+        primaryTiming?.coldMeanMs,
+      )} | ${formatMaybe(primaryTiming?.adjustedMeanMs)} |`,
     );
   }
 }
@@ -1352,9 +1593,9 @@ function printSingleFixtureSummary(
   );
 
   console.log(
-    "| implementation | warm task mean ms | warm task MB/s | raw CLI mean ms | startup mean ms | adjusted CLI mean ms | adjusted CLI p95 ms |",
+    "| implementation | warm task mean ms | warm task MB/s | alloc ms | cold ms | raw CLI mean ms | startup mean ms | adjusted CLI mean ms | adjusted CLI p95 ms |",
   );
-  console.log("|---|---:|---:|---:|---:|---:|---:|");
+  console.log("|---|---:|---:|---:|---:|---:|---:|---:|---:|");
   for (const row of displayRows) {
     const timing = row.timings.get(benchmarkFixture.name);
     console.log(
@@ -1362,7 +1603,9 @@ function printSingleFixtureSummary(
         timing === undefined
           ? ""
           : throughputMiBPerSecond(benchmarkFixture.bytes, timing)
-      } | ${formatMaybe(timing?.totalMeanMs)} | ${formatMaybe(
+      } | ${formatMaybe(timing?.allocMeanMs)} | ${formatMaybe(
+        timing?.coldMeanMs,
+      )} | ${formatMaybe(timing?.totalMeanMs)} | ${formatMaybe(
         timing?.startupMeanMs,
       )} | ${formatMaybe(timing?.adjustedMeanMs)} | ${formatMaybe(
         timing?.adjustedP95Ms,
@@ -1371,6 +1614,78 @@ function printSingleFixtureSummary(
   }
 }
 
+async function phaseBreakdown(
+  benchmarkFixtures: BenchmarkFixture[],
+  options: BenchOptions,
+  expectedByName: Map<string, JsonResult>,
+): Promise<PhaseReport> {
+  const output = await run({
+    cmd: phaseBench,
+    args: [
+      "--runs",
+      String(options.warmTaskRuns),
+      "--warmups",
+      String(options.warmTaskWarmups),
+      "--top",
+      String(options.top),
+      "--max-word",
+      String(options.maxWord),
+      ...benchmarkFixtures.map((benchmarkFixture) => benchmarkFixture.fixture),
+    ],
+  });
+  const report = JSON.parse(output) as PhaseReport;
+
+  report.fixtures.forEach((fixture, index) => {
+    const expected = expectedByName.get(
+      validationNameForBenchmarkFixture(benchmarkFixtures[index]),
+    );
+    if (expected === undefined) {
+      throw new Error(`missing oracle result for ${fixture.fixture}`);
+    }
+    const expectedChecksum = checksumResult(expected);
+    for (const engine of fixture.engines) {
+      if (BigInt(engine.checksum) !== expectedChecksum) {
+        throw new Error(
+          `wordcount_bench ${engine.engine} checksum mismatch on ${fixture.fixture}\nexpected ${expectedChecksum}\nactual   ${engine.checksum}`,
+        );
+      }
+    }
+  });
+  return report;
+}
+
+function printPhaseSummary(
+  report: PhaseReport,
+  benchmarkFixtures: BenchmarkFixture[],
+) {
+  const phaseColumns = phaseNames.map((phase) => ` ${phase} p50 ms `).join("|");
+  const alignmentColumns = phaseNames.map(() => "---:").join("|");
+
+  console.log("");
+  console.log(
+    `| fixture | engine |${phaseColumns}| engine p50 ms | engine p99 ms | MB/s | Mtokens/s | resizes | allocs/run | bytes/unique |`,
+  );
+  console.log(`|---|---|${alignmentColumns}|---:|---:|---:|---:|---:|---:|---:|`);
+  report.fixtures.forEach((fixture, index) => {
+    for (const engine of fixture.engines) {
+      const phaseCells = phaseNames
+        .map((phase) => formatMaybe(engine.phases[phase]?.p50_ms))
+        .join(" | ");
+      console.log(
+        `| ${benchmarkFixtures[index].name} | ${engine.engine} | ${phaseCells} | ${formatMaybe(
+          engine.phases.engine?.p50_ms,
+        )} | ${formatMaybe(engine.phases.engine?.p99_ms)} | ${(
+          engine.bytes_per_s /
+          1024 /
+          1024
+        ).toFixed(1)} | ${(engine.tokens_per_s / 1_000_000).toFixed(2)} | ${
+          engine.resizes
+        } | ${engine.allocations ?? ""} | ${formatMaybe(engine.bytes_per_unique ?? undefined)} |`,
+      );
+    }
+  });
+}
+
 function formatMaybe(value: number | undefined) {
   return value === undefined ? "" : value.toFixed(3);
 }
@@ -1383,6 +1698,26 @@ function throughputMiBPerSecond(bytes: number, timing: BenchmarkResult) {
   return (mib / (timing.warmTaskMeanMs / 1000)).toFixed(1);
 }
 
+async function peakRss(command: Command): Promise<number> {
+  const child = Bun.spawn([command.cmd, ...command.args], {
+    cwd: command.cwd ?? root,
+    stdio: ["ignore", "ignore", "pipe"],
+    env: { ...process.env, ...command.env },
+  });
+  const code = await child.exited;
+  if (code !== 0) {
+    const err = (await new Response(child.stderr).text()).trim();
+    throw new Error(
+      `${command.cmd} ${command.args.join(" ")} failed with ${code}\n${err}`,
+    );
+  }
+  const usage = child.resourceUsage();
+  if (usage === undefined) {
+    throw new Error(`${command.cmd} reported no resource usage`);
+  }
+  return usage.maxRSS * maxRssUnit;
+}
+
 async function run(command: Command): Promise<string> {
   return await new Promise((resolveCommand, reject) => {
     const child = spawn(command.cmd, command.args, {